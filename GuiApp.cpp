@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include "mr/FileManager.hpp"
 #include "mr/Workflow.hpp"
+#include "mr/MemoryBudget.hpp"
 #include <windows.h>
 #include <sstream>
 #include <iomanip>
@@ -164,8 +165,36 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return 0;
 }
 
-int WINAPI wWinMain(HINSTANCE hInst, HINSTANCE, PWSTR, int nShowCmd)
+// "--memory-limit <size>" (e.g. 256M) bounds the workflow's buffers and
+// grouping; without it memory is unlimited.
+static bool applyCommandLine(PWSTR cmdLine)
 {
+    if (!cmdLine) return true;
+    string args;
+    for (const wchar_t* p = cmdLine; *p; ++p) {
+        args.push_back(*p < 128 ? static_cast<char>(*p) : '?');
+    }
+
+    istringstream iss(args);
+    string arg;
+    while (iss >> arg) {
+        if (arg != "--memory-limit") continue;
+        string value;
+        size_t bytes = 0;
+        if (!(iss >> value) || !mr::parseMemorySize(value, bytes)) {
+            MessageBoxA(nullptr, ("Invalid value for --memory-limit: " + value).c_str(),
+                        "MapReduce", MB_ICONERROR);
+            return false;
+        }
+        mr::setMemoryLimit(bytes);
+    }
+    return true;
+}
+
+int WINAPI wWinMain(HINSTANCE hInst, HINSTANCE, PWSTR cmdLine, int nShowCmd)
+{
+    if (!applyCommandLine(cmdLine)) return 1;
+
     const wchar_t CLASS_NAME[] = L"MRGUIWin32";
 
     WNDCLASS wc{};
@@ -329,7 +329,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             ShowOutputText(hwnd, "Running MapReduce...\r\n");
 
             std::string outputFile = "output/word_counts.csv";
-            MapReduceController controller(g_selectedPath, outputFile, 3u);
+            // Worker count 0: sized for this machine and the selected input.
+            MapReduceController controller(g_selectedPath, outputFile, 0u);
             bool ok = controller.run(g_logger);
 
             if (!ok) {
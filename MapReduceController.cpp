@@ -4,43 +4,637 @@
 #include "P3_Mapper.h"
 #include "P3_Reducer.h"
 #include "P3_Logger.h"
+#include "P3_IncrementalCache.h"
+#include "P3_NGram.h"
+#include "P3_InvertedIndex.h"
+#include "P3_TfIdf.h"
+#include "P3_SymbolTable.h"
+#include "P3_MemoryResources.h"
+#include "P3_MemoryBudget.h"
+#include "P3_SpillFile.h"
+#include "P3_ReadAhead.h"
+#include "P3_StreamSource.h"
+#include "P3_Watch.h"
+#include "P3_Windowing.h"
+#include "P3_Compression.h"
+#include "P3_OutputWriter.h"
+#include "P3_WorkerTuning.h"
+#include "P3_Join.h"
 
 #include <filesystem>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <iostream>
+#include <set>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <atomic>
+#include <fstream>
+#include <unordered_map>
+#include <string_view>
+#include <tuple>
+
+namespace {
+
+// Job summary line for the per-worker memory high-water marks. Jobs that
+// map a file buffer in place report its size ("input buffer"); the others
+// report the high-water mark of their per-task arena ("task arena").
+void logMemorySummary(Logger& logger,
+                      const std::string& taskLabel,
+                      const std::vector<std::size_t>& taskPeaks,
+                      const std::vector<std::size_t>& poolPeaks) {
+    std::size_t maxTask = 0;
+    for (std::size_t peak : taskPeaks) {
+        maxTask = std::max(maxTask, peak);
+    }
+    std::size_t totalPool = 0;
+    for (std::size_t peak : poolPeaks) {
+        totalPool += peak;
+    }
+
+    std::string message = "Memory: largest " + taskLabel + " " + std::to_string(maxTask / 1024) + " KiB";
+    if (!poolPeaks.empty()) {
+        message += ", aggregation pools " + std::to_string(totalPool / 1024) + " KiB peak across " +
+                   std::to_string(poolPeaks.size()) + " worker(s)";
+    }
+    logger.log(message + ".");
+}
+
+// Map output received by each reduce partition, and the largest partition
+// against the mean: a hot key shows up as a values outlier.
+void logPartitionLoads(Logger& logger, const std::vector<PartitionLoad>& loads) {
+    if (loads.empty()) {
+        return;
+    }
+    std::size_t totalKeys = 0, totalValues = 0, maxKeys = 0, maxValues = 0;
+    for (std::size_t p = 0; p < loads.size(); ++p) {
+        logger.log("Partition " + std::to_string(p) + ": " + std::to_string(loads[p].keys) + " keys, " +
+                   std::to_string(loads[p].values) + " values.");
+        totalKeys += loads[p].keys;
+        totalValues += loads[p].values;
+        maxKeys = std::max(maxKeys, loads[p].keys);
+        maxValues = std::max(maxValues, loads[p].values);
+    }
+    auto percentOfMean = [&](std::size_t largest, std::size_t total) {
+        return total == 0 ? std::string("-")
+                          : std::to_string(largest * 100 * loads.size() / total) + "%";
+    };
+    logger.log("Largest partition vs. mean: keys " + percentOfMean(maxKeys, totalKeys) + ", values " +
+               percentOfMean(maxValues, totalValues) + ".");
+}
+
+// Set from a signal handler to end watch mode after a final publish.
+std::atomic<bool> g_stopRequested{ false };
+
+// Bytes [from, to) of a file. Returns false if it cannot be read.
+bool readRange(const std::filesystem::path& path, std::uintmax_t from, std::uintmax_t to,
+               std::vector<char>& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    in.seekg(static_cast<std::streamoff>(from));
+    data.resize(static_cast<std::size_t>(to - from));
+    in.read(data.data(), static_cast<std::streamsize>(data.size()));
+    data.resize(static_cast<std::size_t>(in.gcount()));
+    return true;
+}
+
+// Rough footprint of one entry in a worker's ID -> count table (node plus
+// bucket share), used to charge aggregation growth against the budget.
+const std::size_t kBytesPerCountEntry = 48;
+
+// Grep splits a file into ranges of at least this size for the workers.
+const std::size_t kGrepRangeBytes = 4 * 1024 * 1024;
+
+} // namespace
 
 MapReduceController::MapReduceController(const std::string& inputPath,
                                          const std::string& outputFile,
                                          unsigned int workerCount)
     : inputPath_(inputPath),
       outputFile_(outputFile),
-      workerCount_(workerCount < 3 ? 3u : workerCount) { // ensure at least 3
+      workerCount_(workerCount) {
 }
 
 bool MapReduceController::run(Logger& logger) {
     logger.log("Starting MapReduce workflow...");
 
     FileManager fileManager(inputPath_);
-    std::vector<std::filesystem::path> files = fileManager.listTextFiles();
+    fileManager.setDiscoveryOptions(discovery_);
+
+    // Readers are sized later, by the modes that have a read stage.
+    if (workerCount_ == 0) {
+        tuneWorkers(logger, fileManager);
+    }
+
+    if (watch_) {
+        return runWatch(logger, fileManager);
+    }
+    if (windowed_) {
+        return runWindowed(logger, fileManager);
+    }
+    if (!jobs_.empty()) {
+        return runFused(logger, fileManager);
+    }
+    if (grep_) {
+        return runGrep(logger, fileManager);
+    }
+    if (dagMode_) {
+        DagRunOptions options;
+        options.inputPath = inputPath_;
+        options.workers = workerCount_;
+        options.memoryLimit = memoryLimit_;
+        options.spillDir = spillDir_.empty()
+            ? (std::filesystem::path(outputFile_).parent_path() / "spill").string()
+            : spillDir_;
+        options.outputCodec = outputCodec_;
+        options.spillCodec = spillCodec_;
+        options.inputFiles = inputFiles_;
+        options.inputListed = inputListed_;
+        return dag_.run(fileManager, options, logger);
+    }
+    if (!approximate_ && !invertedIndex_ && !tfIdf_ && !cooccurrence_ && ngramSize_ <= 1 && incrementalCache_.empty()) {
+        return runWordCount(logger, fileManager);
+    }
+    if (StreamSource::isStream(inputPath_)) {
+        logger.log("Streaming input is only supported by the word-count job.");
+        return false;
+    }
+
+    // The other modes need the complete, ordered file list up front.
+    std::vector<std::filesystem::path> files =
+        inputListed_ ? inputFiles_ : fileManager.listTextFiles(workerCount_);
 
     if (files.empty()) {
-        logger.log("No .txt files found. Nothing to do.");
+        if (!incrementalCache_.empty()) {
+            // The cached files may all have been removed; their counts still
+            // have to be subtracted and the empty result written.
+            logger.log("No input files found; dropping cached files.");
+            return runIncremental(logger, fileManager, files);
+        }
+        logger.log("No input files found. Nothing to do.");
         return false;
     }
 
     logger.log("Discovered " + std::to_string(files.size()) + " file(s).");
 
+    if (approximate_) {
+        return runApproximate(logger, fileManager, files);
+    }
+    if (invertedIndex_) {
+        return runInvertedIndex(logger, fileManager, files);
+    }
+    if (tfIdf_) {
+        return runTfIdf(logger, fileManager, files);
+    }
+    if (cooccurrence_) {
+        return runCooccurrence(logger, fileManager, files);
+    }
+    if (ngramSize_ > 1) {
+        return runNGram(logger, fileManager, files);
+    }
+    if (!incrementalCache_.empty()) {
+        return runIncremental(logger, fileManager, files);
+    }
+
+    return false;
+}
+
+void MapReduceController::startDiscovery(FileDiscovery& discovery, FileQueue& queue) {
+    if (!inputListed_) {
+        discovery.start(queue, workerCount_);
+        return;
+    }
+    for (const auto& file : inputFiles_) {
+        queue.push(file);
+    }
+    queue.close();
+}
+
+void MapReduceController::tuneWorkers(Logger& logger, FileManager& fileManager) {
+    CpuProfile cpus = detectCpus();
+    if (!inputListed_ && !StreamSource::isStream(inputPath_)) {
+        inputFiles_ = fileManager.listTextFiles(cpus.available);
+        inputListed_ = true;
+        inputProfile_ = profileInput(inputFiles_);
+        throughputProbe_ = probeThroughput(inputFiles_);
+    }
+
+    WorkerPlan plan = planWorkers(cpus, inputProfile_, throughputProbe_, workerCount_);
+    workerCount_ = plan.mapWorkers;
+    if (readers_ == 0) {
+        readers_ = plan.readers;
+    }
+    logger.log("Auto-tuned pools: " + std::to_string(workerCount_) + " map worker(s), " +
+               std::to_string(readers_) + " reader(s) (" + plan.reason + ").");
+}
+
+bool MapReduceController::runWordCount(Logger& logger, FileManager& fileManager) {
+    Mapper mapper;
+    SymbolTable symbols;
+    MemoryBudget budget(memoryLimit_);
+
+
+    // Each worker counts word IDs locally and hands its table to the
+    // reducers already split by partition; words are never copied as
+    // strings after they are first interned.
+    std::vector<PartitionedCounts> mapped(workerCount_);
+
+    // Sorted runs spilled by each worker, by partition.
+    std::vector<std::vector<std::vector<std::string>>> spilled(workerCount_);
+    std::filesystem::path spillDir = spillDir_;
+    if (budget.limited()) {
+        if (spillDir.empty()) {
+            spillDir = std::filesystem::path(outputFile_).parent_path() / "spill";
+        }
+        fileManager.ensureDirectory(spillDir);
+        logger.log("Memory limit: " + std::to_string(memoryLimit_ / 1024) + " KiB, spilling to " +
+                   spillDir.string());
+    }
+
+    // Table growth is reserved in steps sized from the budget so a worker
+    // spills before it overshoots.
+    const std::size_t reserveStep = budget.shareFor(workerCount_, 1.0 / 64, 16 * 1024, 1024 * 1024);
+
+    // Input arrives either from files or as line-aligned batches of a
+    // stream; in both cases at most readAhead_ filled buffers per worker
+    // wait in the queue ahead of the mappers.
+    const std::size_t buffersInFlight = std::max<std::size_t>(1, readAhead_) * workerCount_;
+    const bool streaming = StreamSource::isStream(inputPath_);
+
+    FileQueue queue;
+    FileDiscovery discovery(inputPath_, fileManager.discoveryOptions());
+    std::unique_ptr<ReadAheadPipeline> fileReader;
+    std::unique_ptr<StreamSource> streamReader;
+    BufferSource* source = nullptr;
+    if (streaming) {
+        const std::size_t batchBytes = budget.shareFor(workerCount_, 0.25, 256 * 1024, 4 * 1024 * 1024);
+        streamReader = std::make_unique<StreamSource>(inputPath_, batchBytes, buffersInFlight, &budget);
+        if (!streamReader->start()) {
+            return false;
+        }
+        source = streamReader.get();
+        logger.log("Streaming input from " + inputPath_ + " in " + std::to_string(batchBytes / 1024) +
+                   " KiB batches.");
+    } else {
+        // Files are mapped as soon as the walkers find them, so map work
+        // starts before enumeration of a large tree has finished.
+        if (readers_ == 0) {
+            tuneWorkers(logger, fileManager);
+        }
+        startDiscovery(discovery, queue);
+        fileReader = std::make_unique<ReadAheadPipeline>(queue, readers_, buffersInFlight, &budget);
+        if (budget.limited()) {
+            // Whole files would not be bounded by the limit; read them in
+            // chunks that share the budget with the tables being mapped.
+            fileReader->setChunkSize(budget.shareFor(static_cast<unsigned int>(buffersInFlight + workerCount_),
+                                                     0.25, 4 * 1024, 4 * 1024 * 1024));
+        }
+        fileReader->start();
+        source = fileReader.get();
+    }
+
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+    std::vector<std::size_t> poolPeaks(workerCount_, 0);
+
+    // Live tables, visible to the partial-result emitter. A worker holds its
+    // lock while it maps a buffer.
+    using CountTable = std::pmr::unordered_map<std::uint32_t, std::size_t>;
+    std::vector<CountTable*> liveCounts(workerCount_, nullptr);
+    std::vector<std::mutex> liveLocks(workerCount_);
+
+    // Worker tables outlive the workers: hot keys are detected across all
+    // of them before any is partitioned.
+    std::vector<std::unique_ptr<AggregationPool>> pools(workerCount_);
+    std::vector<std::unique_ptr<CountTable>> tables(workerCount_);
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        pools[i] = std::make_unique<AggregationPool>();
+        tables[i] = std::make_unique<CountTable>(pools[i]->resource());
+    }
+
+    std::atomic<bool> spillFailed{ false };
+
+    auto worker = [&](unsigned int workerId) {
+        SymbolCache cache(symbols);
+        AggregationPool& pool = *pools[workerId];
+        CountTable& counts = *tables[workerId];
+        std::size_t reserved = 0;
+        unsigned int spillCount = 0;
+        spilled[workerId].resize(workerCount_);
+        {
+            std::lock_guard<std::mutex> lock(liveLocks[workerId]);
+            liveCounts[workerId] = &counts;
+        }
+
+        // Write the table as one sorted run per partition and give its memory
+        // back to the budget.
+        auto spill = [&]() {
+            PartitionedCounts parts = Reducer::partition(counts, workerCount_);
+            std::pmr::unordered_map<std::uint32_t, std::size_t>(pool.resource()).swap(counts);
+            pool.release();
+            for (unsigned int p = 0; p < parts.size(); ++p) {
+                if (parts[p].empty()) {
+                    continue;
+                }
+                std::sort(parts[p].begin(), parts[p].end());
+                std::string path = (spillDir / ("spill-w" + std::to_string(workerId) + "-" +
+                                                std::to_string(spillCount) + "-p" +
+                                                std::to_string(p) + ".run")).string();
+                // The table is already gone, so a lost run would silently
+                // drop counts: fail the job instead.
+                if (!SpillWriter::write(path, parts[p], spillCodec_)) {
+                    spillFailed = true;
+                    break;
+                }
+                spilled[workerId][p].push_back(path);
+            }
+            ++spillCount;
+            budget.release(reserved);
+            reserved = 0;
+        };
+
+        FileBuffer buffer;
+        while (source->next(buffer)) {
+            if (spillFailed) {
+                // Drain the source so the read stage can finish.
+                source->release(buffer);
+                continue;
+            }
+            const std::string filePath = buffer.path.string();
+            logger.log("Worker processing file: " + filePath);
+            std::unique_lock<std::mutex> live(liveLocks[workerId]);
+
+            // Line breaks are not word characters, so the whole buffer can
+            // be scanned at once.
+            std::string_view text(buffer.data.data(), buffer.data.size());
+            mapper.forEachWord(text, [&](const std::string& word) {
+                ++counts[cache.intern(word)];
+                if (counts.size() * kBytesPerCountEntry > reserved) {
+                    if (budget.tryReserve(reserveStep)) {
+                        reserved += reserveStep;
+                    } else if (counts.size() * kBytesPerCountEntry >= reserveStep) {
+                        spill();
+                    } else {
+                        // Too small to be worth a run; overshoot by one step.
+                        budget.forceReserve(reserveStep);
+                        reserved += reserveStep;
+                    }
+                }
+            });
+
+            live.unlock();
+            taskPeaks[workerId] = std::max(taskPeaks[workerId], buffer.data.size());
+            source->release(buffer);
+            logger.log("Finished file: " + filePath);
+        }
+
+        if (spillCount > 0) {
+            logger.log("Worker " + std::to_string(workerId) + " spilled " +
+                       std::to_string(spillCount) + " time(s).");
+        }
+
+        std::lock_guard<std::mutex> lock(liveLocks[workerId]);
+        liveCounts[workerId] = nullptr;
+    };
+
+    // Periodic partial results: every partialInterval_ seconds the live
+    // tables are summed and the output file is replaced (atomically) with
+    // the counts so far.
+    std::mutex partialMutex;
+    std::condition_variable partialWake;
+    bool mappingDone = false;
+    std::thread partialEmitter;
+    if (partialInterval_ > 0) {
+        partialEmitter = std::thread([&]() {
+            std::unique_lock<std::mutex> lock(partialMutex);
+            unsigned int emitted = 0;
+            while (!partialWake.wait_for(lock, std::chrono::seconds(partialInterval_),
+                                         [&] { return mappingDone; })) {
+                lock.unlock();
+                std::unordered_map<std::uint32_t, std::size_t> totals;
+                for (unsigned int w = 0; w < workerCount_; ++w) {
+                    std::lock_guard<std::mutex> live(liveLocks[w]);
+                    if (liveCounts[w] != nullptr) {
+                        for (const auto& entry : *liveCounts[w]) {
+                            totals[entry.first] += entry.second;
+                        }
+                    }
+                }
+                std::vector<std::pair<std::string, std::size_t>> rows;
+                rows.reserve(totals.size());
+                for (const auto& entry : totals) {
+                    rows.emplace_back(std::string(symbols.textLocked(entry.first)), entry.second);
+                }
+                if (topK_ > 0) {
+                    rows = Reducer::selectTopK(rows, topK_);
+                } else {
+                    std::sort(rows.begin(), rows.end());
+                }
+                if (writeResults(fileManager, rows)) {
+                    logger.log("Partial result " + std::to_string(++emitted) + ": " +
+                               std::to_string(rows.size()) + " words written to " + outputFile_ +
+                               (budget.limited() ? " (excluding spilled counts)." : "."));
+                } else {
+                    // The next interval tries again; the final write decides the job.
+                    logger.log("Failed to write partial result to " + outputFile_);
+                }
+                lock.lock();
+            }
+        });
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker, i);
+    }
+
+    for (auto& t : workers) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    if (partialEmitter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(partialMutex);
+            mappingDone = true;
+        }
+        partialWake.notify_all();
+        partialEmitter.join();
+    }
+
+    if (streaming) {
+        streamReader->join();
+        if (streamReader->failed()) {
+            logger.log("Reading the stream failed after " + std::to_string(streamReader->bytesRead() / 1024) +
+                       " KiB; no results written.");
+            return false;
+        }
+        logger.log("Stream ended: " + std::to_string(streamReader->bytesRead() / 1024) + " KiB in " +
+                   std::to_string(streamReader->batches()) + " batch(es).");
+    } else {
+        fileReader->join();
+        discovery.join();
+
+        if (queue.pushed() == 0) {
+            logger.log("No input files found. Nothing to do.");
+            return false;
+        }
+        logger.log("Discovered and mapped " + std::to_string(queue.pushed()) + " file(s).");
+    }
+
+    logger.log("Mapping complete. " + std::to_string(symbols.size()) + " distinct words, " +
+               std::to_string(symbols.arenaBytes() / 1024) + " KiB of interned text. Reducing results...");
+
+    // Heavy hitters are found from the map-side tables and salted over
+    // several reduce partitions instead of landing on one.
+    HotKeys hotKeys;
+    if (hotKeyFraction_ > 0) {
+        std::vector<const CountTable*> finalTables;
+        for (const auto& table : tables) {
+            finalTables.push_back(table.get());
+        }
+        hotKeys.detect(finalTables, hotKeyFraction_, workerCount_);
+        std::string names;
+        for (std::size_t i = 0; i < hotKeys.keys().size() && i < 5; ++i) {
+            names += (i == 0 ? ": " : ", ") + std::string(symbols.text(hotKeys.keys()[i].first)) + " (" +
+                     std::to_string(hotKeys.keys()[i].second) + ")";
+        }
+        logger.log(std::to_string(hotKeys.keys().size()) + " hot key(s) salted over " +
+                   std::to_string(workerCount_) + " partitions" + names +
+                   (hotKeys.keys().size() > 5 ? ", ..." : ""));
+    }
+
+    std::vector<std::thread> partitioners;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        partitioners.emplace_back([&, i]() {
+            mapped[i] = Reducer::partition(*tables[i], workerCount_, hotKeys.empty() ? nullptr : &hotKeys, i);
+            tables[i].reset();
+            poolPeaks[i] = pools[i]->highWaterMark();
+            pools[i].reset();
+        });
+    }
+    for (auto& t : partitioners) {
+        t.join();
+    }
+
+    logMemorySummary(logger, "input buffer", taskPeaks, poolPeaks);
+    logPartitionLoads(logger, Reducer::partitionLoads(mapped));
+
+    std::vector<std::vector<std::string>> spillRuns(workerCount_);
+    std::size_t runCount = 0;
+    for (const auto& runs : spilled) {
+        for (std::size_t p = 0; p < runs.size(); ++p) {
+            spillRuns[p].insert(spillRuns[p].end(), runs[p].begin(), runs[p].end());
+            runCount += runs[p].size();
+        }
+    }
+    if (budget.limited()) {
+        logger.log("Memory budget peak " + std::to_string(budget.peak() / 1024) + " KiB; " +
+                   std::to_string(runCount) + " spill run(s) to merge.");
+    }
+
+    if (topK_ > 0) {
+        logger.log("Selecting top " + std::to_string(topK_) + " words.");
+    }
+
+    Reducer reducer;
+    std::vector<std::pair<std::string, std::size_t>> reduced;
+    const bool reducedAll = !spillFailed &&
+        reducer.reduceIds(mapped, symbols, topK_, reduced, spillRuns, hotKeys.empty() ? nullptr : &hotKeys);
+
+    for (const auto& runs : spillRuns) {
+        for (const auto& path : runs) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+    }
+
+    if (!reducedAll) {
+        logger.log("Spilled counts were lost (" + std::string(spillFailed ? "spill write" : "spill merge") +
+                   " failed); no output written.");
+        return false;
+    }
+
+    if (!writeResults(fileManager, reduced)) {
+        return false;
+    }
+
+    logger.log("MapReduce workflow complete. Output written to: " + outputFile_);
+
+    return true;
+}
+
+void MapReduceController::setIncrementalCache(const std::string& cacheFile) {
+    incrementalCache_ = cacheFile;
+}
+
+void MapReduceController::setDiscovery(const DiscoveryOptions& options) {
+    discovery_ = options;
+}
+
+void MapReduceController::setReadAhead(unsigned int readers, std::size_t buffersPerWorker) {
+    readers_ = readers;
+    readAhead_ = buffersPerWorker;
+}
+
+void MapReduceController::setPartialResults(unsigned int intervalSeconds) {
+    partialInterval_ = intervalSeconds;
+}
+
+void MapReduceController::setCompression(Codec output, Codec spills) {
+    outputCodec_ = output;
+    spillCodec_ = spills;
+}
+
+void MapReduceController::setMemoryLimit(std::size_t bytes, const std::string& spillDir) {
+    memoryLimit_ = bytes;
+    spillDir_ = spillDir;
+}
+
+void MapReduceController::setTopK(std::size_t k) {
+    topK_ = k;
+}
+
+void MapReduceController::setOutputFormat(OutputFormat format, bool withBloomFilter) {
+    outputFormat_ = format;
+    withBloomFilter_ = withBloomFilter;
+}
+
+void MapReduceController::setApproximate(const ApproximateOptions& options,
+                                         const std::string& sketchFile) {
+    approximate_ = true;
+    approximateOptions_ = options;
+    sketchFile_ = sketchFile;
+}
+
+bool MapReduceController::runApproximate(Logger& logger,
+                                         FileManager& fileManager,
+                                         const std::vector<std::filesystem::path>& files) {
+    logger.log("Approximate mode: epsilon " + std::to_string(approximateOptions_.epsilon) +
+               ", delta " + std::to_string(approximateOptions_.delta) +
+               ", heavy hitters " + std::to_string(approximateOptions_.heavyHitters) +
+               ", HLL precision " + std::to_string(approximateOptions_.hllPrecision));
+
     Mapper mapper;
-    std::vector<std::pair<std::string, int>> allPairs;
-    std::mutex pairsMutex;
+
+    // One sketch per worker, so adds never contend; they are merged at the end.
+    std::vector<WordSketch> sketches(workerCount_, WordSketch(approximateOptions_));
 
     std::size_t index = 0;
     std::mutex indexMutex;
 
-    auto worker = [&]() {
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+
+    auto worker = [&](unsigned int workerId) {
+        WordSketch& sketch = sketches[workerId];
+        TaskArena arena;
         while (true) {
             std::filesystem::path filePath;
             {
@@ -54,26 +648,125 @@ bool MapReduceController::run(Logger& logger) {
 
             logger.log("Worker processing file: " + filePath.string());
 
-            std::vector<std::string> lines = fileManager.readAllLines(filePath);
-            std::vector<std::pair<std::string, int>> localPairs;
+            // Recycle the previous task's working memory in one step.
+            arena.reset();
 
+            auto lines = fileManager.readAllLines(filePath, arena.resource());
             for (const auto& line : lines) {
-                auto mapped = mapper.mapLine(line);
-                localPairs.insert(localPairs.end(), mapped.begin(), mapped.end());
+                mapper.forEachWord(line, [&sketch](const std::string& word) {
+                    sketch.add(word);
+                });
             }
 
+            logger.log("Finished file: " + filePath.string());
+        }
+
+        taskPeaks[workerId] = arena.highWaterMark();
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker, i);
+    }
+
+    for (auto& t : workers) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+
+    logger.log("Mapping complete. Merging sketches...");
+    logMemorySummary(logger, "task arena", taskPeaks, {});
+
+    WordSketch& merged = sketches.front();
+    for (std::size_t i = 1; i < sketches.size(); ++i) {
+        merged.merge(sketches[i]);
+    }
+
+    if (!sketchFile_.empty()) {
+        fileManager.ensureDirectory(std::filesystem::path(sketchFile_).parent_path());
+        if (!merged.save(sketchFile_)) {
+            logger.log("Failed to save sketch: " + sketchFile_);
+            return false;
+        }
+        logger.log("Sketch saved to: " + sketchFile_);
+    }
+
+    std::filesystem::path outPath(outputFile_);
+    fileManager.ensureDirectory(outPath.parent_path());
+    if (!merged.writeReport(outputFile_, topK_)) {
+        return false;
+    }
+
+    logger.log("Approximate workflow complete. " + std::to_string(merged.totalWords()) +
+               " words, ~" + std::to_string(static_cast<unsigned long long>(merged.estimateDistinct())) +
+               " distinct. Report written to: " + outputFile_);
+
+    return true;
+}
+
+void MapReduceController::setNGramSize(unsigned int n) {
+    ngramSize_ = n;
+}
+
+bool MapReduceController::runNGram(Logger& logger,
+                                   FileManager& fileManager,
+                                   const std::vector<std::filesystem::path>& files) {
+    logger.log("N-gram mode: n = " + std::to_string(ngramSize_));
+
+    Mapper mapper;
+    SymbolTable symbols;
+
+    // Each worker aggregates into its own table keyed by token-ID tuples;
+    // text is only rebuilt for the rows that are written.
+    std::vector<NGramTable> tables(workerCount_, NGramTable(ngramSize_));
+
+    std::size_t index = 0;
+    std::mutex indexMutex;
+
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+
+    auto worker = [&](unsigned int workerId) {
+        NGramTable& table = tables[workerId];
+        SymbolCache tokens(symbols);
+        NGramWindow window(ngramSize_);
+        TaskArena arena;
+
+        while (true) {
+            std::filesystem::path filePath;
             {
-                std::lock_guard<std::mutex> lock(pairsMutex);
-                allPairs.insert(allPairs.end(), localPairs.begin(), localPairs.end());
+                std::lock_guard<std::mutex> lock(indexMutex);
+                if (index >= files.size()) {
+                    break;
+                }
+                filePath = files[index];
+                ++index;
+            }
+
+            logger.log("Worker processing file: " + filePath.string());
+
+            // Recycle the previous task's working memory in one step.
+            arena.reset();
+
+            window.reset();
+            auto lines = fileManager.readAllLines(filePath, arena.resource());
+            for (const auto& line : lines) {
+                mapper.forEachWord(line, [&](const std::string& word) {
+                    if (window.push(tokens.intern(word))) {
+                        table.add(window.ids());
+                    }
+                });
             }
 
             logger.log("Finished file: " + filePath.string());
         }
+
+        taskPeaks[workerId] = arena.highWaterMark();
     };
 
     std::vector<std::thread> workers;
     for (unsigned int i = 0; i < workerCount_; ++i) {
-        workers.emplace_back(worker);
+        workers.emplace_back(worker, i);
     }
 
     for (auto& t : workers) {
@@ -82,15 +775,1315 @@ bool MapReduceController::run(Logger& logger) {
         }
     }
 
-    logger.log("Mapping complete. Reducing results...");
+    logger.log("Mapping complete. Merging n-gram tables...");
+    logMemorySummary(logger, "task arena", taskPeaks, {});
 
-    Reducer reducer;
-    auto reduced = reducer.reduce(allPairs);
+    NGramTable& merged = tables.front();
+    for (std::size_t i = 1; i < tables.size(); ++i) {
+        merged.merge(tables[i]);
+        tables[i] = NGramTable(ngramSize_);
+    }
 
-    std::filesystem::path outPath(outputFile_);
-    fileManager.ensureDirectory(outPath.parent_path());
+    logger.log(std::to_string(merged.size()) + " distinct n-grams over " +
+               std::to_string(symbols.size()) + " tokens, " +
+               std::to_string(merged.memoryBytes() / 1024) + " KiB of table memory.");
+
+    if (!writeResults(fileManager, ngramRows(merged, symbols, topK_))) {
+        return false;
+    }
+
+    logger.log("N-gram workflow complete. Output written to: " + outputFile_);
+
+    return true;
+}
+
+void MapReduceController::setInvertedIndex(bool enabled) {
+    invertedIndex_ = enabled;
+}
+
+bool MapReduceController::runInvertedIndex(Logger& logger,
+                                           FileManager& fileManager,
+                                           const std::vector<std::filesystem::path>& files) {
+    logger.log("Inverted index mode.");
+
+    Mapper mapper;
+    SymbolTable symbols;
+
+    // Map output per worker: term ID -> postings of the documents it mapped.
+    // Document IDs are positions in the (sorted) file list.
+    using WorkerPostings = std::unordered_map<std::uint32_t, std::vector<DocPostings>>;
+    std::vector<WorkerPostings> mapped(workerCount_);
+
+    std::size_t index = 0;
+    std::mutex indexMutex;
+
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+
+    auto worker = [&](unsigned int workerId) {
+        WorkerPostings& postings = mapped[workerId];
+        SymbolCache tokens(symbols);
+        TaskArena arena;
+
+        while (true) {
+            std::uint32_t docId = 0;
+            {
+                std::lock_guard<std::mutex> lock(indexMutex);
+                if (index >= files.size()) {
+                    break;
+                }
+                docId = static_cast<std::uint32_t>(index);
+                ++index;
+            }
+            const std::filesystem::path& filePath = files[docId];
 
-    fileManager.writeWordCounts(outputFile_, reduced);
+            logger.log("Worker processing file: " + filePath.string());
+
+            // Recycle the previous task's working memory in one step.
+            arena.reset();
+
+            std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> fileLines;
+            auto lines = fileManager.readAllLines(filePath, arena.resource());
+            for (std::size_t i = 0; i < lines.size(); ++i) {
+                std::uint32_t lineNumber = static_cast<std::uint32_t>(i + 1);
+                mapper.forEachWord(lines[i], [&](const std::string& word) {
+                    std::vector<std::uint32_t>& termLines = fileLines[tokens.intern(word)];
+                    if (termLines.empty() || termLines.back() != lineNumber) {
+                        termLines.push_back(lineNumber);
+                    }
+                });
+            }
+
+            for (auto& entry : fileLines) {
+                DocPostings doc;
+                doc.docId = docId;
+                doc.lines = std::move(entry.second);
+                postings[entry.first].push_back(std::move(doc));
+            }
+
+            logger.log("Finished file: " + filePath.string());
+        }
+
+        taskPeaks[workerId] = arena.highWaterMark();
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker, i);
+    }
+    for (auto& t : workers) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+
+    logger.log("Mapping complete. Building posting lists...");
+    logMemorySummary(logger, "task arena", taskPeaks, {});
+
+    // Reduce: terms are partitioned by ID; each partition gathers the term's
+    // postings from every worker, orders them by document and compresses them.
+    const unsigned int partitions = workerCount_;
+    std::vector<std::vector<EncodedTerm>> reduced(partitions);
+
+    auto reducer = [&](unsigned int partition) {
+        std::unordered_map<std::uint32_t, std::vector<DocPostings>> gathered;
+        for (auto& postings : mapped) {
+            for (auto& entry : postings) {
+                if (Reducer::partitionOf(entry.first, partitions) != partition) {
+                    continue;
+                }
+                std::vector<DocPostings>& docs = gathered[entry.first];
+                for (auto& doc : entry.second) {
+                    docs.push_back(std::move(doc));
+                }
+            }
+        }
+
+        reduced[partition].reserve(gathered.size());
+        for (auto& entry : gathered) {
+            std::vector<DocPostings>& docs = entry.second;
+            std::sort(docs.begin(), docs.end(), [](const DocPostings& a, const DocPostings& b) {
+                return a.docId < b.docId;
+            });
+
+            EncodedTerm term;
+            term.term = std::string(symbols.text(entry.first));
+            term.docFreq = static_cast<std::uint32_t>(docs.size());
+            InvertedIndexWriter::encodePostings(docs, term.postings);
+            reduced[partition].push_back(std::move(term));
+        }
+    };
+
+    std::vector<std::thread> reducers;
+    for (unsigned int p = 0; p < partitions; ++p) {
+        reducers.emplace_back(reducer, p);
+    }
+    for (auto& t : reducers) {
+        t.join();
+    }
+
+    std::vector<EncodedTerm> terms;
+    terms.reserve(symbols.size());
+    for (auto& partition : reduced) {
+        for (auto& term : partition) {
+            terms.push_back(std::move(term));
+        }
+    }
+    std::sort(terms.begin(), terms.end(), [](const EncodedTerm& a, const EncodedTerm& b) {
+        return a.term < b.term;
+    });
+
+    std::vector<std::string> documents;
+    documents.reserve(files.size());
+    for (const auto& filePath : files) {
+        documents.push_back(filePath.string());
+    }
+
+    std::filesystem::path outPath(outputFile_);
+    fileManager.ensureDirectory(outPath.parent_path());
+    if (!InvertedIndexWriter::write(outputFile_, documents, terms)) {
+        return false;
+    }
+
+    logger.log("Inverted index complete: " + std::to_string(terms.size()) + " terms over " +
+               std::to_string(documents.size()) + " documents written to: " + outputFile_);
+
+    return true;
+}
+
+void MapReduceController::setHotKeys(double fraction) {
+    hotKeyFraction_ = fraction;
+}
+
+void MapReduceController::setTfIdf(bool enabled) {
+    tfIdf_ = enabled;
+}
+
+bool MapReduceController::runTfIdf(Logger& logger,
+                                   FileManager& fileManager,
+                                   const std::vector<std::filesystem::path>& files) {
+    logger.log("TF-IDF mode.");
+
+    Mapper mapper;
+    SymbolTable symbols;
+
+    // Map: every document is counted once into a local (term ID -> count)
+    // map. Its sparse term counts and length are kept for the weighting
+    // step, so the corpus is read only once; each worker also counts the
+    // documents containing each term, split by reduce partition.
+    // Document IDs are positions in the (sorted) file list.
+    using TermCount = std::pair<std::uint32_t, std::uint32_t>;
+    std::vector<std::vector<TermCount>> docTerms(files.size());
+    std::vector<std::uint32_t> docLengths(files.size(), 0);
+
+    const unsigned int partitions = workerCount_;
+    std::vector<PartitionedCounts> mapped(workerCount_);
+
+    std::atomic<std::size_t> next{ 0 };
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+
+    auto worker = [&](unsigned int workerId) {
+        SymbolCache tokens(symbols);
+        TaskArena arena;
+        std::pmr::unordered_map<std::uint32_t, std::size_t> docFreq;
+
+        for (std::size_t docId = next++; docId < files.size(); docId = next++) {
+            const std::filesystem::path& filePath = files[docId];
+            logger.log("Worker processing file: " + filePath.string());
+
+            arena.reset();
+            std::pmr::unordered_map<std::uint32_t, std::uint32_t> counts(arena.resource());
+            std::uint32_t length = 0;
+            auto lines = fileManager.readAllLines(filePath, arena.resource());
+            for (const auto& line : lines) {
+                mapper.forEachWord(line, [&](const std::string& word) {
+                    ++counts[tokens.intern(word)];
+                    ++length;
+                });
+            }
+
+            std::vector<TermCount>& terms = docTerms[docId];
+            terms.assign(counts.begin(), counts.end());
+            std::sort(terms.begin(), terms.end());
+            docLengths[docId] = length;
+            for (const TermCount& term : terms) {
+                ++docFreq[term.first];
+            }
+
+            logger.log("Finished file: " + filePath.string());
+        }
+
+        mapped[workerId] = Reducer::partition(docFreq, partitions);
+        taskPeaks[workerId] = arena.highWaterMark();
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker, i);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    logger.log("Mapping complete. Reducing document frequencies...");
+    logMemorySummary(logger, "task arena", taskPeaks, {});
+
+    // Reduce: document frequencies are summed per partition like word
+    // counts; the result is the term table, sorted by term.
+    Reducer reducer;
+    std::vector<std::pair<std::string, std::size_t>> terms;
+    if (!reducer.reduceIds(mapped, symbols, 0, terms)) {
+        return false;
+    }
+
+    // Symbol IDs (sharded, not dense) -> term IDs of the file (positions in
+    // the term table).
+    std::unordered_map<std::uint32_t, std::uint32_t> termIds;
+    termIds.reserve(terms.size());
+    for (std::size_t i = 0; i < terms.size(); ++i) {
+        termIds.emplace(symbols.find(terms[i].first), static_cast<std::uint32_t>(i));
+    }
+
+    // Weight every document's terms in parallel.
+    const double documents = static_cast<double>(files.size());
+    std::vector<TfIdfDocument> vectors(files.size());
+    next = 0;
+    auto weigh = [&]() {
+        std::vector<TermWeight> weights;
+        for (std::size_t docId = next++; docId < files.size(); docId = next++) {
+            TfIdfDocument& doc = vectors[docId];
+            doc.path = files[docId].string();
+            doc.length = docLengths[docId];
+
+            weights.clear();
+            for (const TermCount& term : docTerms[docId]) {
+                std::uint32_t termId = termIds.at(term.first);
+                double idf = std::log(documents / static_cast<double>(terms[termId].second));
+                if (idf > 0) {
+                    double tf = static_cast<double>(term.second) / doc.length;
+                    weights.push_back({ termId, static_cast<float>(tf * idf) });
+                }
+            }
+            std::sort(weights.begin(), weights.end(),
+                      [](const TermWeight& a, const TermWeight& b) { return a.termId < b.termId; });
+            TfIdfWriter::encodeVector(weights, doc);
+            std::vector<TermCount>().swap(docTerms[docId]);
+        }
+    };
+    workers.clear();
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(weigh);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    std::filesystem::path outPath(outputFile_);
+    fileManager.ensureDirectory(outPath.parent_path());
+    if (!TfIdfWriter::write(outputFile_, vectors, terms)) {
+        return false;
+    }
+
+    logger.log("TF-IDF complete: " + std::to_string(vectors.size()) + " document vectors over " +
+               std::to_string(terms.size()) + " terms written to: " + outputFile_);
+
+    return true;
+}
+
+void MapReduceController::setCooccurrence(const CooccurrenceOptions& options) {
+    cooccurrence_ = true;
+    cooccurrenceOptions_ = options;
+}
+
+bool MapReduceController::runCooccurrence(Logger& logger,
+                                          FileManager& fileManager,
+                                          const std::vector<std::filesystem::path>& files) {
+    const unsigned int window = cooccurrenceOptions_.window;
+    logger.log(window == 0 ? std::string("Co-occurrence mode: per line.")
+                           : "Co-occurrence mode: window = " + std::to_string(window) + ".");
+
+    Mapper mapper;
+    SymbolTable symbols;
+
+    // Map: every worker keeps one stripe (neighbor ID -> count) per word ID,
+    // already split by the word's reduce partition. Pairs are never
+    // materialized, as strings or otherwise.
+    using Stripes = std::unordered_map<std::uint32_t, Stripe>;
+    const unsigned int partitions = workerCount_;
+    std::vector<std::vector<Stripes>> mapped(workerCount_, std::vector<Stripes>(partitions));
+
+    std::atomic<std::size_t> next{ 0 };
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+
+    auto worker = [&](unsigned int workerId) {
+        std::vector<Stripes>& stripes = mapped[workerId];
+        SymbolCache tokens(symbols);
+        TaskArena arena;
+
+        auto addPair = [&](std::uint32_t a, std::uint32_t b) {
+            stripes[Reducer::partitionOf(a, partitions)][a].add(b);
+            if (a != b) {
+                stripes[Reducer::partitionOf(b, partitions)][b].add(a);
+            }
+        };
+
+        // Per line: the IDs of the line so far. Window: a ring of the last
+        // `window` IDs of the file.
+        std::vector<std::uint32_t> recent;
+
+        for (std::size_t index = next++; index < files.size(); index = next++) {
+            const std::filesystem::path& filePath = files[index];
+            logger.log("Worker processing file: " + filePath.string());
+
+            arena.reset();
+            recent.clear();
+            std::size_t seen = 0;
+            auto lines = fileManager.readAllLines(filePath, arena.resource());
+            for (const auto& line : lines) {
+                if (window == 0) {
+                    recent.clear();
+                }
+                mapper.forEachWord(line, [&](const std::string& word) {
+                    std::uint32_t id = tokens.intern(word);
+                    if (window == 0) {
+                        for (std::uint32_t other : recent) {
+                            addPair(id, other);
+                        }
+                        recent.push_back(id);
+                        return;
+                    }
+                    for (std::size_t back = 1; back <= std::min<std::size_t>(seen, window); ++back) {
+                        addPair(id, recent[(seen - back) % window]);
+                    }
+                    if (recent.size() < window) {
+                        recent.push_back(id);
+                    } else {
+                        recent[seen % window] = id;
+                    }
+                    ++seen;
+                });
+            }
+
+            logger.log("Finished file: " + filePath.string());
+        }
+
+        taskPeaks[workerId] = arena.highWaterMark();
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker, i);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    logger.log("Mapping complete. Merging stripes...");
+    logMemorySummary(logger, "task arena", taskPeaks, {});
+
+    // Reduce: each partition merges the stripes of its words from every
+    // worker, taking over the first one it sees.
+    std::vector<Stripes> reduced(partitions);
+    std::vector<std::size_t> stripeBytes(partitions, 0);
+    auto merge = [&](unsigned int partition) {
+        Stripes& rows = reduced[partition];
+        for (auto& perWorker : mapped) {
+            for (auto& entry : perWorker[partition]) {
+                auto inserted = rows.try_emplace(entry.first, std::move(entry.second));
+                if (!inserted.second) {
+                    inserted.first->second.merge(entry.second);
+                }
+            }
+            Stripes().swap(perWorker[partition]);
+        }
+        for (const auto& entry : rows) {
+            stripeBytes[partition] += entry.second.memoryBytes();
+        }
+    };
+    workers.clear();
+    for (unsigned int p = 0; p < partitions; ++p) {
+        workers.emplace_back(merge, p);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    // Term IDs of the file are positions in the dictionary, sorted by text.
+    std::vector<std::pair<std::string_view, std::uint32_t>> dictionary;
+    for (const auto& rows : reduced) {
+        for (const auto& entry : rows) {
+            dictionary.emplace_back(symbols.text(entry.first), entry.first);
+        }
+    }
+    std::sort(dictionary.begin(), dictionary.end());
+    std::vector<std::string> terms;
+    terms.reserve(dictionary.size());
+    std::unordered_map<std::uint32_t, std::uint32_t> termIds;
+    termIds.reserve(dictionary.size());
+    for (const auto& entry : dictionary) {
+        termIds.emplace(entry.second, static_cast<std::uint32_t>(terms.size()));
+        terms.emplace_back(entry.first);
+    }
+
+    // CSR arrays: row sizes are known, so every partition fills its rows
+    // in place.
+    std::vector<std::uint64_t> rowOffsets(terms.size() + 1, 0);
+    for (const auto& rows : reduced) {
+        for (const auto& entry : rows) {
+            rowOffsets[termIds.at(entry.first) + 1] = entry.second.size();
+        }
+    }
+    for (std::size_t r = 1; r < rowOffsets.size(); ++r) {
+        rowOffsets[r] += rowOffsets[r - 1];
+    }
+    std::vector<std::uint32_t> columns(static_cast<std::size_t>(rowOffsets.back()));
+    std::vector<std::uint64_t> values(columns.size());
+
+    auto fill = [&](unsigned int partition) {
+        std::vector<std::pair<std::uint32_t, std::uint64_t>> row;
+        for (auto& entry : reduced[partition]) {
+            row.clear();
+            entry.second.forEach([&](std::uint32_t id, std::uint64_t count) {
+                row.emplace_back(termIds.at(id), count);
+            });
+            std::sort(row.begin(), row.end());
+            std::size_t at = static_cast<std::size_t>(rowOffsets[termIds.at(entry.first)]);
+            for (const auto& cell : row) {
+                columns[at] = cell.first;
+                values[at] = cell.second;
+                ++at;
+            }
+            entry.second = Stripe();
+        }
+    };
+    workers.clear();
+    for (unsigned int p = 0; p < partitions; ++p) {
+        workers.emplace_back(fill, p);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    logger.log(std::to_string(terms.size()) + " terms, " + std::to_string(columns.size()) +
+               " nonzero cells, " +
+               std::to_string(std::accumulate(stripeBytes.begin(), stripeBytes.end(), std::size_t(0)) / 1024) +
+               " KiB of merged stripes.");
+
+    std::filesystem::path outPath(outputFile_);
+    fileManager.ensureDirectory(outPath.parent_path());
+    if (!CooccurrenceWriter::write(outputFile_, cooccurrenceOptions_, terms, rowOffsets, columns, values)) {
+        return false;
+    }
+
+    logger.log("Co-occurrence matrix written to: " + outputFile_);
+    return true;
+}
+
+bool MapReduceController::writeResults(
+    FileManager& fileManager,
+    const std::vector<std::pair<std::string, std::size_t>>& wordCounts) const {
+
+    std::filesystem::path outPath(outputFile_);
+    fileManager.ensureDirectory(outPath.parent_path());
+
+    if (outputFormat_ == OutputFormat::IndexedStore) {
+        return fileManager.writeWordCountStore(outputFile_, wordCounts, withBloomFilter_);
+    }
+    return fileManager.writeWordCounts(outputFile_, wordCounts, outputCodec_);
+}
+
+void MapReduceController::setWatch(const WatchOptions& options) {
+    watch_ = true;
+    watchOptions_ = options;
+}
+
+void MapReduceController::setWindow(const WindowOptions& options) {
+    windowed_ = true;
+    windowOptions_ = options;
+}
+
+bool MapReduceController::runWindowed(Logger& logger, FileManager& fileManager) {
+    TimestampExtractor extractor;
+    if (!extractor.configure(windowOptions_.timestamp)) {
+        return false;
+    }
+    const unsigned int slideSeconds = windowOptions_.slideSeconds == 0
+        ? std::max(1u, windowOptions_.windowSeconds)
+        : std::min(windowOptions_.slideSeconds, std::max(1u, windowOptions_.windowSeconds));
+    // The counter keeps whole slides, so the window is rounded up to a multiple.
+    const unsigned int windowSeconds =
+        (std::max(1u, windowOptions_.windowSeconds) + slideSeconds - 1) / slideSeconds * slideSeconds;
+    if (windowSeconds != windowOptions_.windowSeconds) {
+        logger.log("Window rounded up to " + std::to_string(windowSeconds) + " s, a multiple of the slide.");
+    }
+    WindowedCounter counter(windowSeconds, slideSeconds);
+    Mapper mapper;
+
+    logger.log(std::string(slideSeconds == windowSeconds ? "Tumbling" : "Sliding") + " window of " +
+               std::to_string(windowSeconds) + " s, advancing every " + std::to_string(slideSeconds) +
+               " s; timestamps: " + windowOptions_.timestamp);
+
+    auto publish = [&]() {
+        auto bounds = counter.bounds();
+        std::vector<std::pair<std::string, std::size_t>> rows = counter.query(topK_);
+        if (!writeResults(fileManager, rows)) {
+            logger.log("Failed to publish window results to " + outputFile_);
+            return false;
+        }
+        logger.log("Published " + std::to_string(rows.size()) + " words for window [" +
+                   std::to_string(bounds.first) + ", " + std::to_string(bounds.second) + ") to " +
+                   outputFile_);
+        return true;
+    };
+
+    // Lines are mapped in input order on one thread: event time decides
+    // which bucket a word lands in, so batches must not be reordered.
+    std::int64_t lastTimestamp = 0;
+    bool haveTimestamp = false;
+    std::size_t untimed = 0;
+    std::vector<std::string> words;
+    auto mapText = [&](std::string_view text) {
+        std::size_t start = 0;
+        while (start < text.size()) {
+            std::size_t newline = text.find('\n', start);
+            std::size_t stop = newline == std::string_view::npos ? text.size() : newline;
+            std::string_view line = text.substr(start, stop - start);
+            start = stop + 1;
+
+            std::int64_t seconds = 0;
+            std::size_t begin = 0, end = 0;
+            if (extractor.extract(line, seconds, begin, end)) {
+                lastTimestamp = seconds;
+                haveTimestamp = true;
+            } else if (haveTimestamp) {
+                // Continuation line (stack trace, wrapped message).
+                begin = end = 0;
+            } else {
+                ++untimed;
+                continue;
+            }
+
+            words.clear();
+            auto collect = [&](const std::string& word) { words.push_back(word); };
+            mapper.forEachWord(line.substr(0, begin), collect);
+            mapper.forEachWord(line.substr(end), collect);
+            counter.add(lastTimestamp, words);
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::seconds(std::max(1u, windowOptions_.publishSeconds));
+    auto nextPublish = Clock::now() + interval;
+    std::uint64_t publishedAdvances = 0;
+    auto maybePublish = [&]() {
+        std::uint64_t advances = counter.advances();
+        if (advances != publishedAdvances || Clock::now() >= nextPublish) {
+            publish();
+            publishedAdvances = advances;
+            nextPublish = Clock::now() + interval;
+        }
+    };
+
+    if (StreamSource::isStream(inputPath_)) {
+        StreamSource stream(inputPath_, 256 * 1024, std::max<std::size_t>(2, readAhead_));
+        if (!stream.start()) {
+            return false;
+        }
+        FileBuffer buffer;
+        while (!g_stopRequested && stream.next(buffer)) {
+            mapText(std::string_view(buffer.data.data(), buffer.data.size()));
+            stream.release(buffer);
+            maybePublish();
+        }
+        stream.join();
+    } else {
+        std::vector<std::filesystem::path> files =
+            inputListed_ ? inputFiles_ : fileManager.listTextFiles(workerCount_);
+        if (files.empty()) {
+            logger.log("No input files found. Nothing to do.");
+            return false;
+        }
+        // Sorted paths keep rotated logs (app.log.1, app.log.2 ...) in a
+        // stable order; out-of-order events inside the window still land
+        // in their own bucket.
+        std::vector<char> data;
+        for (const auto& file : files) {
+            if (g_stopRequested) {
+                break;
+            }
+            if (!fileManager.readContents(file, data)) {
+                logger.log("Failed to read: " + file.string());
+                continue;
+            }
+            mapText(std::string_view(data.data(), data.size()));
+            maybePublish();
+        }
+    }
+
+    const bool published = publish();
+    if (untimed > 0) {
+        logger.log("Skipped " + std::to_string(untimed) + " line(s) before the first timestamp.");
+    }
+    if (counter.late() > 0) {
+        logger.log("Dropped " + std::to_string(counter.late()) + " word(s) older than the window.");
+    }
+    return published;
+}
+
+void MapReduceController::addJob(std::unique_ptr<FusedJob> job) {
+    if (job) {
+        jobs_.push_back(std::move(job));
+    }
+}
+
+bool MapReduceController::runFused(Logger& logger, FileManager& fileManager) {
+    if (StreamSource::isStream(inputPath_)) {
+        logger.log("Streaming input is only supported by the word-count job.");
+        return false;
+    }
+
+    std::string names;
+    for (const auto& job : jobs_) {
+        names += (names.empty() ? "" : ", ") + job->name();
+        job->prepare(workerCount_);
+    }
+    logger.log("Fused scan for " + std::to_string(jobs_.size()) + " job(s): " + names);
+
+    Mapper mapper;
+    SymbolTable symbols;
+    MemoryBudget budget(memoryLimit_);
+
+    FileQueue queue;
+    FileDiscovery discovery(inputPath_, fileManager.discoveryOptions());
+    if (readers_ == 0) {
+        tuneWorkers(logger, fileManager);
+    }
+    startDiscovery(discovery, queue);
+    ReadAheadPipeline reader(queue, readers_, std::max<std::size_t>(1, readAhead_) * workerCount_, &budget);
+    reader.start();
+
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+    std::atomic<std::size_t> filesMapped{ 0 };
+
+    auto worker = [&](unsigned int workerId) {
+        SymbolCache cache(symbols);
+        std::vector<std::uint32_t> ids;
+
+        FileBuffer buffer;
+        while (reader.next(buffer)) {
+            if (!buffer.ok) {
+                reader.release(buffer);
+                continue;
+            }
+            const std::string filePath = buffer.path.string();
+            logger.log("Worker processing file: " + filePath);
+            for (auto& job : jobs_) {
+                job->beginFile(workerId, filePath, buffer.data.size());
+            }
+
+            // Tokenize each line once; every job sees the same IDs.
+            std::string_view text(buffer.data.data(), buffer.data.size());
+            std::size_t start = 0;
+            while (start < text.size()) {
+                std::size_t newline = text.find('\n', start);
+                std::size_t stop = newline == std::string_view::npos ? text.size() : newline;
+                ids.clear();
+                mapper.forEachWord(text.substr(start, stop - start), [&](const std::string& word) {
+                    ids.push_back(cache.intern(word));
+                });
+                for (auto& job : jobs_) {
+                    job->line(workerId, ids.data(), ids.size());
+                }
+                start = stop + 1;
+            }
+
+            for (auto& job : jobs_) {
+                job->endFile(workerId);
+            }
+            taskPeaks[workerId] = std::max(taskPeaks[workerId], buffer.data.size());
+            reader.release(buffer);
+            ++filesMapped;
+            logger.log("Finished file: " + filePath);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker, i);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    reader.join();
+    discovery.join();
+
+    if (filesMapped == 0) {
+        logger.log("No input files found. Nothing to do.");
+        return false;
+    }
+    logger.log("Scanned " + std::to_string(filesMapped.load()) + " file(s) once for all jobs.");
+    logMemorySummary(logger, "input buffer", taskPeaks, {});
+
+    bool ok = true;
+    for (const auto& job : jobs_) {
+        if (job->finish(symbols, fileManager, outputCodec_)) {
+            logger.log("Job " + job->name() + " written to: " + job->outputFile());
+        } else {
+            logger.log("Job " + job->name() + " failed.");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void MapReduceController::setDag(const JobDag& dag) {
+    dagMode_ = true;
+    dag_ = dag;
+}
+
+void MapReduceController::setGrep(const GrepOptions& options) {
+    grep_ = true;
+    grepOptions_ = options;
+}
+
+bool MapReduceController::runGrep(Logger& logger, FileManager& fileManager) {
+    if (StreamSource::isStream(inputPath_)) {
+        logger.log("Streaming input is only supported by the word-count job.");
+        return false;
+    }
+    GrepMatcher matcher;
+    if (!matcher.compile(grepOptions_)) {
+        return false;
+    }
+    std::vector<std::string> literals = grepOptions_.fixedString
+        ? std::vector<std::string>{ grepOptions_.pattern }
+        : requiredLiterals(grepOptions_.pattern);
+    std::string prefilter;
+    for (const auto& literal : literals) {
+        prefilter += (prefilter.empty() ? "\"" : ", \"") + literal + "\"";
+    }
+    logger.log("Grep for '" + grepOptions_.pattern + "'" +
+               (prefilter.empty() ? ", no literal prefilter" : ", prefilter " + prefilter));
+
+    fileManager.ensureDirectory(std::filesystem::path(outputFile_).parent_path());
+    AtomicOutputFile out;
+    if (!out.open(outputFile_)) {
+        logger.log("Cannot create output file: " + outputFile_);
+        return false;
+    }
+
+    MemoryBudget budget(memoryLimit_);
+    FileQueue queue;
+    FileDiscovery discovery(inputPath_, fileManager.discoveryOptions());
+    if (readers_ == 0) {
+        tuneWorkers(logger, fileManager);
+    }
+    startDiscovery(discovery, queue);
+    ReadAheadPipeline reader(queue, readers_, std::max<std::size_t>(1, readAhead_) * workerCount_, &budget);
+    reader.start();
+
+    // Large files are cut into line-aligned ranges that any worker may scan,
+    // so one big file does not leave the other workers idle. The buffer goes
+    // back to the reader once its last range is done.
+    struct Range {
+        std::shared_ptr<FileBuffer> buffer;
+        std::string_view text;
+        std::size_t base = 0;  // offset of `text` in the file
+    };
+    std::mutex rangeMutex;
+    std::vector<Range> pending;
+    std::atomic<std::size_t> files{ 0 };
+    std::atomic<std::size_t> matches{ 0 };
+    auto takeRange = [&](Range& range) {
+        std::lock_guard<std::mutex> lock(rangeMutex);
+        if (pending.empty()) {
+            return false;
+        }
+        range = std::move(pending.back());
+        pending.pop_back();
+        return true;
+    };
+    auto nextRange = [&](Range& range) {
+        FileBuffer next;
+        while (reader.next(next)) {
+            if (!next.ok) {
+                reader.release(next);
+                continue;
+            }
+            ++files;
+            if (next.data.empty()) {
+                reader.release(next);
+                continue;
+            }
+            std::shared_ptr<FileBuffer> buffer(new FileBuffer(std::move(next)), [&reader](FileBuffer* done) {
+                reader.release(*done);
+                delete done;
+            });
+            std::string_view text(buffer->data.data(), buffer->data.size());
+            unsigned int parts = static_cast<unsigned int>(
+                std::min<std::size_t>(workerCount_, std::max<std::size_t>(1, text.size() / kGrepRangeBytes)));
+            std::vector<std::string_view> ranges = splitLines(text, parts);
+            std::lock_guard<std::mutex> lock(rangeMutex);
+            for (std::size_t i = 1; i < ranges.size(); ++i) {
+                pending.push_back({ buffer, ranges[i], static_cast<std::size_t>(ranges[i].data() - text.data()) });
+            }
+            range = { buffer, ranges[0], 0 };
+            return true;
+        }
+        return false;
+    };
+
+    std::mutex outputMutex;
+    std::vector<std::tuple<std::string, std::size_t, std::string>> ordered;  // (path, base, matches)
+    bool writeFailed = false;
+    auto write = [&](const std::string& text) {
+        if (outputCodec_ == Codec::None) {
+            return out.append(text.data(), text.size());
+        }
+        std::vector<char> packed;
+        return compressBuffer(outputCodec_, text.data(), text.size(), packed) &&
+               out.append(packed.data(), packed.size());
+    };
+
+    auto worker = [&]() {
+        Range range;
+        std::string result;
+        while (takeRange(range) || nextRange(range)) {
+            const std::string filePath = range.buffer->path.string();
+            result.clear();
+            std::size_t found = 0;
+            matcher.scan(range.text, [&](std::size_t offset, std::string_view line) {
+                result += filePath;
+                result += ':';
+                result += std::to_string(range.base + offset);
+                result += ':';
+                result.append(line);
+                result += '\n';
+                ++found;
+            });
+            const std::size_t base = range.base;
+            range = Range();
+            matches += found;
+
+            if (found == 0) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(outputMutex);
+            if (grepOptions_.ordered) {
+                ordered.emplace_back(filePath, base, result);
+            } else if (!write(result)) {
+                writeFailed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    reader.join();
+    discovery.join();
+
+    if (files == 0) {
+        out.abort();
+        logger.log("No input files found. Nothing to do.");
+        return false;
+    }
+
+    std::sort(ordered.begin(), ordered.end());
+    for (const auto& entry : ordered) {
+        writeFailed = writeFailed || !write(std::get<2>(entry));
+    }
+    if (writeFailed || !out.commit()) {
+        logger.log("Failed to write grep output: " + outputFile_);
+        return false;
+    }
+
+    logger.log("Grep matched " + std::to_string(matches.load()) + " line(s) in " +
+               std::to_string(files.load()) + " file(s). Output written to: " + outputFile_);
+    return true;
+}
+
+std::vector<std::string> MapReduceController::outputFiles() const {
+    if (dagMode_) {
+        return dag_.outputs();
+    }
+    if (jobs_.empty()) {
+        return { outputFile_ };
+    }
+    std::vector<std::string> files;
+    for (const auto& job : jobs_) {
+        files.push_back(job->outputFile());
+    }
+    return files;
+}
+
+void MapReduceController::requestStop() {
+    g_stopRequested = true;
+}
+
+bool MapReduceController::runWatch(Logger& logger, FileManager& fileManager) {
+    WatchState state;
+    if (!watchOptions_.snapshotFile.empty() && state.load(watchOptions_.snapshotFile)) {
+        logger.log("Restored watch snapshot: " + std::to_string(state.files()) + " file(s) from " +
+                   watchOptions_.snapshotFile);
+    }
+
+    DirectoryWatcher watcher(watchOptions_.forcePolling,
+                             std::chrono::milliseconds(std::max(1u, watchOptions_.pollMilliseconds)));
+    Mapper mapper;
+
+    // New bytes of one file to map in this round.
+    struct Extent {
+        std::filesystem::path path;
+        WatchState::FileProgress* progress;
+        std::uintmax_t from;
+        std::uintmax_t to;
+        std::uintmax_t mappedTo;
+        bool whole;
+    };
+
+    // Appended bytes are read in chunks that end on a line boundary.
+    MemoryBudget budget(memoryLimit_);
+    const std::uintmax_t chunkBytes = budget.shareFor(workerCount_, 0.5, 64 * 1024, 16 * 1024 * 1024);
+
+    // Map whatever was appended or created since the last scan. Returns the
+    // number of bytes mapped. The final scan also maps a last line that has
+    // no newline yet, as a stream does at its end.
+    auto scan = [&](bool finalScan) -> std::uintmax_t {
+        std::vector<std::filesystem::path> files = fileManager.listTextFiles(workerCount_);
+        if (std::filesystem::is_directory(inputPath_)) {
+            watcher.addDirectory(inputPath_);
+        }
+
+        // Rotation renames a file and starts a new one under the old name;
+        // tell the two apart by identity, not by size alone.
+        std::vector<std::pair<std::string, FileIdentity>> listed;
+        for (const auto& file : files) {
+            listed.emplace_back(file.string(), fileIdentity(file));
+        }
+        for (const auto& message : state.reconcile(listed)) {
+            logger.log(message);
+        }
+
+        std::vector<Extent> extents;
+        for (const auto& file : files) {
+            watcher.addDirectory(file.parent_path());
+            std::error_code ec;
+            std::uintmax_t size = std::filesystem::file_size(file, ec);
+            if (ec) {
+                continue;
+            }
+            WatchState::FileProgress& progress = state.progress(file.string());
+            if (progress.whole) {
+                continue;
+            }
+            if (size < progress.offset) {
+                // Truncated in place (e.g. copytruncate): start over. Counts
+                // already published for the old contents are kept.
+                logger.log("File shrank, re-reading from start: " + file.string());
+                progress.offset = 0;
+            }
+            if (size > progress.offset) {
+                extents.push_back({ file, &progress, progress.offset, size, progress.offset, false });
+            }
+        }
+
+        std::vector<std::unordered_map<std::string, std::size_t>> local(workerCount_);
+        std::atomic<std::size_t> next{ 0 };
+        auto worker = [&](unsigned int workerId) {
+            std::vector<char> data;
+            std::size_t reserved = 0;
+            auto account = [&]() {
+                if (data.capacity() > reserved) {
+                    budget.forceReserve(data.capacity() - reserved);
+                    reserved = data.capacity();
+                }
+            };
+            for (std::size_t i = next++; i < extents.size(); i = next++) {
+                Extent& extent = extents[i];
+                std::uintmax_t pos = extent.from;
+                std::uintmax_t want = chunkBytes;
+                while (pos < extent.to) {
+                    const std::uintmax_t stop = std::min(extent.to, pos + want);
+                    if (!readRange(extent.path, pos, stop, data) || data.empty()) {
+                        break;
+                    }
+                    account();
+                    if (pos == 0 && detectCodec(data.data(), data.size()) != Codec::None) {
+                        // Compressed input is mapped once, as a whole, when first seen.
+                        if (stop < extent.to) {
+                            want = extent.to;
+                            continue;
+                        }
+                        if (!decompressInPlace(data)) {
+                            break;
+                        }
+                        account();
+                        mapper.forEachWord(std::string_view(data.data(), data.size()), [&](const std::string& word) {
+                            ++local[workerId][word];
+                        });
+                        extent.whole = true;
+                        extent.mappedTo = extent.to;
+                        break;
+                    }
+                    // A short read means the file shrank while being read.
+                    const bool last = stop == extent.to || data.size() < stop - pos;
+                    std::size_t usable = data.size();
+                    if (!(last && finalScan)) {
+                        // Only complete lines; a partial last line waits for its
+                        // newline, except on the final scan.
+                        while (usable > 0 && data[usable - 1] != '\n') {
+                            --usable;
+                        }
+                        if (usable == 0) {
+                            if (last) {
+                                break;
+                            }
+                            // A line longer than the chunk: read more of it at once.
+                            want *= 2;
+                            continue;
+                        }
+                    }
+                    mapper.forEachWord(std::string_view(data.data(), usable), [&](const std::string& word) {
+                        ++local[workerId][word];
+                    });
+                    pos += usable;
+                    extent.mappedTo = pos;
+                    want = chunkBytes;
+                }
+            }
+            budget.release(reserved);
+        };
+        std::vector<std::thread> threads;
+        for (unsigned int i = 0; i < workerCount_; ++i) {
+            threads.emplace_back(worker, i);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        std::uintmax_t mapped = 0;
+        for (const Extent& extent : extents) {
+            mapped += extent.mappedTo - extent.from;
+            extent.progress->offset = extent.mappedTo;
+            extent.progress->whole = extent.whole;
+        }
+        for (const auto& counts : local) {
+            state.add(counts);
+        }
+        return mapped;
+    };
+
+    auto publish = [&]() {
+        std::vector<std::pair<std::string, std::size_t>> totals = state.totals();
+        const bool written = writeResults(fileManager, topK_ > 0 ? Reducer::selectTopK(totals, topK_) : totals);
+        if (!watchOptions_.snapshotFile.empty() && !state.save(watchOptions_.snapshotFile)) {
+            logger.log("Failed to save watch snapshot: " + watchOptions_.snapshotFile);
+        }
+        if (!written) {
+            logger.log("Failed to publish results to " + outputFile_);
+            return false;
+        }
+        logger.log("Published " + std::to_string(totals.size()) + " words from " +
+                   std::to_string(state.files()) + " file(s) to " + outputFile_);
+        return true;
+    };
+
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::seconds(std::max(1u, watchOptions_.publishSeconds));
+    const auto started = Clock::now();
+    auto expired = [&]() {
+        return watchOptions_.durationSeconds > 0 &&
+               Clock::now() - started >= std::chrono::seconds(watchOptions_.durationSeconds);
+    };
+
+    logger.log(std::string("Watching ") + inputPath_ + " using " +
+               (watcher.usingNotifications() ? "inotify" : "polling") + "; publishing every " +
+               std::to_string(interval.count()) + " s.");
+
+    scan(false);
+    publish();
+    auto nextPublish = Clock::now() + interval;
+    bool dirty = false;
+
+    // Results are at most one interval stale: changes are mapped when they
+    // are noticed and every interval ends with a full rescan and publish.
+    while (!g_stopRequested && !expired()) {
+        auto now = Clock::now();
+        auto untilPublish = std::chrono::duration_cast<std::chrono::milliseconds>(nextPublish - now);
+        // Wake at least twice a second to notice stop requests.
+        auto timeout = std::max(std::chrono::milliseconds(0),
+                                std::min(untilPublish, std::chrono::milliseconds(500)));
+        if (watcher.wait(timeout) && scan(false) > 0) {
+            dirty = true;
+        }
+        if (Clock::now() >= nextPublish) {
+            if (scan(false) > 0) {
+                dirty = true;
+            }
+            if (dirty) {
+                // A failed publish is retried at the next interval.
+                dirty = !publish();
+            }
+            nextPublish = Clock::now() + interval;
+        }
+    }
+
+    scan(true);
+    const bool published = publish();
+    logger.log("Watch mode stopped.");
+    return published;
+}
+
+bool MapReduceController::runIncremental(Logger& logger,
+                                         FileManager& fileManager,
+                                         const std::vector<std::filesystem::path>& files) {
+    IncrementalCache cache(incrementalCache_);
+    if (cache.load()) {
+        logger.log("Loaded incremental cache with " + std::to_string(cache.size()) +
+                   " file(s): " + incrementalCache_);
+    } else {
+        logger.log("No incremental cache found; mapping all files.");
+    }
+
+    // Decide which files need to be re-mapped. Size and modification time
+    // are checked first; the content hash is only computed when they differ,
+    // so touched-but-identical files are not re-mapped.
+    std::set<std::string> present;
+    std::vector<std::filesystem::path> changed;
+
+    for (const auto& filePath : files) {
+        std::string key = std::filesystem::absolute(filePath).lexically_normal().string();
+        present.insert(key);
+
+        std::error_code ec;
+        std::uintmax_t size = std::filesystem::file_size(filePath, ec);
+        long long modifiedTime = IncrementalCache::modifiedTimeOf(filePath);
+
+        const CachedFileEntry* entry = cache.find(key);
+        if (entry != nullptr && !ec && entry->size == size) {
+            if (entry->modifiedTime == modifiedTime) {
+                continue;
+            }
+            if (entry->contentHash == IncrementalCache::hashFileContents(filePath)) {
+                cache.refreshFingerprint(key, size, modifiedTime);
+                continue;
+            }
+        }
+        changed.push_back(filePath);
+    }
+
+    std::vector<std::string> removed = cache.removeMissing(present);
+    for (const auto& path : removed) {
+        logger.log("Removed from cache: " + path);
+    }
+
+    logger.log("Incremental run: " + std::to_string(changed.size()) + " changed, " +
+               std::to_string(removed.size()) + " removed, " +
+               std::to_string(files.size() - changed.size()) + " reused.");
+
+    Mapper mapper;
+    Reducer reducer;
+    std::mutex cacheMutex;
+
+    std::size_t index = 0;
+    std::mutex indexMutex;
+
+    std::vector<std::size_t> taskPeaks(workerCount_, 0);
+
+    auto worker = [&](unsigned int workerId) {
+        TaskArena arena;
+        std::vector<char> data;
+
+        while (true) {
+            std::filesystem::path filePath;
+            {
+                std::lock_guard<std::mutex> lock(indexMutex);
+                if (index >= changed.size()) {
+                    break;
+                }
+                filePath = changed[index];
+                ++index;
+            }
+
+            logger.log("Worker processing file: " + filePath.string());
+
+            // Recycle the previous task's working memory in one step.
+            arena.reset();
+
+            // Fingerprint before reading so a write racing with the map is
+            // picked up again by the next run.
+            CachedFileEntry entry;
+            std::error_code ec;
+            entry.size = std::filesystem::file_size(filePath, ec);
+            entry.modifiedTime = IncrementalCache::modifiedTimeOf(filePath);
+
+            // One read serves both the content hash (of the stored bytes, as
+            // hashFileContents computes it) and the map.
+            if (!ReadAheadPipeline::readFile(filePath, data)) {
+                logger.log("Failed to open file for reading: " + filePath.string());
+                continue;
+            }
+            entry.contentHash = IncrementalCache::hashBytes(data.data(), data.size());
+            if (!decompressInPlace(data)) {
+                logger.log("Failed to decompress: " + filePath.string());
+                continue;
+            }
+
+            std::pmr::vector<std::pair<std::pmr::string, int>> localPairs(arena.resource());
+            std::string_view text(data.data(), data.size());
+            for (std::size_t start = 0; start < text.size();) {
+                std::size_t stop = std::min(text.find('\n', start), text.size());
+                auto mapped = mapper.mapLine(text.substr(start, stop - start), arena.resource());
+                localPairs.insert(localPairs.end(), mapped.begin(), mapped.end());
+                start = stop + 1;
+            }
+
+            entry.counts = reducer.reduce(localPairs);
+
+            {
+                std::string key = std::filesystem::absolute(filePath).lexically_normal().string();
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                cache.put(key, std::move(entry));
+            }
+
+            logger.log("Finished file: " + filePath.string());
+        }
+
+        taskPeaks[workerId] = arena.highWaterMark();
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < workerCount_; ++i) {
+        workers.emplace_back(worker, i);
+    }
+
+    for (auto& t : workers) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+
+    if (!cache.save()) {
+        logger.log("Warning: failed to save incremental cache: " + incrementalCache_);
+    }
+
+    logMemorySummary(logger, "task arena", taskPeaks, {});
+    logger.log("Mapping complete. Deriving results from cached partials...");
+
+    bool written = false;
+    if (topK_ > 0) {
+        logger.log("Selecting top " + std::to_string(topK_) + " words.");
+        written = writeResults(fileManager, Reducer::selectTopK(cache.totals(), topK_));
+    } else {
+        written = writeResults(fileManager, cache.totals());
+    }
+    if (!written) {
+        return false;
+    }
 
     logger.log("MapReduce workflow complete. Output written to: " + outputFile_);
 
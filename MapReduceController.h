@@ -2,23 +2,240 @@
 #define MAPREDUCECONTROLLER_H
 
 #include <string>
+#include <vector>
+#include <filesystem>
+#include <utility>
+#include <memory>
+
+#include "P3_Sketches.h"
+#include "P3_FileDiscovery.h"
+#include "P3_Compression.h"
+#include "P3_Watch.h"
+#include "P3_Windowing.h"
+#include "P3_FusedJobs.h"
+#include "P3_JobDag.h"
+#include "P3_Grep.h"
+#include "P3_Cooccurrence.h"
+#include "P3_WorkerTuning.h"
 
 class Logger;
+class FileManager;
+
+// Output file layout written by MapReduceController.
+enum class OutputFormat {
+    Csv,          // "word,count" lines
+    IndexedStore  // memory-mappable ResultStore (see P3_ResultStore.h)
+};
 
 class MapReduceController {
 public:
+    // `workerCount` 0 sizes the map pool for this machine and input when
+    // run() starts (see P3_WorkerTuning.h).
     MapReduceController(const std::string& inputPath,
                         const std::string& outputFile,
-                        unsigned int workerCount = 3);
+                        unsigned int workerCount = 0);
 
     // Run the full workflow: discover files, map in parallel, reduce, write CSV.
     // Returns true on success.
     bool run(Logger& logger);
 
+    // Enable incremental mode: per-file partial counts are persisted in
+    // `cacheFile`, and later runs only re-map new or changed files.
+    void setIncrementalCache(const std::string& cacheFile);
+
+    // Only keep the k most frequent words (0 = full vocabulary). The output
+    // is then ordered by count, highest first, and has at most k rows.
+    void setTopK(std::size_t k);
+
+    // Choose the output layout. Bloom filters only apply to IndexedStore.
+    void setOutputFormat(OutputFormat format, bool withBloomFilter = false);
+
+    // Approximate mode: each worker keeps fixed-size sketches instead of exact
+    // counts, and the output is a report of estimated top words and distinct
+    // vocabulary size with error bounds. If `sketchFile` is not empty the
+    // merged sketch is also saved there so results from several nodes can be
+    // combined later.
+    void setApproximate(const ApproximateOptions& options, const std::string& sketchFile = "");
+
+    // Count n-grams (n consecutive words within a file) instead of single
+    // words. n <= 1 keeps the default word count. Rows are written as
+    // "w1 w2 ... wn,count".
+    void setNGramSize(unsigned int n);
+
+    // Build an inverted index (term -> documents and line numbers) instead of
+    // word counts. The output file is an InvertedIndex (see P3_InvertedIndex.h).
+    void setInvertedIndex(bool enabled);
+
+    // Compute a sparse TF-IDF vector per document instead of word counts.
+    // The output file is a TF-IDF vector file (see P3_TfIdf.h).
+    void setTfIdf(bool enabled);
+
+    // Count word co-occurrences instead of words. The output file is a CSR
+    // co-occurrence matrix with its term dictionary (see P3_Cooccurrence.h).
+    void setCooccurrence(const CooccurrenceOptions& options);
+
+    // Word count: words holding at least `fraction` of all counted words in
+    // the map-side tables (e.g. 0.01) are salted over all reduce partitions
+    // and merged in a final step. 0 (the default) disables salting. The
+    // per-partition load is logged either way.
+    void setHotKeys(double fraction);
+
+    // Cap the memory held by buffers and aggregation tables (0 = unlimited).
+    // When a worker's partial counts no longer fit, they are sorted and
+    // spilled to `spillDir` (default: "spill" next to the output file) and
+    // merged back at reduce time. Buffer sizes are derived from the budget.
+    void setMemoryLimit(std::size_t bytes, const std::string& spillDir = "");
+
+    // Which files under the input path are read: recursion and include /
+    // exclude globs. Default is top-level *.txt files.
+    void setDiscovery(const DiscoveryOptions& options);
+
+    // Read stage of the word-count job: `readers` threads read files ahead
+    // of the mappers, keeping up to `buffersPerWorker` filled buffers per
+    // worker queued. More buffers hide more I/O latency at the cost of memory.
+    // `readers` 0 sizes the read pool from a probe of the input.
+    void setReadAhead(unsigned int readers, std::size_t buffersPerWorker);
+
+    // Compress the CSV output and/or spilled runs. Compressed input needs no
+    // setting: it is detected by magic bytes. Indexed stores are never
+    // compressed since they are memory-mapped.
+    void setCompression(Codec output, Codec spills);
+
+    // Word-count job: every `intervalSeconds` replace the output file with
+    // the counts so far (0 = only the final result). Mostly useful for
+    // streaming input ("-" or a FIFO), where the final result only comes
+    // at end of stream.
+    void setPartialResults(unsigned int intervalSeconds);
+
+    // Watch mode: keep running, map only bytes appended to existing files
+    // and new files into a live aggregate, and republish the output
+    // (atomically) at most `publishSeconds` after a change. The live state
+    // is snapshotted so a restart resumes where it stopped.
+    void setWatch(const WatchOptions& options);
+
+    // Windowed mode: count words per event-time window instead of over the
+    // whole input. Each line's timestamp is taken by `options.timestamp`
+    // (lines without one inherit the previous line's). The output holds the
+    // current window (top-K if set) and is republished whenever the window
+    // advances or every `publishSeconds` while input keeps arriving, so a
+    // live log stream can be queried as "top words in the last N minutes".
+    void setWindow(const WindowOptions& options);
+
+    // Fused mode: run every added job over one scan of the input. Each file
+    // is read and tokenized once and its token IDs are fanned out to all
+    // jobs, each writing its own output (the controller's output file is
+    // not used). Replaces the single-job modes above.
+    void addJob(std::unique_ptr<FusedJob> job);
+
+    // DAG mode: run a chain of stages (see P3_JobDag.h) whose intermediate
+    // results stay in memory. Write stages name their own outputs; workers,
+    // memory limit, spill directory and codecs come from this controller.
+    void setDag(const JobDag& dag);
+
+    // Grep mode: write every input line matching `options.pattern` as
+    // "path:offset:line" (offset = byte offset of the line in the file, after
+    // decompression). Files are searched in parallel; ordered output is
+    // sorted by path and offset, unordered output is appended as each file
+    // finishes.
+    void setGrep(const GrepOptions& options);
+
+    // Files a successful run() writes: the output file, or the outputs of
+    // the fused jobs or of the DAG's write stages.
+    std::vector<std::string> outputFiles() const;
+
+    // Ask a running watch loop to publish one last time and return. Safe to
+    // call from a signal handler.
+    static void requestStop();
+
 private:
+    bool runWatch(Logger& logger, FileManager& fileManager);
+
+    bool runWindowed(Logger& logger, FileManager& fileManager);
+
+    bool runFused(Logger& logger, FileManager& fileManager);
+
+    bool runGrep(Logger& logger, FileManager& fileManager);
+
+    // Default job: exact word count over files streamed from discovery.
+    bool runWordCount(Logger& logger, FileManager& fileManager);
+
+    bool runIncremental(Logger& logger,
+                        FileManager& fileManager,
+                        const std::vector<std::filesystem::path>& files);
+
+    bool runApproximate(Logger& logger,
+                        FileManager& fileManager,
+                        const std::vector<std::filesystem::path>& files);
+
+    bool runNGram(Logger& logger,
+                  FileManager& fileManager,
+                  const std::vector<std::filesystem::path>& files);
+
+    bool runInvertedIndex(Logger& logger,
+                          FileManager& fileManager,
+                          const std::vector<std::filesystem::path>& files);
+
+    // Resolve a worker or reader count of 0 (auto) from the CPU profile,
+    // the input size and a short read / tokenize probe. run() calls it for
+    // an auto worker count; modes with a read stage call it again if the
+    // reader count is still auto (the worker count is then kept).
+    // The input is listed (and profiled) at most once; later calls and the
+    // modes below reuse that listing instead of walking the input again.
+    void tuneWorkers(Logger& logger, FileManager& fileManager);
+
+    // Start feeding `queue`: from the listing taken by tuneWorkers() if
+    // there is one, else by walking the input with `discovery`.
+    void startDiscovery(FileDiscovery& discovery, FileQueue& queue);
+
+    bool runTfIdf(Logger& logger,
+                  FileManager& fileManager,
+                  const std::vector<std::filesystem::path>& files);
+
+    bool runCooccurrence(Logger& logger,
+                         FileManager& fileManager,
+                         const std::vector<std::filesystem::path>& files);
+
+    // Returns false if the output could not be written.
+    bool writeResults(FileManager& fileManager,
+                      const std::vector<std::pair<std::string, std::size_t>>& wordCounts) const;
+
     std::string inputPath_;
     std::string outputFile_;
     unsigned int workerCount_;
+    std::string incrementalCache_;
+    std::size_t topK_ = 0;
+    OutputFormat outputFormat_ = OutputFormat::Csv;
+    bool withBloomFilter_ = false;
+    bool approximate_ = false;
+    ApproximateOptions approximateOptions_;
+    std::string sketchFile_;
+    unsigned int ngramSize_ = 1;
+    bool invertedIndex_ = false;
+    bool tfIdf_ = false;
+    double hotKeyFraction_ = 0;
+    bool cooccurrence_ = false;
+    CooccurrenceOptions cooccurrenceOptions_;
+    std::size_t memoryLimit_ = 0;
+    std::string spillDir_;
+    DiscoveryOptions discovery_;
+    unsigned int readers_ = 0;
+    std::size_t readAhead_ = 2;
+    Codec outputCodec_ = Codec::None;
+    Codec spillCodec_ = Codec::None;
+    unsigned int partialInterval_ = 0;
+    bool watch_ = false;
+    WatchOptions watchOptions_;
+    bool windowed_ = false;
+    WindowOptions windowOptions_;
+    std::vector<std::unique_ptr<FusedJob>> jobs_;
+    bool grep_ = false;
+    GrepOptions grepOptions_;
+    bool dagMode_ = false;
+    JobDag dag_;
+    bool inputListed_ = false;
+    std::vector<std::filesystem::path> inputFiles_;
+    InputProfile inputProfile_;
+    ThroughputProbe throughputProbe_;
 };
 
 #endif // MAPREDUCECONTROLLER_H
@@ -0,0 +1,41 @@
+#include "mr/MemoryBudget.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+
+namespace mr {
+
+namespace {
+std::atomic<std::size_t> g_memoryLimit{0};
+}
+
+void setMemoryLimit(std::size_t bytes) { g_memoryLimit = bytes; }
+
+std::size_t memoryLimit() { return g_memoryLimit; }
+
+std::size_t flushThresholdFor(std::size_t bytesPerRecord) {
+    const std::size_t limit = g_memoryLimit;
+    if (limit == 0) return 2048;
+    const std::size_t records = limit / 4 / std::max<std::size_t>(1, bytesPerRecord);
+    return std::clamp<std::size_t>(records, 256, std::size_t(1) << 20);
+}
+
+bool parseMemorySize(const std::string& text, std::size_t& bytes) {
+    std::size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) ++digits;
+    if (digits == 0 || digits > 15 || text.size() > digits + 1) return false;
+
+    std::size_t value = std::stoull(text.substr(0, digits));
+    if (digits < text.size()) {
+        switch (std::toupper(static_cast<unsigned char>(text[digits]))) {
+        case 'K': value <<= 10; break;
+        case 'M': value <<= 20; break;
+        case 'G': value <<= 30; break;
+        default: return false;
+        }
+    }
+    bytes = value;
+    return true;
+}
+
+} // namespace mr
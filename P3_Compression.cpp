@@ -0,0 +1,380 @@
+#include "P3_Compression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#ifdef MR_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// Input ranges decoded independently and concatenated in order.
+struct Segment {
+    std::size_t offset;
+    std::size_t size;
+};
+
+template <typename Decode>
+bool decodeSegments(const std::vector<char>& input, const std::vector<Segment>& segments,
+                    std::vector<char>& output, unsigned int threads, Decode decode) {
+    std::vector<std::vector<char>> parts(segments.size());
+    std::vector<char> ok(segments.size(), 0);
+
+    threads = std::max(1u, std::min<unsigned int>(threads, static_cast<unsigned int>(segments.size())));
+    auto work = [&](unsigned int t) {
+        for (std::size_t i = t; i < segments.size(); i += threads) {
+            ok[i] = decode(input.data() + segments[i].offset, segments[i].size, parts[i]) ? 1 : 0;
+        }
+    };
+    if (threads == 1) {
+        work(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (unsigned int t = 0; t < threads; ++t) {
+            pool.emplace_back(work, t);
+        }
+        for (auto& th : pool) {
+            th.join();
+        }
+    }
+
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        if (!ok[i]) {
+            return false;
+        }
+        total += parts[i].size();
+    }
+    output.clear();
+    output.reserve(total);
+    for (auto& part : parts) {
+        output.insert(output.end(), part.begin(), part.end());
+        std::vector<char>().swap(part);
+    }
+    return true;
+}
+
+#ifdef MR_HAVE_ZLIB
+
+// Inflate gzip members starting at `data` until the input is used up.
+bool inflateMembers(const char* data, std::size_t size, std::vector<char>& output) {
+    z_stream stream{};
+    // 15 window bits + 16: gzip wrapper only.
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        return false;
+    }
+    output.clear();
+    output.resize(std::max<std::size_t>(size * 3, 64 * 1024));
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    std::size_t consumed = 0;
+    std::size_t produced = 0;
+    bool ok = true;
+    bool ended = false;
+    while (consumed < size) {
+        std::size_t inChunk = std::min<std::size_t>(size - consumed, 1u << 30);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + consumed));
+        stream.avail_in = static_cast<uInt>(inChunk);
+        if (produced == output.size()) {
+            output.resize(output.size() * 2);
+        }
+        std::size_t outChunk = std::min<std::size_t>(output.size() - produced, 1u << 30);
+        stream.next_out = reinterpret_cast<Bytef*>(output.data() + produced);
+        stream.avail_out = static_cast<uInt>(outChunk);
+
+        int rc = inflate(&stream, Z_NO_FLUSH);
+        consumed += inChunk - stream.avail_in;
+        produced += outChunk - stream.avail_out;
+
+        ended = (rc == Z_STREAM_END);
+        if (ended) {
+            // Another member may follow (e.g. files written by `cat a.gz b.gz`).
+            if (consumed < size && inflateReset(&stream) != Z_OK) {
+                ok = false;
+                break;
+            }
+        } else if (rc == Z_BUF_ERROR) {
+            if (stream.avail_out != 0) {
+                ok = false;  // truncated input
+                break;
+            }
+        } else if (rc != Z_OK) {
+            ok = false;
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    output.resize(produced);
+    return ok && ended;
+}
+
+// Splits a BGZF file (gzip members carrying their size in a "BC" extra
+// field) into members that can be inflated independently. Returns false for
+// ordinary gzip, whose member boundaries are only known after decoding.
+bool splitBgzf(const std::vector<char>& input, std::vector<Segment>& segments) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(input.data());
+    std::size_t pos = 0;
+    while (pos < input.size()) {
+        if (input.size() - pos < 18 || p[pos] != 0x1f || p[pos + 1] != 0x8b || !(p[pos + 3] & 4)) {
+            return false;
+        }
+        std::size_t xlen = p[pos + 10] | (p[pos + 11] << 8);
+        std::size_t field = pos + 12;
+        std::size_t fieldsEnd = field + xlen;
+        std::size_t blockSize = 0;
+        while (field + 4 <= fieldsEnd && fieldsEnd <= input.size()) {
+            std::size_t len = p[field + 2] | (p[field + 3] << 8);
+            if (p[field] == 'B' && p[field + 1] == 'C' && len == 2 && field + 6 <= fieldsEnd) {
+                blockSize = (p[field + 4] | (p[field + 5] << 8)) + 1u;
+            }
+            field += 4 + len;
+        }
+        if (blockSize == 0 || pos + blockSize > input.size()) {
+            return false;
+        }
+        segments.push_back({ pos, blockSize });
+        pos += blockSize;
+    }
+    return segments.size() > 1;
+}
+
+bool deflateMember(const char* data, std::size_t size, std::vector<char>& output, int level) {
+    z_stream stream{};
+    if (deflateInit2(&stream, level == 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED,
+                     15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    std::size_t start = output.size();
+    std::size_t consumed = 0;
+    int rc = Z_OK;
+    do {
+        std::size_t inChunk = std::min<std::size_t>(size - consumed, 1u << 30);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + consumed));
+        stream.avail_in = static_cast<uInt>(inChunk);
+        bool last = consumed + inChunk == size;
+        do {
+            std::size_t produced = output.size();
+            output.resize(produced + 256 * 1024);
+            stream.next_out = reinterpret_cast<Bytef*>(output.data() + produced);
+            stream.avail_out = 256 * 1024;
+            rc = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+            output.resize(output.size() - stream.avail_out);
+        } while (stream.avail_out == 0);
+        consumed += inChunk;
+    } while (consumed < size);
+    deflateEnd(&stream);
+    if (rc != Z_STREAM_END) {
+        output.resize(start);
+        return false;
+    }
+    return true;
+}
+
+#endif // MR_HAVE_ZLIB
+
+#ifdef MR_HAVE_ZSTD
+
+bool decodeZstdFrame(const char* data, std::size_t size, std::vector<char>& output) {
+    output.clear();
+    unsigned long long known = ZSTD_getFrameContentSize(data, size);
+    if (known != ZSTD_CONTENTSIZE_ERROR && known != ZSTD_CONTENTSIZE_UNKNOWN) {
+        output.resize(static_cast<std::size_t>(known));
+        std::size_t rc = ZSTD_decompress(output.data(), output.size(), data, size);
+        return !ZSTD_isError(rc) && rc == output.size();
+    }
+
+    // Size not recorded in the frame header: stream it.
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    if (stream == nullptr) {
+        return false;
+    }
+    ZSTD_initDStream(stream);
+    ZSTD_inBuffer in{ data, size, 0 };
+    std::vector<char> chunk(ZSTD_DStreamOutSize());
+    bool ok = true;
+    // 0 means the frame is complete and fully flushed.
+    std::size_t rc = 1;
+    while (rc != 0) {
+        ZSTD_outBuffer out{ chunk.data(), chunk.size(), 0 };
+        rc = ZSTD_decompressStream(stream, &out, &in);
+        if (ZSTD_isError(rc) || (out.pos == 0 && in.pos == in.size && rc != 0)) {
+            ok = false;  // corrupt or truncated
+            break;
+        }
+        output.insert(output.end(), chunk.data(), chunk.data() + out.pos);
+    }
+    ZSTD_freeDStream(stream);
+    return ok;
+}
+
+#endif // MR_HAVE_ZSTD
+
+} // namespace
+
+Codec detectCodec(const char* data, std::size_t size) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 2 && p[0] == 0x1f && p[1] == 0x8b) {
+        return Codec::Gzip;
+    }
+    if (size >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) {
+        return Codec::Zstd;
+    }
+    return Codec::None;
+}
+
+bool codecAvailable(Codec codec) {
+    switch (codec) {
+    case Codec::None:
+        return true;
+    case Codec::Gzip:
+#ifdef MR_HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case Codec::Zstd:
+#ifdef MR_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char* codecName(Codec codec) {
+    switch (codec) {
+    case Codec::Gzip:
+        return "gzip";
+    case Codec::Zstd:
+        return "zstd";
+    default:
+        return "none";
+    }
+}
+
+bool parseCodec(const std::string& name, Codec& codec) {
+    if (name == "none") {
+        codec = Codec::None;
+    } else if (name == "gzip" || name == "gz") {
+        codec = Codec::Gzip;
+    } else if (name == "zstd" || name == "zst") {
+        codec = Codec::Zstd;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* codecExtension(Codec codec) {
+    switch (codec) {
+    case Codec::Gzip:
+        return ".gz";
+    case Codec::Zstd:
+        return ".zst";
+    default:
+        return "";
+    }
+}
+
+bool decompressBuffer(Codec codec, const std::vector<char>& input,
+                      std::vector<char>& output, [[maybe_unused]] unsigned int threads) {
+    if (!codecAvailable(codec)) {
+        std::cerr << "Input is " << codecName(codec)
+                  << "-compressed but this build has no " << codecName(codec) << " support\n";
+        return false;
+    }
+
+    bool ok = false;
+    switch (codec) {
+    case Codec::None:
+        output = input;
+        return true;
+    case Codec::Gzip: {
+#ifdef MR_HAVE_ZLIB
+        std::vector<Segment> blocks;
+        if (threads > 1 && splitBgzf(input, blocks)) {
+            ok = decodeSegments(input, blocks, output, threads, inflateMembers);
+        } else {
+            ok = inflateMembers(input.data(), input.size(), output);
+        }
+#endif
+        break;
+    }
+    case Codec::Zstd: {
+#ifdef MR_HAVE_ZSTD
+        // Frames are self-delimiting, so they can be decoded in parallel.
+        std::vector<Segment> frames;
+        std::size_t pos = 0;
+        while (pos < input.size()) {
+            std::size_t frameSize = ZSTD_findFrameCompressedSize(input.data() + pos, input.size() - pos);
+            if (ZSTD_isError(frameSize)) {
+                break;
+            }
+            frames.push_back({ pos, frameSize });
+            pos += frameSize;
+        }
+        ok = pos == input.size() && decodeSegments(input, frames, output, threads, decodeZstdFrame);
+#endif
+        break;
+    }
+    }
+
+    if (!ok) {
+        std::cerr << "Corrupt or truncated " << codecName(codec) << " data\n";
+    }
+    return ok;
+}
+
+bool compressBuffer(Codec codec, const char* data, std::size_t size,
+                    std::vector<char>& output, [[maybe_unused]] int level) {
+    switch (codec) {
+    case Codec::None:
+        output.insert(output.end(), data, data + size);
+        return true;
+    case Codec::Gzip:
+#ifdef MR_HAVE_ZLIB
+        return deflateMember(data, size, output, level);
+#else
+        break;
+#endif
+    case Codec::Zstd: {
+#ifdef MR_HAVE_ZSTD
+        std::size_t start = output.size();
+        output.resize(start + ZSTD_compressBound(size));
+        std::size_t rc = ZSTD_compress(output.data() + start, output.size() - start, data, size,
+                                       level == 0 ? 3 : level);
+        if (ZSTD_isError(rc)) {
+            output.resize(start);
+            return false;
+        }
+        output.resize(start + rc);
+        return true;
+#else
+        break;
+#endif
+    }
+    }
+    std::cerr << "This build has no " << codecName(codec) << " support\n";
+    return false;
+}
+
+bool decompressInPlace(std::vector<char>& data, unsigned int threads) {
+    Codec codec = detectCodec(data.data(), data.size());
+    if (codec == Codec::None) {
+        return true;
+    }
+    std::vector<char> plain;
+    if (!decompressBuffer(codec, data, plain, threads)) {
+        return false;
+    }
+    data.swap(plain);
+    return true;
+}
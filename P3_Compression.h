@@ -0,0 +1,44 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Stream codecs for job input, output and spill files. Support for each
+// codec is compiled in when CMake finds the library (MR_HAVE_ZLIB,
+// MR_HAVE_ZSTD); codecAvailable() reports what this build can handle.
+enum class Codec {
+    None,
+    Gzip,
+    Zstd
+};
+
+// Codec of a buffer, from its magic bytes (None if not compressed).
+Codec detectCodec(const char* data, std::size_t size);
+
+bool codecAvailable(Codec codec);
+const char* codecName(Codec codec);
+
+// "none", "gzip"/"gz", "zstd"/"zst". Returns false for unknown names.
+bool parseCodec(const std::string& name, Codec& codec);
+
+// Usual file extension including the dot ("" for None).
+const char* codecExtension(Codec codec);
+
+// Decompress a whole buffer. Concatenated gzip members and zstd frames are
+// all decoded; independent zstd frames and BGZF blocks are decoded on up to
+// `threads` threads. Returns false (with a message on stderr) on corrupt
+// input or when the codec is not compiled in.
+bool decompressBuffer(Codec codec, const std::vector<char>& input,
+                      std::vector<char>& output, unsigned int threads = 1);
+
+// Compress a buffer as one gzip member or zstd frame, appending to `output`.
+bool compressBuffer(Codec codec, const char* data, std::size_t size,
+                    std::vector<char>& output, int level = 0);
+
+// Replace `data` with its decompressed contents if it starts with a known
+// magic. Returns false if it is compressed but cannot be decoded.
+bool decompressInPlace(std::vector<char>& data, unsigned int threads = 1);
+
+#endif // COMPRESSION_H
@@ -0,0 +1,268 @@
+#include "P3_Cooccurrence.h"
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char kCooccurrenceMagic[8] = { 'M', 'R', 'C', 'O', 'O', 'C', 'R', '1' };
+
+struct CooccurrenceHeader {
+    char magic[8];
+    std::uint64_t termCount;
+    std::uint64_t nonZeros;
+    std::uint64_t window;
+    std::uint64_t dictionaryOffset;
+    std::uint64_t namesOffset;
+    std::uint64_t namesSize;
+    std::uint64_t rowOffsetsOffset;
+    std::uint64_t columnsOffset;
+    std::uint64_t valuesOffset;
+};
+static_assert(sizeof(CooccurrenceHeader) == 80, "CooccurrenceHeader must not contain padding");
+
+const std::size_t kTermEntrySize = 16;
+
+template <typename T>
+T readAt(const unsigned char* base, std::size_t offset) {
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void append(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+std::size_t slotOf(std::uint32_t id, std::size_t mask) {
+    return static_cast<std::size_t>((id * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+
+void Stripe::add(std::uint32_t id, std::uint64_t count) {
+    if ((size_ + 1) * 4 > ids_.size() * 3) {
+        rehash(ids_.empty() ? 4 : ids_.size() * 2);
+    }
+    std::size_t mask = ids_.size() - 1;
+    std::size_t slot = slotOf(id, mask);
+    while (ids_[slot] != kEmpty && ids_[slot] != id) {
+        slot = (slot + 1) & mask;
+    }
+    if (ids_[slot] == kEmpty) {
+        ids_[slot] = id;
+        ++size_;
+    }
+    counts_[slot] += count;
+}
+
+void Stripe::merge(const Stripe& other) {
+    if (ids_.empty() && size_ == 0) {
+        *this = other;
+        return;
+    }
+    other.forEach([&](std::uint32_t id, std::uint64_t count) { add(id, count); });
+}
+
+void Stripe::rehash(std::size_t slotCount) {
+    std::vector<std::uint32_t> ids(slotCount, kEmpty);
+    std::vector<std::uint64_t> counts(slotCount, 0);
+    std::size_t mask = slotCount - 1;
+    for (std::size_t old = 0; old < ids_.size(); ++old) {
+        if (ids_[old] == kEmpty) {
+            continue;
+        }
+        std::size_t slot = slotOf(ids_[old], mask);
+        while (ids[slot] != kEmpty) {
+            slot = (slot + 1) & mask;
+        }
+        ids[slot] = ids_[old];
+        counts[slot] = counts_[old];
+    }
+    ids_.swap(ids);
+    counts_.swap(counts);
+}
+
+std::size_t Stripe::size() const {
+    return size_;
+}
+
+std::size_t Stripe::memoryBytes() const {
+    return ids_.capacity() * sizeof(std::uint32_t) + counts_.capacity() * sizeof(std::uint64_t);
+}
+
+// ---------------------------------------------------------------------------
+
+bool CooccurrenceWriter::write(const std::string& path,
+                               const CooccurrenceOptions& options,
+                               const std::vector<std::string>& terms,
+                               const std::vector<std::uint64_t>& rowOffsets,
+                               const std::vector<std::uint32_t>& columns,
+                               const std::vector<std::uint64_t>& values) {
+    std::string dictionary;
+    std::string names;
+    for (const auto& term : terms) {
+        append<std::uint64_t>(dictionary, names.size());
+        append<std::uint32_t>(dictionary, static_cast<std::uint32_t>(term.size()));
+        append<std::uint32_t>(dictionary, 0);
+        names += term;
+    }
+    // Keep the numeric arrays 8-byte aligned for readers that map them.
+    names.resize((names.size() + 7) / 8 * 8, '\0');
+
+    CooccurrenceHeader header{};
+    std::memcpy(header.magic, kCooccurrenceMagic, sizeof(kCooccurrenceMagic));
+    header.termCount = terms.size();
+    header.nonZeros = columns.size();
+    header.window = options.window;
+    header.dictionaryOffset = sizeof(CooccurrenceHeader);
+    header.namesOffset = header.dictionaryOffset + dictionary.size();
+    header.namesSize = names.size();
+    header.rowOffsetsOffset = header.namesOffset + names.size();
+    header.columnsOffset = header.rowOffsetsOffset + rowOffsets.size() * sizeof(std::uint64_t);
+    header.valuesOffset = header.columnsOffset + (columns.size() * sizeof(std::uint32_t) + 7) / 8 * 8;
+
+    const char padding[8] = {};
+    const std::size_t columnPadding = static_cast<std::size_t>(
+        header.valuesOffset - header.columnsOffset - columns.size() * sizeof(std::uint32_t));
+
+    AtomicOutputFile out;
+    if (!out.open(path)) {
+        return false;
+    }
+    bool ok = out.append(reinterpret_cast<const char*>(&header), sizeof(header)) &&
+              out.append(dictionary.data(), dictionary.size()) &&
+              out.append(names.data(), names.size()) &&
+              out.append(reinterpret_cast<const char*>(rowOffsets.data()), rowOffsets.size() * sizeof(std::uint64_t)) &&
+              out.append(reinterpret_cast<const char*>(columns.data()), columns.size() * sizeof(std::uint32_t)) &&
+              out.append(padding, columnPadding) &&
+              out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(std::uint64_t));
+    if (!ok) {
+        std::cerr << "Failed to write co-occurrence matrix: " << path << "\n";
+        return false;
+    }
+    return out.commit();
+}
+
+// ---------------------------------------------------------------------------
+
+bool CooccurrenceMatrix::open(const std::string& path) {
+    if (!file_.open(path) || file_.size() < sizeof(CooccurrenceHeader)) {
+        return false;
+    }
+
+    CooccurrenceHeader header = readAt<CooccurrenceHeader>(file_.data(), 0);
+    if (std::memcmp(header.magic, kCooccurrenceMagic, sizeof(kCooccurrenceMagic)) != 0 ||
+        header.dictionaryOffset + header.termCount * kTermEntrySize > file_.size() ||
+        header.namesOffset + header.namesSize > file_.size() ||
+        header.rowOffsetsOffset + (header.termCount + 1) * sizeof(std::uint64_t) > file_.size() ||
+        header.columnsOffset + header.nonZeros * sizeof(std::uint32_t) > file_.size() ||
+        header.valuesOffset + header.nonZeros * sizeof(std::uint64_t) > file_.size()) {
+        file_.close();
+        return false;
+    }
+
+    termCount_ = static_cast<std::size_t>(header.termCount);
+    nonZeros_ = header.nonZeros;
+    window_ = static_cast<unsigned int>(header.window);
+    dictionary_ = file_.data() + header.dictionaryOffset;
+    names_ = file_.data() + header.namesOffset;
+    namesSize_ = static_cast<std::size_t>(header.namesSize);
+    rowOffsets_ = file_.data() + header.rowOffsetsOffset;
+    columns_ = file_.data() + header.columnsOffset;
+    values_ = file_.data() + header.valuesOffset;
+    return true;
+}
+
+std::size_t CooccurrenceMatrix::termCount() const {
+    return termCount_;
+}
+
+std::uint64_t CooccurrenceMatrix::nonZeros() const {
+    return nonZeros_;
+}
+
+unsigned int CooccurrenceMatrix::window() const {
+    return window_;
+}
+
+std::string_view CooccurrenceMatrix::nameAt(std::uint64_t offset, std::uint32_t length) const {
+    if (offset + length > namesSize_) {
+        return {};
+    }
+    return std::string_view(reinterpret_cast<const char*>(names_ + offset), length);
+}
+
+std::string_view CooccurrenceMatrix::term(std::uint32_t termId) const {
+    if (termId >= termCount_) {
+        return {};
+    }
+    std::size_t base = termId * kTermEntrySize;
+    return nameAt(readAt<std::uint64_t>(dictionary_, base),
+                  readAt<std::uint32_t>(dictionary_, base + 8));
+}
+
+bool CooccurrenceMatrix::find(std::string_view name, std::uint32_t& termId) const {
+    std::size_t low = 0;
+    std::size_t high = termCount_;
+    while (low < high) {
+        std::size_t mid = low + (high - low) / 2;
+        std::string_view candidate = term(static_cast<std::uint32_t>(mid));
+        if (candidate < name) {
+            low = mid + 1;
+        } else if (name < candidate) {
+            high = mid;
+        } else {
+            termId = static_cast<std::uint32_t>(mid);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CooccurrenceMatrix::rowRange(std::uint32_t termId, std::uint64_t& begin, std::uint64_t& end) const {
+    if (termId >= termCount_) {
+        return false;
+    }
+    begin = readAt<std::uint64_t>(rowOffsets_, termId * sizeof(std::uint64_t));
+    end = readAt<std::uint64_t>(rowOffsets_, (termId + 1) * sizeof(std::uint64_t));
+    return begin <= end && end <= nonZeros_;
+}
+
+std::vector<std::pair<std::uint32_t, std::uint64_t>> CooccurrenceMatrix::row(std::uint32_t termId) const {
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> entries;
+    std::uint64_t begin = 0, end = 0;
+    if (!rowRange(termId, begin, end)) {
+        return entries;
+    }
+    entries.reserve(static_cast<std::size_t>(end - begin));
+    for (std::uint64_t i = begin; i < end; ++i) {
+        entries.emplace_back(readAt<std::uint32_t>(columns_, static_cast<std::size_t>(i) * sizeof(std::uint32_t)),
+                             readAt<std::uint64_t>(values_, static_cast<std::size_t>(i) * sizeof(std::uint64_t)));
+    }
+    return entries;
+}
+
+std::uint64_t CooccurrenceMatrix::count(std::uint32_t row, std::uint32_t column) const {
+    std::uint64_t begin = 0, end = 0;
+    if (!rowRange(row, begin, end)) {
+        return 0;
+    }
+    while (begin < end) {
+        std::uint64_t mid = begin + (end - begin) / 2;
+        std::uint32_t id = readAt<std::uint32_t>(columns_, static_cast<std::size_t>(mid) * sizeof(std::uint32_t));
+        if (id < column) {
+            begin = mid + 1;
+        } else if (column < id) {
+            end = mid;
+        } else {
+            return readAt<std::uint64_t>(values_, static_cast<std::size_t>(mid) * sizeof(std::uint64_t));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#ifndef COOCCURRENCE_H
+#define COOCCURRENCE_H
+
+#include "P3_MappedFile.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// Co-occurrence job settings (see MapReduceController::setCooccurrence).
+// Two words co-occur when they are at most `window` words apart in a file,
+// or anywhere on the same line with window == 0. Each pair of positions is
+// counted once in both directions, so the matrix is symmetric. A word
+// repeated within the window adds 1 per pair of positions to its own
+// diagonal cell.
+struct CooccurrenceOptions {
+    unsigned int window = 2;
+};
+
+// The "stripe" of one word: its neighbors' word IDs and counts in an
+// open-addressing table over two flat arrays. A worker keeps one stripe per
+// word it has seen instead of emitting (word, neighbor) pairs, and stripes
+// of the same word are merged at reduce time.
+class Stripe {
+public:
+    void add(std::uint32_t id, std::uint64_t count = 1);
+    void merge(const Stripe& other);
+
+    std::size_t size() const;
+    std::size_t memoryBytes() const;
+
+    // Calls fn(id, count) for every neighbor, in no particular order.
+    template <typename Fn>
+    void forEach(Fn&& fn) const;
+
+private:
+    static constexpr std::uint32_t kEmpty = 0xFFFFFFFFu;
+
+    void rehash(std::size_t slotCount);
+
+    std::vector<std::uint32_t> ids_;     // kEmpty = free slot
+    std::vector<std::uint64_t> counts_;
+    std::size_t size_ = 0;
+};
+
+// Co-occurrence matrix file in CSR form.
+//
+// Layout (little-endian, offsets from the start of the file):
+//   header       CooccurrenceHeader
+//   dictionary   per term, sorted by term (term ID = position):
+//                [u64 name offset][u32 name length][u32 reserved]
+//   names        term text
+//   row offsets  u64 per term, plus one: row r spans entries
+//                [offsets[r], offsets[r + 1])
+//   columns      u32 term ID per entry, ascending within a row
+//   values       u64 count per entry
+class CooccurrenceWriter {
+public:
+    static bool write(const std::string& path,
+                      const CooccurrenceOptions& options,
+                      const std::vector<std::string>& terms,
+                      const std::vector<std::uint64_t>& rowOffsets,
+                      const std::vector<std::uint32_t>& columns,
+                      const std::vector<std::uint64_t>& values);
+};
+
+class CooccurrenceMatrix {
+public:
+    bool open(const std::string& path);
+
+    std::size_t termCount() const;
+    std::uint64_t nonZeros() const;
+    unsigned int window() const;
+
+    std::string_view term(std::uint32_t termId) const;
+
+    // Term ID of `term` by binary search. Returns false if absent.
+    bool find(std::string_view term, std::uint32_t& termId) const;
+
+    // (neighbor term ID, count) pairs of a row, ascending by ID.
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> row(std::uint32_t termId) const;
+
+    // Count of one cell (0 if absent), by binary search in the row.
+    std::uint64_t count(std::uint32_t row, std::uint32_t column) const;
+
+private:
+    std::string_view nameAt(std::uint64_t offset, std::uint32_t length) const;
+    bool rowRange(std::uint32_t termId, std::uint64_t& begin, std::uint64_t& end) const;
+
+    MappedFile file_;
+    std::size_t termCount_ = 0;
+    std::uint64_t nonZeros_ = 0;
+    unsigned int window_ = 0;
+    const unsigned char* dictionary_ = nullptr;
+    const unsigned char* names_ = nullptr;
+    const unsigned char* rowOffsets_ = nullptr;
+    const unsigned char* columns_ = nullptr;
+    const unsigned char* values_ = nullptr;
+    std::size_t namesSize_ = 0;
+};
+
+template <typename Fn>
+void Stripe::forEach(Fn&& fn) const {
+    for (std::size_t slot = 0; slot < ids_.size(); ++slot) {
+        if (ids_[slot] != kEmpty) {
+            fn(ids_[slot], counts_[slot]);
+        }
+    }
+}
+
+#endif // COOCCURRENCE_H
@@ -0,0 +1,260 @@
+#include "P3_FileDiscovery.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Match a bracket expression starting at p ('[' already consumed). Sets
+// `matched` and returns the position after ']', or nullptr if unterminated.
+const char* matchClass(const char* p, char c, bool& matched) {
+    bool negate = (*p == '!' || *p == '^');
+    if (negate) {
+        ++p;
+    }
+    matched = false;
+    bool first = true;
+    while (*p && (first || *p != ']')) {
+        first = false;
+        char lo = *p;
+        char hi = lo;
+        if (p[1] == '-' && p[2] && p[2] != ']') {
+            hi = p[2];
+            p += 2;
+        }
+        if (lo <= c && c <= hi) {
+            matched = true;
+        }
+        ++p;
+    }
+    if (*p != ']') {
+        return nullptr;
+    }
+    matched = (matched != negate);
+    return p + 1;
+}
+
+bool matchFrom(const char* p, const char* t) {
+    while (*p) {
+        if (*p == '*') {
+            bool deep = (p[1] == '*');
+            p += deep ? 2 : 1;
+            // "**/" also matches zero directories.
+            if (deep && *p == '/' && matchFrom(p + 1, t)) {
+                return true;
+            }
+            for (const char* s = t;; ++s) {
+                if (matchFrom(p, s)) {
+                    return true;
+                }
+                if (!*s || (!deep && *s == '/')) {
+                    return false;
+                }
+            }
+        }
+        if (!*t) {
+            return false;
+        }
+        if (*p == '?') {
+            if (*t == '/') {
+                return false;
+            }
+            ++p;
+        } else if (*p == '[') {
+            bool matched = false;
+            const char* next = matchClass(p + 1, *t, matched);
+            if (next) {
+                if (!matched || *t == '/') {
+                    return false;
+                }
+                p = next;
+            } else {
+                // Unterminated bracket: treat '[' literally.
+                if (*t != '[') {
+                    return false;
+                }
+                ++p;
+            }
+        } else {
+            if (*p != *t) {
+                return false;
+            }
+            ++p;
+        }
+        ++t;
+    }
+    return !*t;
+}
+
+} // namespace
+
+bool globMatch(const std::string& pattern, const std::string& text) {
+    return matchFrom(pattern.c_str(), text.c_str());
+}
+
+void FileQueue::push(std::filesystem::path path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_.push_back(std::move(path));
+        ++pushed_;
+    }
+    ready_.notify_one();
+}
+
+void FileQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    ready_.notify_all();
+}
+
+bool FileQueue::pop(std::filesystem::path& path) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return !files_.empty() || closed_; });
+    if (files_.empty()) {
+        return false;
+    }
+    path = std::move(files_.front());
+    files_.pop_front();
+    return true;
+}
+
+std::size_t FileQueue::pushed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pushed_;
+}
+
+FileDiscovery::FileDiscovery(const std::filesystem::path& root, const DiscoveryOptions& options)
+    : root_(root), options_(options) {
+}
+
+FileDiscovery::~FileDiscovery() {
+    join();
+}
+
+void FileDiscovery::start(FileQueue& queue, unsigned int walkers) {
+    // A single file is taken as-is, whatever the patterns say.
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(root_, ec)) {
+        queue.push(root_);
+        queue.close();
+        return;
+    }
+    if (!std::filesystem::is_directory(root_, ec)) {
+        std::cerr << "Input path does not exist or is not a directory: " << root_.string() << "\n";
+        queue.close();
+        return;
+    }
+
+    directories_.push_back(root_);
+    done_ = false;
+    // Without recursion there is only one directory to list.
+    if (!options_.recursive) {
+        walkers = 1;
+    }
+    for (unsigned int i = 0; i < std::max(1u, walkers); ++i) {
+        walkers_.emplace_back(&FileDiscovery::walk, this, std::ref(queue));
+    }
+}
+
+void FileDiscovery::join() {
+    for (auto& t : walkers_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    walkers_.clear();
+}
+
+std::vector<std::filesystem::path> FileDiscovery::collect(unsigned int walkers) {
+    FileQueue queue;
+    start(queue, walkers);
+
+    std::vector<std::filesystem::path> results;
+    std::filesystem::path path;
+    while (queue.pop(path)) {
+        results.push_back(path);
+    }
+    join();
+
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+bool FileDiscovery::accepts(const std::filesystem::path& path, bool isDirectory) const {
+    const std::string relative = path.lexically_relative(root_).generic_string();
+    const std::string name = path.filename().string();
+
+    auto matchesAny = [&](const std::vector<std::string>& patterns) {
+        for (const auto& pattern : patterns) {
+            bool byPath = pattern.find('/') != std::string::npos;
+            if (globMatch(pattern, byPath ? relative : name)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (matchesAny(options_.exclude)) {
+        return false;
+    }
+    return isDirectory || matchesAny(options_.include);
+}
+
+void FileDiscovery::walk(FileQueue& queue) {
+    while (true) {
+        std::filesystem::path dir;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workReady_.wait(lock, [this] { return !directories_.empty() || done_; });
+            if (directories_.empty()) {
+                return;
+            }
+            dir = std::move(directories_.back());
+            directories_.pop_back();
+            ++busy_;
+        }
+
+        std::vector<std::filesystem::path> subdirectories;
+        std::error_code ec;
+        std::filesystem::directory_iterator it(
+            dir, std::filesystem::directory_options::skip_permission_denied, ec);
+        for (std::filesystem::directory_iterator end; !ec && it != end; it.increment(ec)) {
+            const auto& entry = *it;
+            std::error_code typeEc;
+            // Directory symlinks are not followed, so cycles cannot occur.
+            if (entry.is_symlink(typeEc) && entry.is_directory(typeEc)) {
+                continue;
+            }
+            if (entry.is_directory(typeEc)) {
+                if (options_.recursive && accepts(entry.path(), true)) {
+                    subdirectories.push_back(entry.path());
+                }
+            } else if (entry.is_regular_file(typeEc) && accepts(entry.path(), false)) {
+                queue.push(entry.path());
+            }
+        }
+        if (ec) {
+            std::cerr << "Failed to list directory: " << dir.string()
+                      << " error: " << ec.message() << "\n";
+        }
+
+        bool finished = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            directories_.insert(directories_.end(), subdirectories.begin(), subdirectories.end());
+            --busy_;
+            if (directories_.empty() && busy_ == 0) {
+                done_ = true;
+                finished = true;
+            }
+        }
+        if (finished) {
+            queue.close();
+            workReady_.notify_all();
+        } else if (!subdirectories.empty()) {
+            workReady_.notify_all();
+        }
+    }
+}
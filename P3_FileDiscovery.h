@@ -0,0 +1,89 @@
+#ifndef FILEDISCOVERY_H
+#define FILEDISCOVERY_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <cstddef>
+
+// Which files under the input root are job input.
+struct DiscoveryOptions {
+    bool recursive = false;
+    // Glob patterns ('*', '?', '[...]', and '**' across directories). A
+    // pattern containing '/' is matched against the path relative to the
+    // root, otherwise against the file name. A file is accepted if it matches
+    // any include pattern and no exclude pattern. Excluded directories are
+    // not descended into.
+    std::vector<std::string> include{ "*.txt", "*.txt.gz", "*.txt.zst" };
+    std::vector<std::string> exclude;
+};
+
+// Glob match of `text` against `pattern` (see DiscoveryOptions).
+bool globMatch(const std::string& pattern, const std::string& text);
+
+// Unbounded multi-producer / multi-consumer queue of discovered files.
+// Consumers block in pop() until a file arrives or the queue is closed.
+class FileQueue {
+public:
+    void push(std::filesystem::path path);
+
+    // No more files will be pushed; wakes all waiting consumers.
+    void close();
+
+    // Next file, or false once the queue is closed and drained.
+    bool pop(std::filesystem::path& path);
+
+    // Files pushed so far.
+    std::size_t pushed() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::filesystem::path> files_;
+    std::size_t pushed_ = 0;
+    bool closed_ = false;
+};
+
+// Walks the input root on several threads. Each walker lists one directory
+// at a time and hands subdirectories back to the shared work list, so wide
+// trees (e.g. date partitions) are enumerated in parallel. Matching files
+// are pushed to the queue as soon as they are found, and the queue is
+// closed when the walk ends.
+class FileDiscovery {
+public:
+    FileDiscovery(const std::filesystem::path& root, const DiscoveryOptions& options);
+    ~FileDiscovery();
+
+    FileDiscovery(const FileDiscovery&) = delete;
+    FileDiscovery& operator=(const FileDiscovery&) = delete;
+
+    // Start walking in the background; returns immediately.
+    void start(FileQueue& queue, unsigned int walkers);
+
+    // Wait for the walk to finish.
+    void join();
+
+    // Walk to completion and return every matching file, sorted.
+    std::vector<std::filesystem::path> collect(unsigned int walkers);
+
+private:
+    bool accepts(const std::filesystem::path& path, bool isDirectory) const;
+    void walk(FileQueue& queue);
+
+    std::filesystem::path root_;
+    DiscoveryOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable workReady_;
+    std::vector<std::filesystem::path> directories_;
+    std::size_t busy_ = 0;
+    bool done_ = false;
+    std::vector<std::thread> walkers_;
+};
+
+#endif // FILEDISCOVERY_H
@@ -1,42 +1,74 @@
 #include "P3_FileManager.h"
+#include "P3_ResultStore.h"
+#include "P3_OutputWriter.h"
+#include "P3_Compression.h"
+#include "P3_ReadAhead.h"
 
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 
 FileManager::FileManager(const std::string& rootDirectoryIn)
     : rootDirectory(rootDirectoryIn) {
 }
 
-std::vector<std::filesystem::path> FileManager::listTextFiles() const {
-    std::vector<std::filesystem::path> results;
+void FileManager::setDiscoveryOptions(const DiscoveryOptions& options) {
+    discovery = options;
+}
 
-    std::filesystem::path rootPath(rootDirectory);
+const DiscoveryOptions& FileManager::discoveryOptions() const {
+    return discovery;
+}
 
-    // If the path is a single existing file, just return it.
-    if (std::filesystem::exists(rootPath) && std::filesystem::is_regular_file(rootPath)) {
-        results.push_back(rootPath);
-        return results;
-    }
+std::vector<std::filesystem::path> FileManager::listTextFiles(unsigned int walkers) const {
+    FileDiscovery walker(rootDirectory, discovery);
+    return walker.collect(walkers);
+}
 
-    // Otherwise, it must be a directory.
-    if (!std::filesystem::exists(rootPath) || !std::filesystem::is_directory(rootPath)) {
-        std::cerr << "Input path does not exist or is not a directory: "
-                  << rootDirectory << "\n";
-        return results;
-    }
+namespace {
 
-    for (const auto& entry : std::filesystem::directory_iterator(rootPath)) {
-        if (entry.is_regular_file()) {
-            auto path = entry.path();
-            if (path.extension() == ".txt") {
-                results.push_back(path);
-            }
-        }
+// True if the file starts with a compression magic (see P3_Compression.h).
+bool isCompressed(std::ifstream& in) {
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    std::size_t got = static_cast<std::size_t>(in.gcount());
+    in.clear();
+    in.seekg(0);
+    return detectCodec(magic, got) != Codec::None;
+}
+
+// Split decompressed contents into lines with std::getline semantics.
+template <typename Lines, typename Line>
+void splitLines(const std::vector<char>& data, Lines& lines, const Line& prototype) {
+    std::size_t start = 0;
+    while (start < data.size()) {
+        const char* begin = data.data() + start;
+        const char* newline = static_cast<const char*>(
+            std::memchr(begin, '\n', data.size() - start));
+        std::size_t length = newline ? static_cast<std::size_t>(newline - begin) : data.size() - start;
+        Line line(prototype);
+        line.assign(begin, length);
+        lines.push_back(std::move(line));
+        start += length + 1;
     }
+}
+
+} // namespace
 
-    std::sort(results.begin(), results.end());
-    return results;
+bool FileManager::readContents(const std::filesystem::path& filePath,
+                               std::vector<char>& data,
+                               unsigned int threads) const {
+    if (!ReadAheadPipeline::readFile(filePath, data)) {
+        std::cerr << "Failed to open file for reading: " << filePath << "\n";
+        return false;
+    }
+    if (!decompressInPlace(data, threads)) {
+        std::cerr << "Failed to decompress: " << filePath << "\n";
+        data.clear();
+        return false;
+    }
+    return true;
 }
 
 std::vector<std::string> FileManager::readAllLines(const std::filesystem::path& filePath) const {
@@ -47,6 +79,13 @@ std::vector<std::string> FileManager::readAllLines(const std::filesystem::path&
         return lines;
     }
 
+    if (isCompressed(in)) {
+        std::vector<char> data;
+        readContents(filePath, data);
+        splitLines(data, lines, std::string());
+        return lines;
+    }
+
     std::string line;
     while (std::getline(in, line)) {
         lines.push_back(line);
@@ -55,6 +94,32 @@ std::vector<std::string> FileManager::readAllLines(const std::filesystem::path&
     return lines;
 }
 
+std::pmr::vector<std::pmr::string> FileManager::readAllLines(
+    const std::filesystem::path& filePath,
+    std::pmr::memory_resource* resource) const {
+
+    std::pmr::vector<std::pmr::string> lines(resource);
+    std::ifstream in(filePath);
+    if (!in.is_open()) {
+        std::cerr << "Failed to open file for reading: " << filePath << "\n";
+        return lines;
+    }
+
+    if (isCompressed(in)) {
+        std::vector<char> data;
+        readContents(filePath, data);
+        splitLines(data, lines, std::pmr::string(resource));
+        return lines;
+    }
+
+    std::pmr::string line(resource);
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+
+    return lines;
+}
+
 void FileManager::ensureDirectory(const std::filesystem::path& dir) const {
     if (dir.empty()) {
         return;
@@ -69,23 +134,20 @@ void FileManager::ensureDirectory(const std::filesystem::path& dir) const {
     }
 }
 
-void FileManager::writeWordCounts(
+bool FileManager::writeWordCounts(
     const std::string& outputFile,
-    const std::vector<std::pair<std::string, std::size_t>>& wordCounts
+    const std::vector<std::pair<std::string, std::size_t>>& wordCounts,
+    Codec codec
 ) const {
-    std::ofstream out(outputFile);
-    if (!out.is_open()) {
-        std::cerr << "Failed to open output file for writing: "
-                  << outputFile << "\n";
-        return;
-    }
-
-    for (const auto& pair : wordCounts) {
-        out << pair.first << "," << pair.second << "\n";
-    }
+    return CsvOutputWriter::write(outputFile, wordCounts, 0, codec);
+}
 
-    std::cout << "Wrote " << wordCounts.size()
-              << " word counts to " << outputFile << "\n";
+bool FileManager::writeWordCountStore(
+    const std::string& outputFile,
+    const std::vector<std::pair<std::string, std::size_t>>& wordCounts,
+    bool withBloomFilter
+) const {
+    return ResultStoreWriter::write(outputFile, wordCounts, withBloomFilter);
 }
 
 const std::string& FileManager::getRootDirectory() const {
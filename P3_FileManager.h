@@ -5,31 +5,64 @@
 #include <vector>
 #include <filesystem>
 #include <utility>
+#include <memory_resource>
+
+#include "P3_FileDiscovery.h"
+#include "P3_Compression.h"
 
 class FileManager {
 public:
     explicit FileManager(const std::string& rootDirectory);
 
-    // If rootDirectory is a directory, returns all .txt files inside.
+    // Which files under the root are input (default: top-level *.txt).
+    void setDiscoveryOptions(const DiscoveryOptions& options);
+    const DiscoveryOptions& discoveryOptions() const;
+
+    // If rootDirectory is a directory, returns all matching files inside,
+    // sorted, walking subdirectories on `walkers` threads when recursive.
     // If it is a single file, returns a vector containing just that file.
-    std::vector<std::filesystem::path> listTextFiles() const;
+    std::vector<std::filesystem::path> listTextFiles(unsigned int walkers = 1) const;
 
-    // Read all lines from a text file.
+    // Whole contents of a file, decompressed on the fly if it starts with a
+    // gzip or zstd magic (see P3_Compression.h).
+    bool readContents(const std::filesystem::path& filePath,
+                      std::vector<char>& data,
+                      unsigned int threads = 1) const;
+
+    // Read all lines from a text file (compressed files are detected).
     std::vector<std::string> readAllLines(const std::filesystem::path& filePath) const;
 
+    // Same, but the vector and every line are allocated from `resource`
+    // (typically a per-task arena released when the task finishes).
+    std::pmr::vector<std::pmr::string> readAllLines(const std::filesystem::path& filePath,
+                                                    std::pmr::memory_resource* resource) const;
+
     // Make sure a directory (and its parents) exist.
     void ensureDirectory(const std::filesystem::path& dir) const;
 
-    // Write (word, count) pairs as CSV to an output file.
-    void writeWordCounts(
+    // Write (word, count) pairs as CSV to an output file. Formatting runs in
+    // parallel and the file is replaced atomically (see P3_OutputWriter.h),
+    // optionally gzip or zstd compressed. Returns false if the file could not
+    // be written; the previous output is then left in place.
+    bool writeWordCounts(
+        const std::string& outputFile,
+        const std::vector<std::pair<std::string, std::size_t>>& wordCounts,
+        Codec codec = Codec::None
+    ) const;
+
+    // Write (word, count) pairs as an indexed, memory-mappable result store.
+    // Returns false on error.
+    bool writeWordCountStore(
         const std::string& outputFile,
-        const std::vector<std::pair<std::string, std::size_t>>& wordCounts
+        const std::vector<std::pair<std::string, std::size_t>>& wordCounts,
+        bool withBloomFilter
     ) const;
 
     const std::string& getRootDirectory() const;
 
 private:
     std::string rootDirectory;
+    DiscoveryOptions discovery;
 };
 
 #endif // FILEMANAGER_H
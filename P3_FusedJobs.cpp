@@ -0,0 +1,220 @@
+#include "P3_FusedJobs.h"
+#include "P3_FileManager.h"
+#include "P3_OutputWriter.h"
+#include "P3_Reducer.h"
+#include "P3_SymbolTable.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+
+FusedJob::FusedJob(const std::string& outputFile)
+    : outputFile_(outputFile) {
+}
+
+std::unique_ptr<FusedJob> FusedJob::fromSpec(const std::string& spec, std::size_t topK) {
+    std::size_t eq = spec.find('=');
+    if (eq == std::string::npos || eq + 1 == spec.size()) {
+        std::cerr << "Job spec needs an output: " << spec << " (e.g. words=out/words.csv)\n";
+        return nullptr;
+    }
+    std::string kind = spec.substr(0, eq);
+    std::string output = spec.substr(eq + 1);
+
+    if (kind == "words") {
+        return std::make_unique<WordCountJob>(output, topK);
+    }
+    if (kind == "filestats") {
+        return std::make_unique<FileStatsJob>(output);
+    }
+    if (kind.rfind("ngram:", 0) == 0) {
+        unsigned int n = 0;
+        const char* first = kind.data() + 6;
+        const char* last = kind.data() + kind.size();
+        auto parsed = std::from_chars(first, last, n);
+        if (parsed.ec == std::errc() && parsed.ptr == last && n >= 1) {
+            return std::make_unique<NGramJob>(output, n, topK);
+        }
+    }
+    std::cerr << "Unknown job kind: " << kind << " (use words, ngram:<n> or filestats)\n";
+    return nullptr;
+}
+
+void FusedJob::beginFile(unsigned int, const std::string&, std::size_t) {
+}
+
+void FusedJob::endFile(unsigned int) {
+}
+
+const std::string& FusedJob::outputFile() const {
+    return outputFile_;
+}
+
+// ---------------------------------------------------------------------------
+
+WordCountJob::WordCountJob(const std::string& outputFile, std::size_t topK)
+    : FusedJob(outputFile),
+      topK_(topK) {
+}
+
+std::string WordCountJob::name() const {
+    return "words";
+}
+
+void WordCountJob::prepare(unsigned int workers) {
+    counts_.resize(workers);
+}
+
+void WordCountJob::line(unsigned int worker, const std::uint32_t* ids, std::size_t count) {
+    auto& counts = counts_[worker];
+    for (std::size_t i = 0; i < count; ++i) {
+        ++counts[ids[i]];
+    }
+}
+
+bool WordCountJob::finish(const SymbolTable& symbols, FileManager& fileManager, Codec codec) {
+    const unsigned int partitions = static_cast<unsigned int>(std::max<std::size_t>(1, counts_.size()));
+    std::vector<PartitionedCounts> mapped;
+    mapped.reserve(counts_.size());
+    for (auto& counts : counts_) {
+        mapped.push_back(Reducer::partition(counts, partitions));
+        std::pmr::unordered_map<std::uint32_t, std::size_t>().swap(counts);
+    }
+
+    Reducer reducer;
+    std::vector<std::pair<std::string, std::size_t>> rows;
+    if (!reducer.reduceIds(mapped, symbols, topK_, rows)) {
+        return false;
+    }
+    fileManager.ensureDirectory(std::filesystem::path(outputFile()).parent_path());
+    return fileManager.writeWordCounts(outputFile(), rows, codec);
+}
+
+// ---------------------------------------------------------------------------
+
+NGramJob::NGramJob(const std::string& outputFile, unsigned int n, std::size_t topK)
+    : FusedJob(outputFile),
+      n_(n),
+      topK_(topK) {
+}
+
+std::string NGramJob::name() const {
+    return "ngram:" + std::to_string(n_);
+}
+
+void NGramJob::prepare(unsigned int workers) {
+    tables_.assign(workers, NGramTable(n_));
+    windows_.assign(workers, NGramWindow(n_));
+}
+
+void NGramJob::beginFile(unsigned int worker, const std::string&, std::size_t) {
+    windows_[worker].reset();
+}
+
+void NGramJob::line(unsigned int worker, const std::uint32_t* ids, std::size_t count) {
+    NGramWindow& window = windows_[worker];
+    NGramTable& table = tables_[worker];
+    for (std::size_t i = 0; i < count; ++i) {
+        if (window.push(ids[i])) {
+            table.add(window.ids());
+        }
+    }
+}
+
+bool NGramJob::finish(const SymbolTable& symbols, FileManager& fileManager, Codec codec) {
+    if (tables_.empty()) {
+        tables_.emplace_back(n_);
+    }
+    NGramTable& merged = tables_.front();
+    for (std::size_t i = 1; i < tables_.size(); ++i) {
+        merged.merge(tables_[i]);
+        tables_[i] = NGramTable(n_);
+    }
+    fileManager.ensureDirectory(std::filesystem::path(outputFile()).parent_path());
+    return fileManager.writeWordCounts(outputFile(), ngramRows(merged, symbols, topK_), codec);
+}
+
+// ---------------------------------------------------------------------------
+
+FileStatsJob::FileStatsJob(const std::string& outputFile)
+    : FusedJob(outputFile) {
+}
+
+std::string FileStatsJob::name() const {
+    return "filestats";
+}
+
+void FileStatsJob::prepare(unsigned int workers) {
+    workers_.resize(workers);
+}
+
+void FileStatsJob::beginFile(unsigned int worker, const std::string& path, std::size_t bytes) {
+    WorkerState& state = workers_[worker];
+    state.current = FileStats();
+    state.current.path = path;
+    state.current.bytes = bytes;
+    state.seen.clear();
+}
+
+void FileStatsJob::line(unsigned int worker, const std::uint32_t* ids, std::size_t count) {
+    WorkerState& state = workers_[worker];
+    ++state.current.lines;
+    state.current.words += count;
+    state.seen.insert(ids, ids + count);
+}
+
+void FileStatsJob::endFile(unsigned int worker) {
+    WorkerState& state = workers_[worker];
+    state.current.distinct = state.seen.size();
+    state.done.push_back(std::move(state.current));
+}
+
+bool FileStatsJob::finish(const SymbolTable&, FileManager& fileManager, Codec codec) {
+    std::vector<FileStats> all;
+    for (auto& state : workers_) {
+        std::move(state.done.begin(), state.done.end(), std::back_inserter(all));
+        state.done.clear();
+    }
+    std::sort(all.begin(), all.end(),
+              [](const FileStats& a, const FileStats& b) { return a.path < b.path; });
+
+    std::string text = "file,bytes,lines,words,distinct_words\n";
+    for (const auto& stats : all) {
+        // Paths are quoted when they contain CSV separators.
+        if (stats.path.find_first_of(",\"\n") != std::string::npos) {
+            text += '"';
+            for (char c : stats.path) {
+                text += c;
+                if (c == '"') {
+                    text += '"';
+                }
+            }
+            text += '"';
+        } else {
+            text += stats.path;
+        }
+        text += ',' + std::to_string(stats.bytes) + ',' + std::to_string(stats.lines) + ',' +
+                std::to_string(stats.words) + ',' + std::to_string(stats.distinct) + '\n';
+    }
+
+    std::vector<char> compressed;
+    const char* data = text.data();
+    std::size_t size = text.size();
+    if (codec != Codec::None) {
+        if (!compressBuffer(codec, text.data(), text.size(), compressed)) {
+            return false;
+        }
+        data = compressed.data();
+        size = compressed.size();
+    }
+
+    fileManager.ensureDirectory(std::filesystem::path(outputFile()).parent_path());
+    AtomicOutputFile out;
+    if (!out.open(outputFile()) || !out.append(data, size) || !out.commit()) {
+        std::cerr << "Failed to write file stats: " << outputFile() << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+#ifndef FUSEDJOBS_H
+#define FUSEDJOBS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory_resource>
+#include <cstdint>
+#include <cstddef>
+
+#include "P3_NGram.h"
+#include "P3_Compression.h"
+
+class SymbolTable;
+class FileManager;
+
+// One job fed by a shared input scan (see MapReduceController::addJob).
+// The controller reads and tokenizes every file once, interning words in a
+// shared SymbolTable, and hands each line's token IDs to every registered
+// job. Jobs keep one state per mapper thread, indexed by `worker`, so the
+// per-line calls need no locking; finish() merges them and writes the
+// job's own output file.
+class FusedJob {
+public:
+    explicit FusedJob(const std::string& outputFile);
+    virtual ~FusedJob() = default;
+
+    // Builds a job from a CLI spec "<kind>=<output>", where kind is
+    // "words", "ngram:<n>" or "filestats". topK applies to the count jobs.
+    // Returns nullptr (with a message on stderr) for a bad spec.
+    static std::unique_ptr<FusedJob> fromSpec(const std::string& spec, std::size_t topK);
+
+    virtual std::string name() const = 0;
+
+    // Called once before the scan with the number of mapper threads.
+    virtual void prepare(unsigned int workers) = 0;
+
+    virtual void beginFile(unsigned int worker, const std::string& path, std::size_t bytes);
+    // Token IDs of one line of the current file, in order.
+    virtual void line(unsigned int worker, const std::uint32_t* ids, std::size_t count) = 0;
+    virtual void endFile(unsigned int worker);
+
+    // Merge the worker states and write the output. Returns false on error.
+    virtual bool finish(const SymbolTable& symbols, FileManager& fileManager, Codec codec) = 0;
+
+    const std::string& outputFile() const;
+
+private:
+    std::string outputFile_;
+};
+
+// "word,count" rows, like the default job.
+class WordCountJob : public FusedJob {
+public:
+    WordCountJob(const std::string& outputFile, std::size_t topK);
+
+    std::string name() const override;
+    void prepare(unsigned int workers) override;
+    void line(unsigned int worker, const std::uint32_t* ids, std::size_t count) override;
+    bool finish(const SymbolTable& symbols, FileManager& fileManager, Codec codec) override;
+
+private:
+    std::size_t topK_;
+    std::vector<std::pmr::unordered_map<std::uint32_t, std::size_t>> counts_;
+};
+
+// "w1 ... wn,count" rows; n-grams never span two files.
+class NGramJob : public FusedJob {
+public:
+    NGramJob(const std::string& outputFile, unsigned int n, std::size_t topK);
+
+    std::string name() const override;
+    void prepare(unsigned int workers) override;
+    void beginFile(unsigned int worker, const std::string& path, std::size_t bytes) override;
+    void line(unsigned int worker, const std::uint32_t* ids, std::size_t count) override;
+    bool finish(const SymbolTable& symbols, FileManager& fileManager, Codec codec) override;
+
+private:
+    unsigned int n_;
+    std::size_t topK_;
+    std::vector<NGramTable> tables_;
+    std::vector<NGramWindow> windows_;
+};
+
+// One CSV row per input file: "file,bytes,lines,words,distinct_words".
+class FileStatsJob : public FusedJob {
+public:
+    explicit FileStatsJob(const std::string& outputFile);
+
+    std::string name() const override;
+    void prepare(unsigned int workers) override;
+    void beginFile(unsigned int worker, const std::string& path, std::size_t bytes) override;
+    void line(unsigned int worker, const std::uint32_t* ids, std::size_t count) override;
+    void endFile(unsigned int worker) override;
+    bool finish(const SymbolTable& symbols, FileManager& fileManager, Codec codec) override;
+
+private:
+    struct FileStats {
+        std::string path;
+        std::size_t bytes = 0;
+        std::size_t lines = 0;
+        std::size_t words = 0;
+        std::size_t distinct = 0;
+    };
+    struct WorkerState {
+        std::vector<FileStats> done;
+        FileStats current;
+        std::unordered_set<std::uint32_t> seen;
+    };
+    std::vector<WorkerState> workers_;
+};
+
+#endif // FUSEDJOBS_H
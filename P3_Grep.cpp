@@ -0,0 +1,291 @@
+#include "P3_Grep.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+unsigned char lower(unsigned char c) {
+    return static_cast<unsigned char>(std::tolower(c));
+}
+
+// Splits a pattern at '|' that are outside groups and bracket classes.
+std::vector<std::string> topLevelAlternatives(const std::string& pattern) {
+    std::vector<std::string> branches(1);
+    int depth = 0;
+    bool inClass = false;
+    for (std::size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (c == '\\' && i + 1 < pattern.size()) {
+            branches.back() += c;
+            branches.back() += pattern[++i];
+            continue;
+        }
+        if (inClass) {
+            inClass = c != ']';
+        } else if (c == '[') {
+            inClass = true;
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')') {
+            --depth;
+        } else if (c == '|' && depth == 0) {
+            branches.emplace_back();
+            continue;
+        }
+        branches.back() += c;
+    }
+    return branches;
+}
+
+// Index of the '}' closing a {m,n} quantifier that opens at `open`, or
+// `open` itself if there is none.
+std::size_t quantifierEnd(const std::string& branch, std::size_t open) {
+    std::size_t close = branch.find('}', open);
+    return close == std::string::npos ? open : close;
+}
+
+// True if the {m,n} quantifier opening at `open` allows zero repetitions.
+bool quantifierAllowsZero(const std::string& branch, std::size_t open) {
+    std::size_t i = open + 1;
+    std::size_t digits = 0;
+    while (i < branch.size() && branch[i] == '0') {
+        ++i;
+        ++digits;
+    }
+    return digits > 0 && (i >= branch.size() || !std::isdigit(static_cast<unsigned char>(branch[i])));
+}
+
+// Longest run of plain characters that every match of `branch` contains.
+std::string longestRequiredRun(const std::string& branch) {
+    std::string best, run;
+    auto endRun = [&]() {
+        if (run.size() > best.size()) {
+            best = run;
+        }
+        run.clear();
+    };
+
+    for (std::size_t i = 0; i < branch.size(); ++i) {
+        char c = branch[i];
+        bool literal = false;
+        char value = c;
+        if (c == '\\' && i + 1 < branch.size()) {
+            char next = branch[++i];
+            // Escaped punctuation is literal; \d, \w, \b, \n ... are not,
+            // and neither are the operands of \xhh, \uhhhh, \cX and the
+            // \0 / backreference digits.
+            if (std::ispunct(static_cast<unsigned char>(next))) {
+                literal = true;
+                value = next;
+            } else if (next == 'x') {
+                i = std::min(i + 2, branch.size() - 1);
+            } else if (next == 'u') {
+                i = std::min(i + 4, branch.size() - 1);
+            } else if (next == 'c') {
+                i = std::min(i + 1, branch.size() - 1);
+            } else if (std::isdigit(static_cast<unsigned char>(next))) {
+                while (i + 1 < branch.size() && std::isdigit(static_cast<unsigned char>(branch[i + 1]))) {
+                    ++i;
+                }
+            }
+        } else if (c == '[') {
+            // Skip the class: it matches one of several characters.
+            ++i;
+            if (i < branch.size() && branch[i] == ']') {
+                ++i;
+            }
+            while (i < branch.size() && branch[i] != ']') {
+                i += branch[i] == '\\' ? 2 : 1;
+            }
+        } else if (c == '(') {
+            // Groups may hold alternatives or be optional: skip them whole.
+            int depth = 1;
+            while (++i < branch.size() && depth > 0) {
+                if (branch[i] == '\\') {
+                    ++i;
+                } else if (branch[i] == '(') {
+                    ++depth;
+                } else if (branch[i] == ')') {
+                    --depth;
+                }
+            }
+            --i;
+        } else if (c == '{') {
+            // The counts of a quantifier are not text to match.
+            i = quantifierEnd(branch, i);
+        } else if (std::strchr(".^$*+?{}|)", c) == nullptr) {
+            literal = true;
+        }
+
+        if (!literal) {
+            endRun();
+            continue;
+        }
+
+        // A quantifier applies to this character alone.
+        char after = i + 1 < branch.size() ? branch[i + 1] : '\0';
+        if (after == '*' || after == '?' || (after == '{' && quantifierAllowsZero(branch, i + 1))) {
+            endRun();
+        } else if (after == '+' || after == '{') {
+            run += value;
+            endRun();
+        } else {
+            run += value;
+        }
+    }
+    endRun();
+    return best;
+}
+
+} // namespace
+
+std::vector<std::string> requiredLiterals(const std::string& pattern) {
+    std::vector<std::string> literals;
+    for (const std::string& branch : topLevelAlternatives(pattern)) {
+        std::string literal = longestRequiredRun(branch);
+        if (literal.empty()) {
+            return {};
+        }
+        literals.push_back(literal);
+    }
+    return literals;
+}
+
+// ---------------------------------------------------------------------------
+
+void LiteralPrefilter::assign(const std::vector<std::string>& literals, bool ignoreCase) {
+    literals_.clear();
+    firstBytes_.clear();
+    isFirst_.fill(false);
+    ignoreCase_ = ignoreCase;
+
+    for (std::string literal : literals) {
+        if (literal.empty()) {
+            // An empty literal occurs everywhere: filtering is pointless.
+            literals_.clear();
+            firstBytes_.clear();
+            isFirst_.fill(false);
+            return;
+        }
+        if (ignoreCase) {
+            std::transform(literal.begin(), literal.end(), literal.begin(),
+                           [](char c) { return static_cast<char>(lower(static_cast<unsigned char>(c))); });
+        }
+        unsigned char first = static_cast<unsigned char>(literal[0]);
+        isFirst_[first] = true;
+        if (ignoreCase) {
+            isFirst_[static_cast<unsigned char>(std::toupper(first))] = true;
+        }
+        literals_.push_back(std::move(literal));
+    }
+    for (int b = 0; b < 256; ++b) {
+        if (isFirst_[b]) {
+            firstBytes_.push_back(static_cast<unsigned char>(b));
+        }
+    }
+}
+
+bool LiteralPrefilter::active() const {
+    return !literals_.empty();
+}
+
+bool LiteralPrefilter::matchesAt(std::string_view text, std::size_t pos) const {
+    for (const std::string& literal : literals_) {
+        if (literal.size() > text.size() - pos) {
+            continue;
+        }
+        if (!ignoreCase_) {
+            if (std::memcmp(text.data() + pos, literal.data(), literal.size()) == 0) {
+                return true;
+            }
+            continue;
+        }
+        std::size_t i = 0;
+        while (i < literal.size() &&
+               lower(static_cast<unsigned char>(text[pos + i])) == static_cast<unsigned char>(literal[i])) {
+            ++i;
+        }
+        if (i == literal.size()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t LiteralPrefilter::find(std::string_view text, std::size_t from, Cursor& cursor) const {
+    const char* base = text.data();
+    const std::size_t size = text.size();
+
+    if (firstBytes_.size() <= 3) {
+        // One memchr per distinct first byte; the cursor keeps each byte's
+        // next occurrence, so every byte of text is searched once per scan.
+        std::size_t pos = from;
+        while (pos < size) {
+            std::size_t best = std::string_view::npos;
+            for (std::size_t k = 0; k < firstBytes_.size(); ++k) {
+                std::size_t& next = cursor.next[k];
+                if (next == std::string_view::npos) {
+                    continue;  // no more occurrences
+                }
+                if (next == Cursor::kUnknown || next < pos) {
+                    const void* found = std::memchr(base + pos, firstBytes_[k], size - pos);
+                    next = found ? static_cast<std::size_t>(static_cast<const char*>(found) - base)
+                                 : std::string_view::npos;
+                    if (next == std::string_view::npos) {
+                        continue;
+                    }
+                }
+                best = std::min(best, next);
+            }
+            if (best == std::string_view::npos) {
+                return std::string_view::npos;
+            }
+            if (matchesAt(text, best)) {
+                return best;
+            }
+            pos = best + 1;
+        }
+        return std::string_view::npos;
+    }
+
+    for (std::size_t pos = from; pos < size; ++pos) {
+        if (isFirst_[static_cast<unsigned char>(base[pos])] && matchesAt(text, pos)) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// ---------------------------------------------------------------------------
+
+bool GrepMatcher::compile(const GrepOptions& options) {
+    options_ = options;
+    if (options.fixedString) {
+        prefilter_.assign({ options.pattern }, options.ignoreCase);
+        return true;
+    }
+
+    auto flags = std::regex::ECMAScript | std::regex::optimize;
+    if (options.ignoreCase) {
+        flags |= std::regex::icase;
+    }
+    try {
+        regex_ = std::regex(options.pattern, flags);
+    } catch (const std::regex_error& e) {
+        std::cerr << "Invalid grep pattern '" << options.pattern << "': " << e.what() << "\n";
+        return false;
+    }
+    prefilter_.assign(requiredLiterals(options.pattern), options.ignoreCase);
+    return true;
+}
+
+bool GrepMatcher::lineMatches(std::string_view line) const {
+    if (options_.fixedString) {
+        LiteralPrefilter::Cursor cursor;
+        return !prefilter_.active() || prefilter_.find(line, 0, cursor) != std::string_view::npos;
+    }
+    return std::regex_search(line.begin(), line.end(), regex_);
+}
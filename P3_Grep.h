@@ -0,0 +1,109 @@
+#ifndef GREP_H
+#define GREP_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <regex>
+#include <cstddef>
+
+// Grep job settings (see MapReduceController::setGrep).
+struct GrepOptions {
+    std::string pattern;         // ECMAScript regex, or a literal with fixedString
+    bool ignoreCase = false;
+    bool fixedString = false;
+    bool ordered = true;         // sort output by file and offset
+};
+
+// Finds occurrences of any of a small set of literals. Scanning is driven
+// by memchr on the literals' first bytes (up to three distinct bytes, as in
+// memchr2/memchr3), which libc vectorizes; larger sets fall back to a
+// first-byte table. Candidates are then compared in full.
+class LiteralPrefilter {
+public:
+    // An empty set matches everywhere (no filtering).
+    void assign(const std::vector<std::string>& literals, bool ignoreCase);
+
+    bool active() const;
+
+    // Scan state for one text: the next known position of each first byte.
+    struct Cursor {
+        static const std::size_t kUnknown = static_cast<std::size_t>(-2);
+        std::size_t next[3] = { kUnknown, kUnknown, kUnknown };
+    };
+
+    // Offset of the first literal occurrence at or after `from`, or npos.
+    // Successive calls over the same text must share one cursor and use
+    // increasing `from`.
+    std::size_t find(std::string_view text, std::size_t from, Cursor& cursor) const;
+
+private:
+    bool matchesAt(std::string_view text, std::size_t pos) const;
+
+    std::vector<std::string> literals_;  // lowercase when ignoreCase_
+    bool ignoreCase_ = false;
+    std::vector<unsigned char> firstBytes_;  // distinct first bytes (both cases)
+    std::array<bool, 256> isFirst_{};
+};
+
+// Literals at least one of which must occur in every match of `pattern`:
+// one per top-level alternative, each the longest run of plain characters
+// that is not made optional by a quantifier. Empty if some alternative has
+// no such literal (then every line must go to the regex).
+std::vector<std::string> requiredLiterals(const std::string& pattern);
+
+// Prefilter + std::regex confirmation over a text buffer.
+class GrepMatcher {
+public:
+    // Returns false (with a message on stderr) for an invalid regex.
+    bool compile(const GrepOptions& options);
+
+    // Calls fn(offset, line) for every matching line of `text`, where
+    // offset is the byte offset of the line start. Lines without a literal
+    // hit never reach the regex.
+    template <typename Fn>
+    void scan(std::string_view text, Fn&& fn) const;
+
+    // Full check of one line: the regex, or the literal for fixed strings.
+    bool lineMatches(std::string_view line) const;
+
+private:
+    GrepOptions options_;
+    LiteralPrefilter prefilter_;
+    std::regex regex_;
+};
+
+template <typename Fn>
+void GrepMatcher::scan(std::string_view text, Fn&& fn) const {
+    LiteralPrefilter::Cursor cursor;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        std::size_t hit = prefilter_.active() ? prefilter_.find(text, pos, cursor) : pos;
+        if (hit == std::string_view::npos) {
+            return;
+        }
+        // pos is always a line start, so the search back stops there.
+        std::size_t lineStart = pos;
+        if (hit > pos) {
+            std::size_t newline = text.rfind('\n', hit - 1);
+            if (newline != std::string_view::npos && newline >= pos) {
+                lineStart = newline + 1;
+            }
+        }
+        std::size_t lineEnd = text.find('\n', hit);
+        if (lineEnd == std::string_view::npos) {
+            lineEnd = text.size();
+        }
+        std::string_view line = text.substr(lineStart, lineEnd - lineStart);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (lineMatches(line)) {
+            fn(lineStart, line);
+        }
+        pos = lineEnd + 1;
+    }
+}
+
+#endif // GREP_H
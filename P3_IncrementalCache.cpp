@@ -0,0 +1,214 @@
+#include "P3_IncrementalCache.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+namespace {
+const char* kCacheHeader = "MRCACHE 1";
+}
+
+IncrementalCache::IncrementalCache(const std::string& cacheFile)
+    : cacheFile_(cacheFile) {
+}
+
+bool IncrementalCache::load() {
+    entries_.clear();
+    totals_.clear();
+
+    std::ifstream in(cacheFile_);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(in, line) || line != kCacheHeader) {
+        std::cerr << "Ignoring unrecognized incremental cache: " << cacheFile_ << "\n";
+        return false;
+    }
+
+    // Each file record is a header line followed by `wordCount` word lines:
+    //   file <size> <mtime> <hash> <wordCount>\t<path>
+    //   <word>\t<count>
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::size_t tabPos = line.find('\t');
+        if (tabPos == std::string::npos) {
+            break;
+        }
+
+        std::istringstream header(line.substr(0, tabPos));
+        std::string tag;
+        CachedFileEntry entry;
+        std::size_t wordCount = 0;
+        header >> tag >> entry.size >> entry.modifiedTime >> entry.contentHash >> wordCount;
+        if (!header || tag != "file") {
+            break;
+        }
+        std::string path = line.substr(tabPos + 1);
+
+        entry.counts.reserve(wordCount);
+        for (std::size_t i = 0; i < wordCount && std::getline(in, line); ++i) {
+            std::size_t sep = line.find('\t');
+            if (sep == std::string::npos) {
+                continue;
+            }
+            std::size_t count = 0;
+            try {
+                count = static_cast<std::size_t>(std::stoull(line.substr(sep + 1)));
+            } catch (...) {
+                count = 0;
+            }
+            entry.counts.emplace_back(line.substr(0, sep), count);
+        }
+
+        addToTotals(entry);
+        entries_[path] = std::move(entry);
+    }
+
+    return true;
+}
+
+bool IncrementalCache::save() const {
+    std::filesystem::path target(cacheFile_);
+    if (target.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(target.parent_path(), ec);
+    }
+
+    std::string tempFile = cacheFile_ + ".tmp";
+    {
+        std::ofstream out(tempFile, std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Failed to open incremental cache for writing: " << tempFile << "\n";
+            return false;
+        }
+
+        out << kCacheHeader << "\n";
+        for (const auto& entry : entries_) {
+            const CachedFileEntry& e = entry.second;
+            out << "file " << e.size << " " << e.modifiedTime << " " << e.contentHash
+                << " " << e.counts.size() << "\t" << entry.first << "\n";
+            for (const auto& wc : e.counts) {
+                out << wc.first << "\t" << wc.second << "\n";
+            }
+        }
+
+        if (!out) {
+            std::cerr << "Failed to write incremental cache: " << tempFile << "\n";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempFile, cacheFile_, ec);
+    if (ec) {
+        std::cerr << "Failed to replace incremental cache: " << cacheFile_
+                  << " error: " << ec.message() << "\n";
+        return false;
+    }
+    return true;
+}
+
+const CachedFileEntry* IncrementalCache::find(const std::string& path) const {
+    auto it = entries_.find(path);
+    return it == entries_.end() ? nullptr : &it->second;
+}
+
+void IncrementalCache::put(const std::string& path, CachedFileEntry entry) {
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        subtractFromTotals(it->second);
+    }
+    addToTotals(entry);
+    entries_[path] = std::move(entry);
+}
+
+void IncrementalCache::refreshFingerprint(const std::string& path,
+                                          std::uintmax_t size,
+                                          long long modifiedTime) {
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        it->second.size = size;
+        it->second.modifiedTime = modifiedTime;
+    }
+}
+
+std::vector<std::string> IncrementalCache::removeMissing(const std::set<std::string>& present) {
+    std::vector<std::string> removed;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (present.count(it->first) == 0) {
+            subtractFromTotals(it->second);
+            removed.push_back(it->first);
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+std::vector<std::pair<std::string, std::size_t>> IncrementalCache::totals() const {
+    return std::vector<std::pair<std::string, std::size_t>>(totals_.begin(), totals_.end());
+}
+
+std::size_t IncrementalCache::size() const {
+    return entries_.size();
+}
+
+long long IncrementalCache::modifiedTimeOf(const std::filesystem::path& filePath) {
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(filePath, ec);
+    if (ec) {
+        return 0;
+    }
+    return static_cast<long long>(time.time_since_epoch().count());
+}
+
+std::uint64_t IncrementalCache::hashFileContents(const std::filesystem::path& filePath) {
+    // 64-bit FNV-1a over the raw bytes.
+    std::uint64_t hash = hashBytes(nullptr, 0);
+
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in.is_open()) {
+        return 0;
+    }
+
+    std::vector<char> block(64 * 1024);
+    while (in) {
+        in.read(block.data(), static_cast<std::streamsize>(block.size()));
+        hash = hashBytes(block.data(), static_cast<std::size_t>(in.gcount()), hash);
+    }
+    return hash;
+}
+
+std::uint64_t IncrementalCache::hashBytes(const char* data, std::size_t size, std::uint64_t hash) {
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void IncrementalCache::addToTotals(const CachedFileEntry& entry) {
+    for (const auto& wc : entry.counts) {
+        totals_[wc.first] += wc.second;
+    }
+}
+
+void IncrementalCache::subtractFromTotals(const CachedFileEntry& entry) {
+    for (const auto& wc : entry.counts) {
+        auto it = totals_.find(wc.first);
+        if (it == totals_.end()) {
+            continue;
+        }
+        if (it->second <= wc.second) {
+            totals_.erase(it);
+        } else {
+            it->second -= wc.second;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef INCREMENTALCACHE_H
+#define INCREMENTALCACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <cstdint>
+#include <filesystem>
+
+// Partial word counts for one input file, plus the fingerprint used to
+// decide whether the file changed since the last run.
+struct CachedFileEntry {
+    std::uintmax_t size = 0;
+    long long modifiedTime = 0;
+    std::uint64_t contentHash = 0;
+    std::vector<std::pair<std::string, std::size_t>> counts;
+};
+
+// Persists per-file partial aggregates between runs so that only new or
+// changed inputs have to be re-mapped. Running totals are kept in sync:
+// replacing or removing an entry subtracts its old contributions.
+class IncrementalCache {
+public:
+    explicit IncrementalCache(const std::string& cacheFile);
+
+    // Load the cache from disk. Returns false (and leaves the cache empty)
+    // if the file is missing or unreadable.
+    bool load();
+
+    // Write the cache to disk (temp file + rename). Returns true on success.
+    bool save() const;
+
+    // Returns the cached entry for a path, or nullptr if there is none.
+    const CachedFileEntry* find(const std::string& path) const;
+
+    // Insert or replace the entry for a path and update the totals.
+    void put(const std::string& path, CachedFileEntry entry);
+
+    // Update only the fingerprint of an unchanged file (e.g. touched).
+    void refreshFingerprint(const std::string& path, std::uintmax_t size, long long modifiedTime);
+
+    // Drop entries whose path is not in `present`, subtracting their counts.
+    // Returns the removed paths.
+    std::vector<std::string> removeMissing(const std::set<std::string>& present);
+
+    // Final (word, count) totals derived from the cached partials, sorted by word.
+    std::vector<std::pair<std::string, std::size_t>> totals() const;
+
+    std::size_t size() const;
+
+    // Helpers for building fingerprints.
+    static long long modifiedTimeOf(const std::filesystem::path& filePath);
+    static std::uint64_t hashFileContents(const std::filesystem::path& filePath);
+
+    // 64-bit FNV-1a of a buffer already in memory; `hash` continues the
+    // result of a previous call over the preceding bytes.
+    static std::uint64_t hashBytes(const char* data, std::size_t size,
+                                   std::uint64_t hash = 14695981039346656037ULL);
+
+private:
+    void addToTotals(const CachedFileEntry& entry);
+    void subtractFromTotals(const CachedFileEntry& entry);
+
+    std::string cacheFile_;
+    std::map<std::string, CachedFileEntry> entries_;
+    std::map<std::string, std::size_t> totals_;
+};
+
+#endif // INCREMENTALCACHE_H
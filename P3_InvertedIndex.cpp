@@ -0,0 +1,370 @@
+#include "P3_InvertedIndex.h"
+#include "P3_Varint.h"
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char kIndexMagic[8] = { 'M', 'R', 'I', 'N', 'D', 'E', 'X', '1' };
+
+struct IndexHeader {
+    char magic[8];
+    std::uint64_t docCount;
+    std::uint64_t termCount;
+    std::uint64_t docTableOffset;
+    std::uint64_t termTableOffset;
+    std::uint64_t namesOffset;
+    std::uint64_t namesSize;
+    std::uint64_t postingsOffset;
+    std::uint64_t postingsSize;
+};
+static_assert(sizeof(IndexHeader) == 72, "IndexHeader must not contain padding");
+
+const std::size_t kDocEntrySize = 16;
+const std::size_t kTermEntrySize = 32;
+
+template <typename T>
+T readAt(const unsigned char* base, std::size_t offset) {
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void append(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+void InvertedIndexWriter::encodePostings(const std::vector<DocPostings>& docs, std::string& out) {
+    appendVarint(out, docs.size());
+    std::uint32_t previousDoc = 0;
+    for (const auto& doc : docs) {
+        appendVarint(out, doc.docId - previousDoc);
+        previousDoc = doc.docId;
+    }
+
+    std::string lineBlock;
+    for (const auto& doc : docs) {
+        appendVarint(lineBlock, doc.lines.size());
+        std::uint32_t previousLine = 0;
+        for (std::uint32_t line : doc.lines) {
+            appendVarint(lineBlock, line - previousLine);
+            previousLine = line;
+        }
+    }
+    appendVarint(out, lineBlock.size());
+    out += lineBlock;
+}
+
+bool InvertedIndexWriter::write(const std::string& path,
+                                const std::vector<std::string>& documents,
+                                const std::vector<EncodedTerm>& terms) {
+    std::string docTable;
+    std::string termTable;
+    std::string names;
+    std::string postings;
+
+    for (const auto& doc : documents) {
+        append<std::uint64_t>(docTable, names.size());
+        append<std::uint32_t>(docTable, static_cast<std::uint32_t>(doc.size()));
+        append<std::uint32_t>(docTable, 0);
+        names += doc;
+    }
+
+    for (const auto& term : terms) {
+        append<std::uint64_t>(termTable, names.size());
+        append<std::uint32_t>(termTable, static_cast<std::uint32_t>(term.term.size()));
+        append<std::uint32_t>(termTable, term.docFreq);
+        append<std::uint64_t>(termTable, postings.size());
+        append<std::uint64_t>(termTable, term.postings.size());
+        names += term.term;
+        postings += term.postings;
+    }
+
+    IndexHeader header{};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.docCount = documents.size();
+    header.termCount = terms.size();
+    header.docTableOffset = sizeof(IndexHeader);
+    header.termTableOffset = header.docTableOffset + docTable.size();
+    header.namesOffset = header.termTableOffset + termTable.size();
+    header.namesSize = names.size();
+    header.postingsOffset = header.namesOffset + names.size();
+    header.postingsSize = postings.size();
+
+    AtomicOutputFile out;
+    if (!out.open(path)) {
+        return false;
+    }
+    bool ok = out.append(reinterpret_cast<const char*>(&header), sizeof(header)) &&
+              out.append(docTable.data(), docTable.size()) &&
+              out.append(termTable.data(), termTable.size()) &&
+              out.append(names.data(), names.size()) &&
+              out.append(postings.data(), postings.size());
+    if (!ok) {
+        std::cerr << "Failed to write index: " << path << "\n";
+        return false;
+    }
+    return out.commit();
+}
+
+bool InvertedIndex::open(const std::string& path) {
+    if (!file_.open(path) || file_.size() < sizeof(IndexHeader)) {
+        return false;
+    }
+
+    IndexHeader header = readAt<IndexHeader>(file_.data(), 0);
+    if (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+        header.docTableOffset + header.docCount * kDocEntrySize > file_.size() ||
+        header.termTableOffset + header.termCount * kTermEntrySize > file_.size() ||
+        header.namesOffset + header.namesSize > file_.size() ||
+        header.postingsOffset + header.postingsSize > file_.size()) {
+        file_.close();
+        return false;
+    }
+
+    docCount_ = static_cast<std::size_t>(header.docCount);
+    termCount_ = static_cast<std::size_t>(header.termCount);
+    docTable_ = file_.data() + header.docTableOffset;
+    termTable_ = file_.data() + header.termTableOffset;
+    names_ = file_.data() + header.namesOffset;
+    namesSize_ = static_cast<std::size_t>(header.namesSize);
+    postings_ = file_.data() + header.postingsOffset;
+    postingsSize_ = static_cast<std::size_t>(header.postingsSize);
+    return true;
+}
+
+std::size_t InvertedIndex::documentCount() const {
+    return docCount_;
+}
+
+std::size_t InvertedIndex::termCount() const {
+    return termCount_;
+}
+
+std::string_view InvertedIndex::nameAt(std::uint64_t offset, std::uint32_t length) const {
+    if (offset + length > namesSize_) {
+        return {};
+    }
+    return std::string_view(reinterpret_cast<const char*>(names_ + offset), length);
+}
+
+std::string_view InvertedIndex::documentPath(std::uint32_t docId) const {
+    if (docId >= docCount_) {
+        return {};
+    }
+    std::size_t base = docId * kDocEntrySize;
+    return nameAt(readAt<std::uint64_t>(docTable_, base),
+                  readAt<std::uint32_t>(docTable_, base + 8));
+}
+
+bool InvertedIndex::findTerm(std::string_view term, TermEntry& entry) const {
+    std::size_t low = 0;
+    std::size_t high = termCount_;
+    while (low < high) {
+        std::size_t mid = low + (high - low) / 2;
+        std::size_t base = mid * kTermEntrySize;
+        std::string_view name = nameAt(readAt<std::uint64_t>(termTable_, base),
+                                       readAt<std::uint32_t>(termTable_, base + 8));
+        if (name < term) {
+            low = mid + 1;
+        } else if (term < name) {
+            high = mid;
+        } else {
+            entry.nameOffset = readAt<std::uint64_t>(termTable_, base);
+            entry.nameLength = readAt<std::uint32_t>(termTable_, base + 8);
+            entry.docFreq = readAt<std::uint32_t>(termTable_, base + 12);
+            entry.postingsOffset = readAt<std::uint64_t>(termTable_, base + 16);
+            entry.postingsLength = readAt<std::uint64_t>(termTable_, base + 24);
+            return entry.postingsOffset + entry.postingsLength <= postingsSize_;
+        }
+    }
+    return false;
+}
+
+std::vector<std::uint32_t> InvertedIndex::documents(std::string_view term) const {
+    std::vector<std::uint32_t> docs;
+    TermEntry entry;
+    if (!findTerm(term, entry)) {
+        return docs;
+    }
+
+    const unsigned char* cursor = postings_ + entry.postingsOffset;
+    const unsigned char* end = cursor + entry.postingsLength;
+    std::uint64_t count = 0;
+    if (!readVarint(cursor, end, count)) {
+        return docs;
+    }
+
+    docs.reserve(static_cast<std::size_t>(count));
+    std::uint64_t docId = 0;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        std::uint64_t delta = 0;
+        if (!readVarint(cursor, end, delta)) {
+            break;
+        }
+        docId += delta;
+        docs.push_back(static_cast<std::uint32_t>(docId));
+    }
+    return docs;
+}
+
+std::vector<std::uint32_t> InvertedIndex::lines(std::string_view term, std::uint32_t docId) const {
+    std::vector<std::uint32_t> result;
+    TermEntry entry;
+    if (!findTerm(term, entry)) {
+        return result;
+    }
+
+    const unsigned char* cursor = postings_ + entry.postingsOffset;
+    const unsigned char* end = cursor + entry.postingsLength;
+    std::uint64_t count = 0;
+    if (!readVarint(cursor, end, count)) {
+        return result;
+    }
+
+    // Find the position of docId in the doc block.
+    std::uint64_t current = 0;
+    std::uint64_t position = count;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        std::uint64_t delta = 0;
+        if (!readVarint(cursor, end, delta)) {
+            return result;
+        }
+        current += delta;
+        if (current == docId) {
+            position = i;
+        }
+    }
+    if (position == count) {
+        return result;
+    }
+
+    std::uint64_t lineBlockSize = 0;
+    if (!readVarint(cursor, end, lineBlockSize)) {
+        return result;
+    }
+
+    for (std::uint64_t i = 0; i <= position; ++i) {
+        std::uint64_t lineCount = 0;
+        if (!readVarint(cursor, end, lineCount)) {
+            return {};
+        }
+        std::uint64_t line = 0;
+        for (std::uint64_t j = 0; j < lineCount; ++j) {
+            std::uint64_t delta = 0;
+            if (!readVarint(cursor, end, delta)) {
+                return {};
+            }
+            line += delta;
+            if (i == position) {
+                result.push_back(static_cast<std::uint32_t>(line));
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<std::uint32_t> InvertedIndex::intersect(const std::vector<std::uint32_t>& a,
+                                                    const std::vector<std::uint32_t>& b) {
+    const std::vector<std::uint32_t>& small = a.size() <= b.size() ? a : b;
+    const std::vector<std::uint32_t>& large = a.size() <= b.size() ? b : a;
+
+    std::vector<std::uint32_t> result;
+    if (small.empty()) {
+        return result;
+    }
+    result.reserve(small.size());
+
+    // Very skewed sizes: binary-search each probe in the remaining suffix.
+    if (large.size() / small.size() >= 32) {
+        auto from = large.begin();
+        for (std::uint32_t value : small) {
+            from = std::lower_bound(from, large.end(), value);
+            if (from == large.end()) {
+                break;
+            }
+            if (*from == value) {
+                result.push_back(value);
+            }
+        }
+        return result;
+    }
+
+    const std::size_t kBlock = 8;
+    const std::uint32_t* probe = small.data();
+    const std::uint32_t* probeEnd = probe + small.size();
+    const std::uint32_t* cand = large.data();
+    const std::uint32_t* candEnd = cand + large.size();
+
+    while (probe < probeEnd && cand + kBlock <= candEnd) {
+        std::uint32_t value = *probe;
+        // Number of candidates below value in this block; no branches, so
+        // the loop compiles to a vector compare + horizontal add.
+        std::size_t below = 0;
+        for (std::size_t k = 0; k < kBlock; ++k) {
+            below += cand[k] < value ? 1 : 0;
+        }
+        if (below == kBlock) {
+            cand += kBlock;
+            continue;
+        }
+        cand += below;
+        if (*cand == value) {
+            result.push_back(value);
+            ++cand;
+        }
+        ++probe;
+    }
+
+    while (probe < probeEnd && cand < candEnd) {
+        if (*cand < *probe) {
+            ++cand;
+        } else if (*probe < *cand) {
+            ++probe;
+        } else {
+            result.push_back(*probe);
+            ++probe;
+            ++cand;
+        }
+    }
+    return result;
+}
+
+std::vector<std::uint32_t> InvertedIndex::unite(const std::vector<std::uint32_t>& a,
+                                                const std::vector<std::uint32_t>& b) {
+    std::vector<std::uint32_t> result;
+    result.reserve(a.size() + b.size());
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+bool InvertedIndex::query(const std::vector<std::string>& expression,
+                          std::vector<std::uint32_t>& result,
+                          std::string& error) const {
+    if (expression.empty() || expression.size() % 2 == 0) {
+        error = "expected: term [AND|OR term ...]";
+        return false;
+    }
+
+    result = documents(expression[0]);
+    for (std::size_t i = 1; i + 1 < expression.size(); i += 2) {
+        const std::string& op = expression[i];
+        std::vector<std::uint32_t> next = documents(expression[i + 1]);
+        if (op == "AND" || op == "and") {
+            result = intersect(result, next);
+        } else if (op == "OR" || op == "or") {
+            result = unite(result, next);
+        } else {
+            error = "unknown operator: " + op;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,104 @@
+#ifndef INVERTEDINDEX_H
+#define INVERTEDINDEX_H
+
+#include "P3_MappedFile.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Postings of one term in one document: 1-based line numbers, ascending.
+struct DocPostings {
+    std::uint32_t docId = 0;
+    std::vector<std::uint32_t> lines;
+};
+
+// A term and its compressed posting list (see InvertedIndexWriter).
+struct EncodedTerm {
+    std::string term;
+    std::uint32_t docFreq = 0;
+    std::string postings;
+};
+
+// Inverted index file.
+//
+// Layout (little-endian, offsets from the start of the file):
+//   header       IndexHeader
+//   doc table    per document: [u64 name offset][u32 name length][u32 reserved]
+//   term table   per term, sorted by term:
+//                [u64 name offset][u32 name length][u32 doc freq]
+//                [u64 postings offset][u64 postings length]
+//   names        document paths and term text
+//   postings     per term: doc-ID block then line block, both delta + varint:
+//                  varint docFreq, varint docId deltas...,
+//                  varint line-block bytes, per doc: varint count, line deltas...
+//
+// Keeping the doc IDs in their own block lets queries decode and intersect
+// them without touching line data.
+class InvertedIndexWriter {
+public:
+    // `terms` must be sorted by term.
+    static bool write(const std::string& path,
+                      const std::vector<std::string>& documents,
+                      const std::vector<EncodedTerm>& terms);
+
+    // Encode one posting list in the format above; `docs` must be ordered
+    // by docId. Reducers call this in parallel, one partition each.
+    static void encodePostings(const std::vector<DocPostings>& docs, std::string& out);
+};
+
+class InvertedIndex {
+public:
+    bool open(const std::string& path);
+
+    std::size_t documentCount() const;
+    std::size_t termCount() const;
+    std::string_view documentPath(std::uint32_t docId) const;
+
+    // Ascending document IDs containing `term` (empty if absent).
+    std::vector<std::uint32_t> documents(std::string_view term) const;
+
+    // Line numbers of `term` in `docId` (empty if absent).
+    std::vector<std::uint32_t> lines(std::string_view term, std::uint32_t docId) const;
+
+    // Evaluate "t1 OP t2 OP t3 ..." left to right, OP being AND or OR.
+    // Returns false (with an error message) if the expression is malformed.
+    bool query(const std::vector<std::string>& expression,
+               std::vector<std::uint32_t>& result,
+               std::string& error) const;
+
+    // Sorted-list set operations used by query(). intersect() compares each
+    // probe against a block of eight candidates at a time with branch-free
+    // counting, which compilers vectorize, and gallops when one list is much
+    // shorter than the other.
+    static std::vector<std::uint32_t> intersect(const std::vector<std::uint32_t>& a,
+                                                const std::vector<std::uint32_t>& b);
+    static std::vector<std::uint32_t> unite(const std::vector<std::uint32_t>& a,
+                                            const std::vector<std::uint32_t>& b);
+
+private:
+    struct TermEntry {
+        std::uint64_t nameOffset;
+        std::uint32_t nameLength;
+        std::uint32_t docFreq;
+        std::uint64_t postingsOffset;
+        std::uint64_t postingsLength;
+    };
+
+    bool findTerm(std::string_view term, TermEntry& entry) const;
+    std::string_view nameAt(std::uint64_t offset, std::uint32_t length) const;
+
+    MappedFile file_;
+    std::size_t docCount_ = 0;
+    std::size_t termCount_ = 0;
+    const unsigned char* docTable_ = nullptr;
+    const unsigned char* termTable_ = nullptr;
+    const unsigned char* names_ = nullptr;
+    const unsigned char* postings_ = nullptr;
+    std::size_t namesSize_ = 0;
+    std::size_t postingsSize_ = 0;
+};
+
+#endif // INVERTEDINDEX_H
@@ -0,0 +1,698 @@
+#include "P3_JobDag.h"
+#include "P3_FileManager.h"
+#include "P3_Logger.h"
+#include "P3_Mapper.h"
+#include "P3_MemoryBudget.h"
+#include "P3_Reducer.h"
+#include "P3_SpillFile.h"
+#include "P3_SymbolTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+const std::size_t kWholeStage = static_cast<std::size_t>(-1);
+
+// Sorts by ID and sums counts of equal IDs.
+void sortAndCombine(std::vector<IdCount>& rows) {
+    std::sort(rows.begin(), rows.end());
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        if (out > 0 && rows[out - 1].first == rows[i].first) {
+            rows[out - 1].second += rows[i].second;
+        } else {
+            rows[out++] = rows[i];
+        }
+    }
+    rows.resize(out);
+}
+
+bool parseCount(const std::string& text, std::size_t& value) {
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+    auto parsed = std::from_chars(first, last, value);
+    return parsed.ec == std::errc() && parsed.ptr == last;
+}
+
+} // namespace
+
+JobDag::StageId JobDag::add(Stage stage) {
+    if (stage.name.empty()) {
+        stage.name = std::string(kindName(stage.kind)) + "#" + std::to_string(stages_.size());
+    }
+    stages_.push_back(std::move(stage));
+    return stages_.size() - 1;
+}
+
+JobDag::StageId JobDag::count(const std::string& path) {
+    return add({ Kind::Count, "", {}, path });
+}
+
+JobDag::StageId JobDag::load(const std::string& path) {
+    return add({ Kind::Load, "", {}, path });
+}
+
+JobDag::StageId JobDag::filter(StageId input, std::size_t min, std::size_t max) {
+    return add({ Kind::Filter, "", { input }, "", min, max });
+}
+
+JobDag::StageId JobDag::join(StageId left, StageId right) {
+    return add({ Kind::Join, "", { left, right }, "" });
+}
+
+JobDag::StageId JobDag::exclude(StageId left, StageId right) {
+    return add({ Kind::Exclude, "", { left, right }, "" });
+}
+
+JobDag::StageId JobDag::broadcastJoin(StageId left, StageId right) {
+    return add({ Kind::Broadcast, "", { left, right }, "" });
+}
+
+JobDag::StageId JobDag::top(StageId input, std::size_t k) {
+    return add({ Kind::Top, "", { input }, "", k });
+}
+
+void JobDag::write(StageId input, const std::string& path) {
+    add({ Kind::Write, "", { input }, path });
+}
+
+bool JobDag::empty() const {
+    return stages_.empty();
+}
+
+std::vector<std::string> JobDag::outputs() const {
+    std::vector<std::string> paths;
+    for (const Stage& stage : stages_) {
+        if (stage.kind == Kind::Write) {
+            paths.push_back(stage.path);
+        }
+    }
+    return paths;
+}
+
+bool JobDag::isRowWise(Kind kind) {
+    return kind == Kind::Filter || kind == Kind::Join || kind == Kind::Exclude ||
+           kind == Kind::Broadcast;
+}
+
+const char* JobDag::kindName(Kind kind) {
+    switch (kind) {
+    case Kind::Count:   return "count";
+    case Kind::Load:    return "load";
+    case Kind::Filter:  return "filter";
+    case Kind::Join:    return "join";
+    case Kind::Exclude: return "exclude";
+    case Kind::Broadcast: return "broadcast";
+    case Kind::Top:     return "top";
+    case Kind::Write:   return "write";
+    }
+    return "?";
+}
+
+bool JobDag::parse(const std::string& configFile) {
+    std::ifstream in(configFile);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open DAG config: " << configFile << "\n";
+        return false;
+    }
+
+    std::map<std::string, StageId> names;
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        std::string where = configFile + ":" + std::to_string(lineNumber) + ": ";
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream tokens(line);
+        std::vector<std::string> words;
+        for (std::string word; tokens >> word;) {
+            words.push_back(word);
+        }
+        if (words.empty()) {
+            continue;
+        }
+
+        auto stageNamed = [&](const std::string& name, StageId& id) {
+            auto it = names.find(name);
+            if (it == names.end()) {
+                std::cerr << where << "unknown stage '" << name << "'\n";
+                return false;
+            }
+            id = it->second;
+            return true;
+        };
+
+        if (words[0] == "write") {
+            StageId input;
+            if (words.size() != 3) {
+                std::cerr << where << "expected: write <stage> <path>\n";
+                return false;
+            }
+            if (!stageNamed(words[1], input)) {
+                return false;
+            }
+            write(input, words[2]);
+            continue;
+        }
+
+        if (words.size() < 3 || words[1] != "=") {
+            std::cerr << where << "expected: <name> = <kind> args... or write <stage> <path>\n";
+            return false;
+        }
+        if (names.count(words[0])) {
+            std::cerr << where << "stage '" << words[0] << "' is defined twice\n";
+            return false;
+        }
+
+        const std::string& kind = words[2];
+        const std::size_t args = words.size() - 3;
+        StageId id = 0, other = 0;
+        std::size_t a = 0, b = 0;
+        if (kind == "count" && args <= 1) {
+            id = count(args == 1 ? words[3] : "");
+        } else if (kind == "load" && args == 1) {
+            id = load(words[3]);
+        } else if (kind == "filter" && (args == 2 || args == 3)) {
+            if (!stageNamed(words[3], other)) {
+                return false;
+            }
+            if (!parseCount(words[4], a) || (args == 3 && !parseCount(words[5], b))) {
+                std::cerr << where << "filter bounds must be numbers\n";
+                return false;
+            }
+            id = filter(other, a, b);
+        } else if ((kind == "join" || kind == "exclude" || kind == "broadcast") && args == 2) {
+            StageId right;
+            if (!stageNamed(words[3], other) || !stageNamed(words[4], right)) {
+                return false;
+            }
+            id = kind == "join" ? join(other, right)
+               : kind == "exclude" ? exclude(other, right)
+               : broadcastJoin(other, right);
+        } else if (kind == "top" && args == 2) {
+            if (!stageNamed(words[3], other)) {
+                return false;
+            }
+            if (!parseCount(words[4], a) || a == 0) {
+                std::cerr << where << "top needs a positive count\n";
+                return false;
+            }
+            id = top(other, a);
+        } else {
+            std::cerr << where << "unknown stage kind or wrong arguments: " << kind << "\n";
+            return false;
+        }
+        stages_[id].name = words[0];
+        names[words[0]] = id;
+    }
+    return true;
+}
+
+namespace {
+
+// Rows of one partition of a stage's output. Rows are sorted by ID.
+struct Partition {
+    std::vector<IdCount> rows;
+    std::string spillPath;  // set when the rows were spilled
+    std::size_t reserved = 0;
+    unsigned int readers = 0;  // consumer tasks that have not read it yet
+};
+
+} // namespace
+
+bool JobDag::run(FileManager& fileManager, const DagRunOptions& options, Logger& logger) const {
+    const std::size_t stageCount = stages_.size();
+    const unsigned int partitions = std::max(1u, options.workers);
+
+    bool hasWrite = false;
+    for (StageId s = 0; s < stageCount; ++s) {
+        const Stage& stage = stages_[s];
+        hasWrite = hasWrite || stage.kind == Kind::Write;
+        // Inputs always precede their consumers, which keeps the graph acyclic.
+        for (StageId input : stage.inputs) {
+            if (input >= s || stages_[input].kind == Kind::Write) {
+                std::cerr << "Stage " << stage.name << " has an invalid input\n";
+                return false;
+            }
+        }
+    }
+    if (!hasWrite) {
+        std::cerr << "The DAG writes nothing; add a write stage\n";
+        return false;
+    }
+
+    // Tasks: one per partition for row-wise stages, one for the others.
+    std::vector<std::size_t> firstTask(stageCount);
+    std::vector<std::pair<StageId, std::size_t>> tasks;
+    // (consumer, input position) for every use of a stage's output.
+    std::vector<std::vector<std::pair<StageId, std::size_t>>> consumers(stageCount);
+    std::vector<bool> ranked(stageCount, false);
+    for (StageId s = 0; s < stageCount; ++s) {
+        const Stage& stage = stages_[s];
+        firstTask[s] = tasks.size();
+        if (isRowWise(stage.kind)) {
+            for (unsigned int p = 0; p < partitions; ++p) {
+                tasks.emplace_back(s, p);
+            }
+            ranked[s] = ranked[stage.inputs.front()];
+        } else {
+            tasks.emplace_back(s, kWholeStage);
+            ranked[s] = stage.kind == Kind::Top;
+        }
+        for (std::size_t k = 0; k < stage.inputs.size(); ++k) {
+            consumers[stage.inputs[k]].emplace_back(s, k);
+        }
+    }
+    auto taskCount = [&](StageId s) -> std::size_t {
+        return isRowWise(stages_[s].kind) ? partitions : 1;
+    };
+    // True if every task of `consumer` needs all of its input at position k:
+    // non-row-wise stages, and the broadcast side of a broadcast join.
+    auto readsWhole = [&](StageId consumer, std::size_t k) {
+        return !isRowWise(stages_[consumer].kind) || (stages_[consumer].kind == Kind::Broadcast && k == 1);
+    };
+
+    // Dependencies still unfinished per task, and readers per partition.
+    std::vector<std::size_t> pending(tasks.size(), 0);
+    std::vector<std::vector<Partition>> outputs(stageCount);
+    for (StageId s = 0; s < stageCount; ++s) {
+        const Stage& stage = stages_[s];
+        for (std::size_t k = 0; k < stage.inputs.size(); ++k) {
+            for (std::size_t t = 0; t < taskCount(s); ++t) {
+                pending[firstTask[s] + t] += readsWhole(s, k) ? taskCount(stage.inputs[k]) : 1;
+            }
+        }
+        outputs[s].resize(stage.kind == Kind::Write ? 0 : partitions);
+    }
+    // Each consumer reads every partition once (row-wise ones one per task).
+    for (StageId s = 0; s < stageCount; ++s) {
+        for (auto& part : outputs[s]) {
+            part.readers = static_cast<unsigned int>(consumers[s].size());
+        }
+    }
+
+    SymbolTable symbols;
+    Mapper mapper;
+    MemoryBudget budget(options.memoryLimit);
+    std::filesystem::path spillDir = options.spillDir;
+    bool createdSpillDir = false;  // removed again at the end if left empty
+    if (budget.limited()) {
+        std::error_code ec;
+        createdSpillDir = !std::filesystem::exists(spillDir, ec);
+        fileManager.ensureDirectory(spillDir);
+    }
+    std::mutex stateMutex;  // guards outputs' bookkeeping, pending and the ready list
+    std::atomic<unsigned int> spillCount{ 0 };
+    std::atomic<bool> readFailed{ false };
+
+    // Keep a finished partition in memory if the budget allows, else spill.
+    auto store = [&](StageId s, unsigned int p, std::vector<IdCount> rows) {
+        Partition& part = outputs[s][p];
+        if (part.readers == 0) {
+            return;
+        }
+        const std::size_t bytes = rows.size() * sizeof(IdCount);
+        if (!budget.limited() || budget.tryReserve(bytes)) {
+            part.reserved = budget.limited() ? bytes : 0;
+            part.rows = std::move(rows);
+            return;
+        }
+        std::string path = (spillDir / ("dag-" + std::to_string(spillCount++) + "-" +
+                                        std::to_string(s) + "-p" + std::to_string(p) + ".run")).string();
+        if (SpillWriter::write(path, rows, options.spillCodec)) {
+            part.spillPath = path;
+            logger.log("DAG: spilled " + stages_[s].name + " partition " + std::to_string(p) + " (" +
+                       std::to_string(bytes / 1024) + " KiB)");
+        } else {
+            budget.forceReserve(bytes);
+            part.reserved = bytes;
+            part.rows = std::move(rows);
+        }
+    };
+
+    // Rows of an input partition: in place, or read back into `scratch`.
+    auto fetch = [&](StageId s, unsigned int p, std::vector<IdCount>& scratch) -> const std::vector<IdCount>& {
+        const Partition& part = outputs[s][p];
+        if (part.spillPath.empty()) {
+            return part.rows;
+        }
+        scratch.clear();
+        SpillReader reader;
+        IdCount record;
+        if (reader.open(part.spillPath)) {
+            while (reader.next(record)) {
+                scratch.push_back(record);
+            }
+        }
+        if (reader.failed()) {
+            // Fails the task that asked, instead of passing on partial rows.
+            readFailed = true;
+        }
+        return scratch;
+    };
+
+    // A consumer is done with a partition; the last one frees it.
+    auto done = [&](StageId s, unsigned int p) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        Partition& part = outputs[s][p];
+        if (part.readers > 0 && --part.readers == 0) {
+            std::vector<IdCount>().swap(part.rows);
+            budget.release(part.reserved);
+            part.reserved = 0;
+            if (!part.spillPath.empty()) {
+                std::error_code ec;
+                std::filesystem::remove(part.spillPath, ec);
+            }
+        }
+    };
+
+    // Ranked order: higher count first, then by word.
+    auto ranksBefore = [&](const IdCount& a, const IdCount& b) {
+        if (a.second != b.second) {
+            return a.second > b.second;
+        }
+        return symbols.textLocked(a.first) < symbols.textLocked(b.first);
+    };
+
+    // Splits rows by partition, sorting each by ID, and stores them.
+    auto distribute = [&](StageId s, std::vector<IdCount>& rows) {
+        std::vector<std::vector<IdCount>> split(partitions);
+        for (const auto& row : rows) {
+            split[Reducer::partitionOf(row.first, partitions)].push_back(row);
+        }
+        std::vector<IdCount>().swap(rows);
+        for (unsigned int p = 0; p < partitions; ++p) {
+            sortAndCombine(split[p]);
+            store(s, p, std::move(split[p]));
+        }
+    };
+
+    auto runCount = [&](StageId s) -> bool {
+        const Stage& stage = stages_[s];
+        FileManager inputs(stage.path.empty() ? options.inputPath : stage.path);
+        inputs.setDiscoveryOptions(fileManager.discoveryOptions());
+        std::vector<std::filesystem::path> files = stage.path.empty() && options.inputListed
+            ? options.inputFiles
+            : inputs.listTextFiles(partitions);
+        if (files.empty()) {
+            logger.log("DAG: no input files for " + stage.name);
+            return false;
+        }
+
+        std::vector<PartitionedCounts> mapped(partitions);
+        std::atomic<std::size_t> next{ 0 };
+        auto worker = [&](unsigned int workerId) {
+            SymbolCache cache(symbols);
+            std::pmr::unordered_map<std::uint32_t, std::size_t> counts;
+            std::vector<char> data;
+            for (std::size_t i = next++; i < files.size(); i = next++) {
+                if (!inputs.readContents(files[i], data)) {
+                    continue;
+                }
+                mapper.forEachWord(std::string_view(data.data(), data.size()), [&](const std::string& word) {
+                    ++counts[cache.intern(word)];
+                });
+            }
+            mapped[workerId] = Reducer::partition(counts, partitions);
+        };
+        std::vector<std::thread> threads;
+        for (unsigned int i = 0; i < partitions; ++i) {
+            threads.emplace_back(worker, i);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        for (unsigned int p = 0; p < partitions; ++p) {
+            std::vector<IdCount> rows;
+            for (auto& worker : mapped) {
+                rows.insert(rows.end(), worker[p].begin(), worker[p].end());
+                std::vector<IdCount>().swap(worker[p]);
+            }
+            sortAndCombine(rows);
+            store(s, p, std::move(rows));
+        }
+        logger.log("DAG: " + stage.name + " counted " + std::to_string(files.size()) + " file(s)");
+        return true;
+    };
+
+    auto runLoad = [&](StageId s) -> bool {
+        const Stage& stage = stages_[s];
+        if (!std::filesystem::exists(stage.path)) {
+            logger.log("DAG: cannot open " + stage.path + " for " + stage.name);
+            return false;
+        }
+        SymbolCache cache(symbols);
+        std::vector<IdCount> rows;
+        for (const std::string& line : fileManager.readAllLines(stage.path)) {
+            // "word,count" or just "word"; words are normalized like input.
+            std::size_t comma = line.rfind(',');
+            std::size_t value = 1;
+            std::string word = line;
+            if (comma != std::string::npos && parseCount(line.substr(comma + 1), value)) {
+                word = line.substr(0, comma);
+            } else {
+                value = 1;  // from_chars may have stored a prefix
+            }
+            mapper.forEachWord(word, [&](const std::string& token) {
+                rows.emplace_back(cache.intern(token), value);
+            });
+        }
+        distribute(s, rows);
+        return true;
+    };
+
+    // Broadcast joins: the whole right side as one flat, sorted ID table,
+    // built by the first task that needs it and then shared read-only.
+    std::vector<std::vector<std::uint32_t>> broadcastIds(stageCount);
+    std::vector<std::once_flag> broadcastBuilt(stageCount);
+    auto buildBroadcast = [&](StageId s) {
+        const StageId right = stages_[s].inputs[1];
+        std::vector<std::uint32_t>& ids = broadcastIds[s];
+        std::vector<IdCount> scratch;
+        for (unsigned int q = 0; q < partitions; ++q) {
+            for (const auto& row : fetch(right, q, scratch)) {
+                ids.push_back(row.first);
+            }
+            done(right, q);
+        }
+        std::sort(ids.begin(), ids.end());
+    };
+
+    auto runRowWise = [&](StageId s, unsigned int p) -> bool {
+        const Stage& stage = stages_[s];
+        std::vector<IdCount> scratchLeft, scratchRight, rows;
+        const std::vector<IdCount>& left = fetch(stage.inputs[0], p, scratchLeft);
+        if (stage.kind == Kind::Broadcast) {
+            std::call_once(broadcastBuilt[s], buildBroadcast, s);
+            const std::vector<std::uint32_t>& ids = broadcastIds[s];
+            for (const auto& row : left) {
+                if (std::binary_search(ids.begin(), ids.end(), row.first)) {
+                    rows.push_back(row);
+                }
+            }
+        } else if (stage.kind == Kind::Filter) {
+            for (const auto& row : left) {
+                if (row.second >= stage.a && (stage.b == 0 || row.second <= stage.b)) {
+                    rows.push_back(row);
+                }
+            }
+        } else {
+            // Sort-merge join: both sides are partitioned alike and sorted
+            // by ID, so partition p only meets partition p in one pass.
+            const std::vector<IdCount>& right = fetch(stage.inputs[1], p, scratchRight);
+            const bool keepMatches = stage.kind == Kind::Join;
+            std::size_t j = 0;
+            for (const auto& row : left) {
+                while (j < right.size() && right[j].first < row.first) {
+                    ++j;
+                }
+                bool matched = j < right.size() && right[j].first == row.first;
+                if (matched == keepMatches) {
+                    rows.push_back(row);
+                }
+            }
+        }
+        store(s, p, std::move(rows));
+        return true;
+    };
+
+    // Every partition of the (single) input, concatenated.
+    auto gather = [&](StageId s) {
+        std::vector<IdCount> all, scratch;
+        for (unsigned int p = 0; p < partitions; ++p) {
+            const std::vector<IdCount>& rows = fetch(s, p, scratch);
+            all.insert(all.end(), rows.begin(), rows.end());
+        }
+        return all;
+    };
+
+    auto runTop = [&](StageId s) -> bool {
+        const Stage& stage = stages_[s];
+        std::vector<IdCount> rows = gather(stage.inputs[0]);
+        if (rows.size() > stage.a) {
+            std::partial_sort(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(stage.a),
+                              rows.end(), ranksBefore);
+            rows.resize(stage.a);
+        }
+        distribute(s, rows);
+        return true;
+    };
+
+    auto runWrite = [&](StageId s) -> bool {
+        const Stage& stage = stages_[s];
+        const StageId input = stage.inputs[0];
+        std::vector<IdCount> rows = gather(input);
+        if (ranked[input]) {
+            std::sort(rows.begin(), rows.end(), ranksBefore);
+        }
+        std::vector<std::pair<std::string, std::size_t>> text;
+        text.reserve(rows.size());
+        for (const auto& row : rows) {
+            text.emplace_back(std::string(symbols.textLocked(row.first)), row.second);
+        }
+        if (!ranked[input]) {
+            std::sort(text.begin(), text.end());
+        }
+        fileManager.ensureDirectory(std::filesystem::path(stage.path).parent_path());
+        if (!fileManager.writeWordCounts(stage.path, text, options.outputCodec)) {
+            return false;
+        }
+        logger.log("DAG: wrote " + std::to_string(text.size()) + " rows of " +
+                   stages_[input].name + " to " + stage.path);
+        return true;
+    };
+
+    // Scheduler: a task runs as soon as everything it reads is finished, so
+    // row-wise stages pipeline partition by partition behind their inputs.
+    std::vector<std::size_t> ready;
+    for (std::size_t t = 0; t < tasks.size(); ++t) {
+        if (pending[t] == 0) {
+            ready.push_back(t);
+        }
+    }
+    std::condition_variable wake;
+    std::size_t finished = 0;
+    bool failed = false;
+
+    auto complete = [&](std::size_t t) {
+        // Called with stateMutex held.
+        const StageId s = tasks[t].first;
+        const std::size_t p = tasks[t].second;
+        auto release = [&](std::size_t task) {
+            if (--pending[task] == 0) {
+                ready.push_back(task);
+            }
+        };
+        for (const auto& use : consumers[s]) {
+            const StageId consumer = use.first;
+            if (!isRowWise(stages_[consumer].kind)) {
+                release(firstTask[consumer]);
+            } else if (p != kWholeStage && !readsWhole(consumer, use.second)) {
+                release(firstTask[consumer] + p);
+            } else {
+                for (unsigned int q = 0; q < partitions; ++q) {
+                    release(firstTask[consumer] + q);
+                }
+            }
+        }
+        ++finished;
+    };
+
+    auto executor = [&]() {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        while (true) {
+            wake.wait(lock, [&] { return failed || finished == tasks.size() || !ready.empty(); });
+            if (failed || finished == tasks.size()) {
+                return;
+            }
+            const std::size_t t = ready.back();
+            ready.pop_back();
+            lock.unlock();
+
+            const StageId s = tasks[t].first;
+            const std::size_t p = tasks[t].second;
+            const Stage& stage = stages_[s];
+            bool ok = true;
+            switch (stage.kind) {
+            case Kind::Count:   ok = runCount(s); break;
+            case Kind::Load:    ok = runLoad(s); break;
+            case Kind::Top:     ok = runTop(s); break;
+            case Kind::Write:   ok = runWrite(s); break;
+            default:            ok = runRowWise(s, static_cast<unsigned int>(p)); break;
+            }
+            if (readFailed) {
+                ok = false;
+            }
+
+            // Inputs read by this task can be freed by their last reader.
+            // The broadcast side is released by the task that built its table.
+            for (std::size_t k = 0; k < stage.inputs.size(); ++k) {
+                const StageId input = stage.inputs[k];
+                if (stage.kind == Kind::Broadcast && k == 1) {
+                    continue;
+                }
+                if (p != kWholeStage) {
+                    done(input, static_cast<unsigned int>(p));
+                } else {
+                    for (unsigned int q = 0; q < partitions; ++q) {
+                        done(input, q);
+                    }
+                }
+            }
+
+            lock.lock();
+            if (!ok) {
+                failed = true;
+            } else {
+                complete(t);
+            }
+            wake.notify_all();
+        }
+    };
+
+    logger.log("DAG: " + std::to_string(stageCount) + " stage(s), " + std::to_string(tasks.size()) +
+               " task(s) over " + std::to_string(partitions) + " partition(s)");
+
+    std::vector<std::thread> executors;
+    for (unsigned int i = 0; i < partitions; ++i) {
+        executors.emplace_back(executor);
+    }
+    for (auto& t : executors) {
+        t.join();
+    }
+
+    // Leftovers of a failed run.
+    for (auto& stageOutputs : outputs) {
+        for (auto& part : stageOutputs) {
+            if (!part.spillPath.empty() && part.readers > 0) {
+                std::error_code ec;
+                std::filesystem::remove(part.spillPath, ec);
+            }
+        }
+    }
+
+    if (createdSpillDir) {
+        std::error_code ec;
+        std::filesystem::remove(spillDir, ec);  // fails, harmlessly, unless empty
+    }
+
+    if (spillCount > 0) {
+        logger.log("DAG: " + std::to_string(spillCount.load()) + " partition(s) spilled, peak " +
+                   std::to_string(budget.peak() / 1024) + " KiB in memory");
+    }
+    return !failed;
+}
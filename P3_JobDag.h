@@ -0,0 +1,114 @@
+#ifndef JOBDAG_H
+#define JOBDAG_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+
+#include "P3_FileDiscovery.h"
+#include "P3_Compression.h"
+
+class Logger;
+class FileManager;
+
+// Settings the controller passes to JobDag::run.
+struct DagRunOptions {
+    std::string inputPath;          // default input of "count" stages
+    // Files of inputPath if the caller already listed them (inputListed);
+    // otherwise count stages walk it themselves.
+    std::vector<std::filesystem::path> inputFiles;
+    bool inputListed = false;
+    unsigned int workers = 4;       // threads, and partitions per dataset
+    std::size_t memoryLimit = 0;    // 0 = unlimited
+    std::string spillDir;           // where partitions spill under pressure
+    Codec outputCodec = Codec::None;
+    Codec spillCodec = Codec::None;
+};
+
+// A chain of word-count stages run in one process. Every stage produces a
+// dataset of (word, count) rows split into hash partitions (see
+// Reducer::partitionOf) that stay in memory and feed the next stages
+// directly; nothing is written between stages unless the memory budget is
+// exhausted, in which case a finished partition is spilled as a sorted run
+// (P3_SpillFile.h) and read back by its consumers.
+//
+// Row-wise stages (filter, join, exclude, broadcast) run per partition, so
+// partition p of a downstream stage starts as soon as partition p of its
+// inputs is ready. count, load, top and write need their whole input, as
+// does the right side of a broadcast join.
+//
+// Build with the methods below or parse a config file, one stage per line:
+//
+//     # name = kind args...
+//     counts = count                  # word count over the job input
+//     dict   = load dictionary.csv    # "word[,count]" lines
+//     common = filter counts 5        # count >= 5 (optional max after)
+//     known  = join common dict       # rows of common whose word is in dict
+//     plain  = exclude known stop     # rows of known whose word is not in stop
+//     listed = broadcast counts dict  # like join, with dict as a hash table
+//     best   = top known 100          # 100 most frequent rows
+//     write best out/best.csv
+class JobDag {
+public:
+    using StageId = std::size_t;
+
+    // Word count over `path` (empty: the job input) with the controller's
+    // discovery options.
+    StageId count(const std::string& path = "");
+
+    // Rows from a "word[,count]" file; a missing count is 1.
+    StageId load(const std::string& path);
+
+    // Rows with min <= count (and count <= max unless max is 0).
+    StageId filter(StageId input, std::size_t min, std::size_t max = 0);
+
+    // Rows of `left` whose word is (join) or is not (exclude) in `right`;
+    // counts come from `left`. join is a sort-merge join of matching
+    // partitions of both sides.
+    StageId join(StageId left, StageId right);
+    StageId exclude(StageId left, StageId right);
+
+    // Same result as join() for a small `right` side: it is collected once
+    // into a flat read-only ID table that every partition task of `left`
+    // probes, instead of being merged partition by partition.
+    StageId broadcastJoin(StageId left, StageId right);
+
+    // The k most frequent rows. Downstream output stays ordered by count.
+    StageId top(StageId input, std::size_t k);
+
+    // Write a stage as "word,count" CSV.
+    void write(StageId input, const std::string& path);
+
+    // Parse a config file (format above). Returns false with a message on
+    // stderr naming the offending line.
+    bool parse(const std::string& configFile);
+
+    bool empty() const;
+
+    // Paths of the write stages, in config order.
+    std::vector<std::string> outputs() const;
+
+    bool run(FileManager& fileManager, const DagRunOptions& options, Logger& logger) const;
+
+private:
+    enum class Kind { Count, Load, Filter, Join, Exclude, Broadcast, Top, Write };
+
+    struct Stage {
+        Kind kind;
+        std::string name;
+        std::vector<StageId> inputs;
+        std::string path;
+        std::size_t a = 0;  // filter min, top k
+        std::size_t b = 0;  // filter max
+    };
+
+    StageId add(Stage stage);
+    static bool isRowWise(Kind kind);
+    static const char* kindName(Kind kind);
+
+    std::vector<Stage> stages_;
+};
+
+#endif // JOBDAG_H
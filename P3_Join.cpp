@@ -0,0 +1,510 @@
+#include "P3_Join.h"
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const std::size_t kBlockBytes = 16 * 1024 * 1024;
+const unsigned int kMaxPartitions = 512;  // shuffle files open at once
+
+// A row as a view of its line; the key is the text before the first comma.
+struct Row {
+    std::string_view line;
+    std::size_t keyLength;
+
+    std::string_view key() const { return line.substr(0, keyLength); }
+    std::string_view value() const {
+        return keyLength < line.size() ? line.substr(keyLength + 1) : std::string_view();
+    }
+};
+
+Row makeRow(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    std::size_t comma = line.find(',');
+    return { line, comma == std::string_view::npos ? line.size() : comma };
+}
+
+// Calls fn(row) for every non-empty line of `text`.
+template <typename Fn>
+void forEachRow(std::string_view text, Fn&& fn) {
+    std::size_t start = 0;
+    while (start < text.size()) {
+        std::size_t newline = text.find('\n', start);
+        std::size_t stop = newline == std::string_view::npos ? text.size() : newline;
+        Row row = makeRow(text.substr(start, stop - start));
+        if (!row.line.empty()) {
+            fn(row);
+        }
+        start = stop + 1;
+    }
+}
+
+void appendPair(std::string& out, const Row& left, std::string_view rightValue) {
+    out.append(left.key());
+    out += ',';
+    out.append(left.value());
+    out += ',';
+    out.append(rightValue);
+    out += '\n';
+}
+
+void appendLine(std::string& out, const Row& row) {
+    out.append(row.line);
+    out += '\n';
+}
+
+// Reads a file in line-aligned blocks of about kBlockBytes. Compressed files
+// are decoded whole and returned as one block.
+class LineBlockReader {
+public:
+    bool open(const std::string& path) {
+        in_.open(path, std::ios::binary);
+        if (!in_.is_open()) {
+            std::cerr << "Failed to open join input: " << path << "\n";
+            return false;
+        }
+        char magic[4] = {};
+        in_.read(magic, sizeof(magic));
+        std::size_t got = static_cast<std::size_t>(in_.gcount());
+        in_.clear();
+        in_.seekg(0);
+        if (detectCodec(magic, got) != Codec::None) {
+            std::vector<char> all((std::istreambuf_iterator<char>(in_)), std::istreambuf_iterator<char>());
+            if (!decompressInPlace(all, std::max(1u, std::thread::hardware_concurrency()))) {
+                std::cerr << "Failed to decompress join input: " << path << "\n";
+                return false;
+            }
+            carry_ = std::move(all);
+            whole_ = true;
+        }
+        return true;
+    }
+
+    bool next(std::vector<char>& block) {
+        if (whole_) {
+            block.swap(carry_);
+            carry_.clear();
+            whole_ = false;
+            done_ = true;
+            return !block.empty();
+        }
+        if (done_) {
+            return false;
+        }
+        block.swap(carry_);
+        carry_.clear();
+        // Grow until the block holds at least one whole line.
+        while (true) {
+            std::size_t have = block.size();
+            block.resize(have + kBlockBytes);
+            in_.read(block.data() + have, static_cast<std::streamsize>(kBlockBytes));
+            block.resize(have + static_cast<std::size_t>(in_.gcount()));
+            if (!in_) {
+                done_ = true;
+                return !block.empty();
+            }
+            // Keep the partial last line for the next block. The carried
+            // text has no newline, so any line end is in the new data.
+            std::size_t cut = block.size();
+            while (cut > have && block[cut - 1] != '\n') {
+                --cut;
+            }
+            if (cut > have) {
+                carry_.assign(block.begin() + static_cast<std::ptrdiff_t>(cut), block.end());
+                block.resize(cut);
+                return true;
+            }
+        }
+    }
+
+private:
+    std::ifstream in_;
+    std::vector<char> carry_;
+    bool whole_ = false;
+    bool done_ = false;
+};
+
+// Atomic output file; with a codec every appended chunk is its own gzip
+// member or zstd frame.
+class JoinOutput {
+public:
+    bool open(const std::string& path, Codec codec) {
+        codec_ = codec;
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(parent, ec);
+        }
+        return file_.open(path);
+    }
+
+    bool append(const std::string& text) {
+        if (text.empty()) {
+            return true;
+        }
+        if (codec_ == Codec::None) {
+            return file_.append(text.data(), text.size());
+        }
+        std::vector<char> packed;
+        return compressBuffer(codec_, text.data(), text.size(), packed) &&
+               file_.append(packed.data(), packed.size());
+    }
+
+    bool commit() { return file_.commit(); }
+
+private:
+    AtomicOutputFile file_;
+    Codec codec_ = Codec::None;
+};
+
+std::uint64_t fileSize(const std::string& path) {
+    std::error_code ec;
+    std::uint64_t size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+} // namespace
+
+std::vector<std::string_view> splitLines(std::string_view text, unsigned int parts) {
+    std::vector<std::string_view> ranges;
+    std::size_t start = 0;
+    for (unsigned int i = 1; i <= parts && start < text.size(); ++i) {
+        std::size_t stop = i == parts ? text.size() : std::max(start, text.size() * i / parts);
+        stop = text.find('\n', stop);
+        stop = stop == std::string_view::npos ? text.size() : stop + 1;
+        ranges.push_back(text.substr(start, stop - start));
+        start = stop;
+    }
+    return ranges;
+}
+
+bool parseJoinType(const std::string& name, JoinType& type) {
+    if (name == "inner") {
+        type = JoinType::Inner;
+    } else if (name == "left") {
+        type = JoinType::LeftOuter;
+    } else if (name == "anti") {
+        type = JoinType::Anti;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+std::uint64_t BroadcastTable::hashKey(std::string_view key) {
+    // FNV-1a, then a final mix so low bits are usable as a slot index.
+    std::uint64_t hash = 1469598103934665603ULL;
+    for (char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+std::string_view BroadcastTable::keyOf(const Entry& entry) const {
+    return std::string_view(text_.data() + entry.keyOffset, entry.keyLength);
+}
+
+bool BroadcastTable::load(const std::string& path) {
+    LineBlockReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    text_.clear();
+    std::vector<char> block;
+    while (reader.next(block)) {
+        text_.insert(text_.end(), block.begin(), block.end());
+    }
+    if (text_.size() >= 0xffffffffu) {
+        std::cerr << "Broadcast side is too large (4 GiB max): " << path << "\n";
+        return false;
+    }
+
+    entries_.clear();
+    forEachRow(std::string_view(text_.data(), text_.size()), [&](const Row& row) {
+        std::uint32_t offset = static_cast<std::uint32_t>(row.line.data() - text_.data());
+        std::string_view value = row.value();
+        std::uint32_t valueOffset = value.empty()
+            ? offset + static_cast<std::uint32_t>(row.line.size())
+            : static_cast<std::uint32_t>(value.data() - text_.data());
+        entries_.push_back({ offset, static_cast<std::uint32_t>(row.keyLength), valueOffset,
+                             static_cast<std::uint32_t>(value.size()) });
+    });
+
+    std::size_t slotCount = 16;
+    while (slotCount < entries_.size() * 2) {
+        slotCount *= 2;
+    }
+    slots_.assign(slotCount, 0);
+    std::size_t mask = slotCount - 1;
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        std::size_t slot = static_cast<std::size_t>(hashKey(keyOf(entries_[i]))) & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+    return true;
+}
+
+bool BroadcastTable::contains(std::string_view key) const {
+    bool found = false;
+    forEach(key, [&](std::string_view) { found = true; });
+    return found;
+}
+
+std::size_t BroadcastTable::size() const {
+    return entries_.size();
+}
+
+// ---------------------------------------------------------------------------
+
+bool broadcastHashJoin(const std::string& left, const std::string& right,
+                       const std::string& output, const JoinOptions& options) {
+    BroadcastTable table;
+    if (!table.load(right)) {
+        return false;
+    }
+
+    LineBlockReader reader;
+    JoinOutput out;
+    if (!reader.open(left) || !out.open(output, options.outputCodec)) {
+        return false;
+    }
+
+    const unsigned int workers = std::max(1u, options.workers);
+    std::vector<char> block;
+    while (reader.next(block)) {
+        std::vector<std::string_view> ranges = splitLines(std::string_view(block.data(), block.size()), workers);
+        std::vector<std::string> results(ranges.size());
+
+        auto probe = [&](std::size_t index) {
+            std::string& result = results[index];
+            forEachRow(ranges[index], [&](const Row& row) {
+                bool matched = false;
+                if (options.type == JoinType::Anti) {
+                    matched = table.contains(row.key());
+                } else {
+                    table.forEach(row.key(), [&](std::string_view value) {
+                        appendPair(result, row, value);
+                        matched = true;
+                    });
+                }
+                if (!matched && options.type == JoinType::LeftOuter) {
+                    appendPair(result, row, std::string_view());
+                } else if (!matched && options.type == JoinType::Anti) {
+                    appendLine(result, row);
+                }
+            });
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < ranges.size(); ++i) {
+            threads.emplace_back(probe, i);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        for (const auto& result : results) {
+            if (!out.append(result)) {
+                return false;
+            }
+        }
+    }
+    return out.commit();
+}
+
+// ---------------------------------------------------------------------------
+
+bool sortMergeJoin(const std::string& left, const std::string& right,
+                   const std::string& output, const JoinOptions& options) {
+    const unsigned int workers = std::max(1u, options.workers);
+
+    // Partitions are sized so one partition pair (text, row views and
+    // output) fits a worker's share of the budget.
+    unsigned int partitions = workers;
+    if (options.memoryLimit > 0) {
+        std::uint64_t total = fileSize(left) + fileSize(right);
+        std::uint64_t share = std::max<std::uint64_t>(1, options.memoryLimit / workers);
+        std::uint64_t needed = (3 * total + share - 1) / share;
+        partitions = static_cast<unsigned int>(std::min<std::uint64_t>(
+            kMaxPartitions, std::max<std::uint64_t>(partitions, needed)));
+    }
+
+    std::filesystem::path tempDir = options.tempDir.empty()
+        ? std::filesystem::path(output).parent_path() / "join-tmp"
+        : std::filesystem::path(options.tempDir);
+    std::error_code ec;
+    std::filesystem::create_directories(tempDir, ec);
+
+    auto shufflePath = [&](char side, unsigned int p) {
+        return (tempDir / (std::string("join-") + side + "-" + std::to_string(p) + ".part")).string();
+    };
+    auto removeShuffle = [&]() {
+        for (unsigned int p = 0; p < partitions; ++p) {
+            std::filesystem::remove(shufflePath('L', p), ec);
+            std::filesystem::remove(shufflePath('R', p), ec);
+        }
+        std::filesystem::remove(tempDir, ec);  // only if empty
+    };
+
+    // Map side: route every line to the partition of its key.
+    auto shuffle = [&](const std::string& input, char side) -> bool {
+        LineBlockReader reader;
+        if (!reader.open(input)) {
+            return false;
+        }
+        std::vector<std::ofstream> files(partitions);
+        for (unsigned int p = 0; p < partitions; ++p) {
+            files[p].open(shufflePath(side, p), std::ios::binary | std::ios::trunc);
+            if (!files[p].is_open()) {
+                std::cerr << "Failed to create shuffle file: " << shufflePath(side, p) << "\n";
+                return false;
+            }
+        }
+
+        std::vector<char> block;
+        while (reader.next(block)) {
+            std::vector<std::string_view> ranges = splitLines(std::string_view(block.data(), block.size()), workers);
+            std::vector<std::vector<std::string>> routed(ranges.size(), std::vector<std::string>(partitions));
+            auto route = [&](std::size_t index) {
+                forEachRow(ranges[index], [&](const Row& row) {
+                    std::size_t p = static_cast<std::size_t>(BroadcastTable::hashKey(row.key()) % partitions);
+                    appendLine(routed[index][p], row);
+                });
+            };
+            std::vector<std::thread> threads;
+            for (std::size_t i = 0; i < ranges.size(); ++i) {
+                threads.emplace_back(route, i);
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            for (auto& worker : routed) {
+                for (unsigned int p = 0; p < partitions; ++p) {
+                    files[p].write(worker[p].data(), static_cast<std::streamsize>(worker[p].size()));
+                }
+            }
+        }
+        for (auto& file : files) {
+            file.close();
+            if (!file) {
+                std::cerr << "Failed to write shuffle files in " << tempDir.string() << "\n";
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (!shuffle(left, 'L') || !shuffle(right, 'R')) {
+        removeShuffle();
+        return false;
+    }
+
+    JoinOutput out;
+    if (!out.open(output, options.outputCodec)) {
+        removeShuffle();
+        return false;
+    }
+
+    // Reduce side: sort each partition pair by key and merge. Results are
+    // appended in partition order as they become ready.
+    std::atomic<unsigned int> next{ 0 };
+    std::mutex outputMutex;
+    std::map<unsigned int, std::string> finished;
+    unsigned int nextToWrite = 0;
+    bool writeFailed = false;
+
+    auto readAll = [](const std::string& path, std::string& text) {
+        std::ifstream in(path, std::ios::binary);
+        text.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    };
+    auto byKey = [](const Row& a, const Row& b) { return a.key() < b.key(); };
+
+    auto reducer = [&]() {
+        std::string leftText, rightText;
+        std::vector<Row> leftRows, rightRows;
+        for (unsigned int p = next++; p < partitions; p = next++) {
+            readAll(shufflePath('L', p), leftText);
+            readAll(shufflePath('R', p), rightText);
+            leftRows.clear();
+            rightRows.clear();
+            forEachRow(leftText, [&](const Row& row) { leftRows.push_back(row); });
+            forEachRow(rightText, [&](const Row& row) { rightRows.push_back(row); });
+            std::stable_sort(leftRows.begin(), leftRows.end(), byKey);
+            std::stable_sort(rightRows.begin(), rightRows.end(), byKey);
+
+            std::string result;
+            std::size_t j = 0;
+            for (std::size_t i = 0; i < leftRows.size();) {
+                std::string_view key = leftRows[i].key();
+                std::size_t iEnd = i;
+                while (iEnd < leftRows.size() && leftRows[iEnd].key() == key) {
+                    ++iEnd;
+                }
+                while (j < rightRows.size() && rightRows[j].key() < key) {
+                    ++j;
+                }
+                std::size_t jEnd = j;
+                while (jEnd < rightRows.size() && rightRows[jEnd].key() == key) {
+                    ++jEnd;
+                }
+
+                for (std::size_t l = i; l < iEnd; ++l) {
+                    if (j == jEnd) {
+                        if (options.type == JoinType::LeftOuter) {
+                            appendPair(result, leftRows[l], std::string_view());
+                        } else if (options.type == JoinType::Anti) {
+                            appendLine(result, leftRows[l]);
+                        }
+                    } else if (options.type != JoinType::Anti) {
+                        for (std::size_t r = j; r < jEnd; ++r) {
+                            appendPair(result, leftRows[l], rightRows[r].value());
+                        }
+                    }
+                }
+                i = iEnd;
+                j = jEnd;
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            finished[p] = std::move(result);
+            while (!finished.empty() && finished.begin()->first == nextToWrite) {
+                writeFailed = writeFailed || !out.append(finished.begin()->second);
+                finished.erase(finished.begin());
+                ++nextToWrite;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < std::min(workers, partitions); ++i) {
+        threads.emplace_back(reducer);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    removeShuffle();
+
+    if (writeFailed) {
+        std::cerr << "Failed to write join output: " << output << "\n";
+        return false;
+    }
+    return out.commit();
+}
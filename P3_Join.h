@@ -0,0 +1,97 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "P3_Compression.h"
+
+// Joins of two "key,value" text files, e.g. word counts against a stopword
+// list, dictionary or category table. The key is the text before the first
+// comma and the value the rest of the line (possibly empty); keys match
+// exactly. Compressed inputs are detected by magic bytes.
+//
+// Output rows:
+//   Inner / LeftOuter  "key,leftValue,rightValue" for every matching pair
+//                      (LeftOuter also emits "key,leftValue," for unmatched
+//                      left rows)
+//   Anti               unmatched left lines, unchanged
+enum class JoinType { Inner, LeftOuter, Anti };
+
+struct JoinOptions {
+    JoinType type = JoinType::Inner;
+    unsigned int workers = 4;
+    std::size_t memoryLimit = 0;  // sort-merge: sizes the shuffle partitions
+    std::string tempDir;          // sort-merge: shuffle files (default: next to the output)
+    Codec outputCodec = Codec::None;
+};
+
+bool parseJoinType(const std::string& name, JoinType& type);
+
+// Splits `text` into up to `parts` ranges that end on line boundaries (the
+// last range may lack a newline). Used to spread one block over workers.
+std::vector<std::string_view> splitLines(std::string_view text, unsigned int parts);
+
+// The small side of a broadcast join: the whole file in one buffer, with an
+// open-addressing index of (offset, length) entries over it. Built once,
+// then only read, so all workers probe it without locks.
+class BroadcastTable {
+public:
+    bool load(const std::string& path);
+
+    // Calls fn(value) for every row with this key (duplicates allowed).
+    template <typename Fn>
+    void forEach(std::string_view key, Fn&& fn) const;
+
+    bool contains(std::string_view key) const;
+    std::size_t size() const;
+
+    // Key hash of the table; the sort-merge shuffle partitions by it too.
+    static std::uint64_t hashKey(std::string_view key);
+
+private:
+    struct Entry {
+        std::uint32_t keyOffset;
+        std::uint32_t keyLength;
+        std::uint32_t valueOffset;
+        std::uint32_t valueLength;
+    };
+
+    std::string_view keyOf(const Entry& entry) const;
+
+    std::vector<char> text_;
+    std::vector<Entry> entries_;
+    std::vector<std::uint32_t> slots_;  // entry index + 1; 0 = empty
+};
+
+// Streams `left` (any size) in blocks and probes `right`, which must fit in
+// memory. Output keeps the order of `left`.
+bool broadcastHashJoin(const std::string& left, const std::string& right,
+                       const std::string& output, const JoinOptions& options);
+
+// Reduce-side join of two inputs of any size: both are hash-partitioned by
+// key into shuffle files, then each partition pair is sorted by key and
+// merged on its own worker. Output is grouped by partition and sorted by
+// key within a partition.
+bool sortMergeJoin(const std::string& left, const std::string& right,
+                   const std::string& output, const JoinOptions& options);
+
+template <typename Fn>
+void BroadcastTable::forEach(std::string_view key, Fn&& fn) const {
+    if (slots_.empty()) {
+        return;
+    }
+    std::size_t mask = slots_.size() - 1;
+    for (std::size_t slot = static_cast<std::size_t>(hashKey(key)) & mask; slots_[slot] != 0;
+         slot = (slot + 1) & mask) {
+        const Entry& entry = entries_[slots_[slot] - 1];
+        if (keyOf(entry) == key) {
+            fn(std::string_view(text_.data() + entry.valueOffset, entry.valueLength));
+        }
+    }
+}
+
+#endif // JOIN_H
@@ -0,0 +1,117 @@
+#include "P3_MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle_ = file;
+    mappingHandle_ = mapping;
+    data_ = static_cast<const unsigned char*>(view);
+    size_ = static_cast<std::size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mappingHandle_ != nullptr) {
+        CloseHandle(static_cast<HANDLE>(mappingHandle_));
+    }
+    if (fileHandle_ != nullptr) {
+        CloseHandle(static_cast<HANDLE>(fileHandle_));
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mappingHandle_ = nullptr;
+    fileHandle_ = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    data_ = static_cast<const unsigned char*>(view);
+    size_ = static_cast<std::size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        munmap(const_cast<unsigned char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+bool MappedFile::isOpen() const {
+    return data_ != nullptr;
+}
+
+const unsigned char* MappedFile::data() const {
+    return data_;
+}
+
+std::size_t MappedFile::size() const {
+    return size_;
+}
@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file (mmap on POSIX,
+// CreateFileMapping on Windows). The mapping is released on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map the file. Returns false if it cannot be opened or mapped.
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    std::size_t size() const;
+
+private:
+    const unsigned char* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -6,24 +6,28 @@ bool Mapper::isWordCharacter(char c) {
     return static_cast<bool>(std::isalnum(static_cast<unsigned char>(c)));
 }
 
+char Mapper::normalize(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
 std::vector<std::pair<std::string, int>> Mapper::mapLine(const std::string& line) const {
     std::vector<std::pair<std::string, int>> pairs;
-    std::string current;
-
-    for (char c : line) {
-        if (isWordCharacter(c)) {
-            current.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
-        } else {
-            if (!current.empty()) {
-                pairs.emplace_back(current, 1);
-                current.clear();
-            }
-        }
-    }
-
-    if (!current.empty()) {
-        pairs.emplace_back(current, 1);
-    }
+
+    forEachWord(line, [&pairs](const std::string& word) {
+        pairs.emplace_back(word, 1);
+    });
+
+    return pairs;
+}
+
+std::pmr::vector<std::pair<std::pmr::string, int>> Mapper::mapLine(
+    std::string_view line, std::pmr::memory_resource* resource) const {
+
+    std::pmr::vector<std::pair<std::pmr::string, int>> pairs(resource);
+
+    forEachWord(line, [&pairs, resource](const std::string& word) {
+        pairs.emplace_back(std::pmr::string(word, resource), 1);
+    });
 
     return pairs;
 }
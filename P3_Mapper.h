@@ -2,8 +2,10 @@
 #define MAPPER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
+#include <memory_resource>
 
 class Mapper {
 public:
@@ -12,8 +14,39 @@ public:
     // Breaks a line into normalized (lowercase, alnum-only) word tokens.
     std::vector<std::pair<std::string, int>> mapLine(const std::string& line) const;
 
-private:
+    // Same, with the pair vector and token strings allocated from `resource`.
+    std::pmr::vector<std::pair<std::pmr::string, int>> mapLine(
+        std::string_view line, std::pmr::memory_resource* resource) const;
+
+    // Calls fn(word) for every normalized token in `text` without building a
+    // pair vector. The string passed to fn is reused between calls, so copy it
+    // if it has to outlive the call.
+    template <typename Fn>
+    void forEachWord(std::string_view text, Fn&& fn) const;
+
+    // Bytes that belong to a word; any other byte ends one.
     static bool isWordCharacter(char c);
+
+private:
+    static char normalize(char c);
 };
 
+template <typename Fn>
+void Mapper::forEachWord(std::string_view text, Fn&& fn) const {
+    std::string current;
+
+    for (char c : text) {
+        if (isWordCharacter(c)) {
+            current.push_back(normalize(c));
+        } else if (!current.empty()) {
+            fn(static_cast<const std::string&>(current));
+            current.clear();
+        }
+    }
+
+    if (!current.empty()) {
+        fn(static_cast<const std::string&>(current));
+    }
+}
+
 #endif // MAPPER_H
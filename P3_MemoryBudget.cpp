@@ -0,0 +1,103 @@
+#include "P3_MemoryBudget.h"
+
+#include <algorithm>
+#include <cctype>
+
+MemoryBudget::MemoryBudget(std::size_t limitBytes)
+    : limit_(limitBytes) {
+}
+
+bool MemoryBudget::tryReserve(std::size_t bytes) {
+    if (limit_ == 0) {
+        notePeak(used_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        return true;
+    }
+
+    std::size_t current = used_.load(std::memory_order_relaxed);
+    do {
+        if (current + bytes > limit_) {
+            return false;
+        }
+    } while (!used_.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+
+    notePeak(current + bytes);
+    return true;
+}
+
+void MemoryBudget::forceReserve(std::size_t bytes) {
+    notePeak(used_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void MemoryBudget::release(std::size_t bytes) {
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool MemoryBudget::limited() const {
+    return limit_ != 0;
+}
+
+std::size_t MemoryBudget::limit() const {
+    return limit_;
+}
+
+std::size_t MemoryBudget::used() const {
+    return used_.load(std::memory_order_relaxed);
+}
+
+std::size_t MemoryBudget::peak() const {
+    return peak_.load(std::memory_order_relaxed);
+}
+
+std::size_t MemoryBudget::shareFor(unsigned int consumers, double fraction,
+                                   std::size_t minimum, std::size_t maximum) const {
+    if (limit_ == 0) {
+        return maximum;
+    }
+    double share = static_cast<double>(limit_) * fraction / std::max(1u, consumers);
+    std::size_t bytes = static_cast<std::size_t>(share);
+    return std::min(maximum, std::max(minimum, bytes));
+}
+
+bool MemoryBudget::parseSize(const std::string& text, std::size_t& bytes) {
+    std::size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+        ++digits;
+    }
+    if (digits == 0) {
+        return false;
+    }
+
+    std::size_t value = 0;
+    try {
+        value = static_cast<std::size_t>(std::stoull(text.substr(0, digits)));
+    } catch (...) {
+        return false;
+    }
+
+    std::string suffix = text.substr(digits);
+    for (char& c : suffix) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+
+    std::size_t multiplier = 1;
+    if (suffix.empty() || suffix == "B") {
+        multiplier = 1;
+    } else if (suffix == "K" || suffix == "KB" || suffix == "KIB") {
+        multiplier = std::size_t(1) << 10;
+    } else if (suffix == "M" || suffix == "MB" || suffix == "MIB") {
+        multiplier = std::size_t(1) << 20;
+    } else if (suffix == "G" || suffix == "GB" || suffix == "GIB") {
+        multiplier = std::size_t(1) << 30;
+    } else {
+        return false;
+    }
+
+    bytes = value * multiplier;
+    return true;
+}
+
+void MemoryBudget::notePeak(std::size_t now) {
+    std::size_t peak = peak_.load(std::memory_order_relaxed);
+    while (now > peak && !peak_.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
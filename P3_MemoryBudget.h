@@ -0,0 +1,47 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <string>
+#include <atomic>
+#include <cstddef>
+
+// Process-wide memory budget shared by all workers of a job. Buffers and
+// aggregation tables reserve bytes before they grow; when a reservation
+// fails the owner is expected to spill to disk and release what it held.
+// A limit of 0 means unlimited.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(std::size_t limitBytes = 0);
+
+    // Reserve bytes if they fit in the budget. Returns false otherwise.
+    bool tryReserve(std::size_t bytes);
+
+    // Reserve bytes even if that exceeds the budget (for memory that cannot
+    // be spilled, such as the buffer of the file currently being mapped).
+    void forceReserve(std::size_t bytes);
+
+    void release(std::size_t bytes);
+
+    bool limited() const;
+    std::size_t limit() const;
+    std::size_t used() const;
+    std::size_t peak() const;
+
+    // Even share of the budget for one of `consumers`, scaled by `fraction`,
+    // clamped to [minimum, maximum]. With no limit, returns `maximum`.
+    std::size_t shareFor(unsigned int consumers, double fraction,
+                         std::size_t minimum, std::size_t maximum) const;
+
+    // Parse sizes such as "512M", "2G", "65536" or "64k". Returns false on
+    // malformed input.
+    static bool parseSize(const std::string& text, std::size_t& bytes);
+
+private:
+    void notePeak(std::size_t now);
+
+    std::size_t limit_;
+    std::atomic<std::size_t> used_{ 0 };
+    std::atomic<std::size_t> peak_{ 0 };
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,81 @@
+#include "P3_MemoryResources.h"
+
+#include <algorithm>
+
+CountingResource::CountingResource(std::pmr::memory_resource* upstream)
+    : upstream_(upstream) {
+}
+
+std::size_t CountingResource::bytesInUse() const {
+    return inUse_.load(std::memory_order_relaxed);
+}
+
+std::size_t CountingResource::highWaterMark() const {
+    return peak_.load(std::memory_order_relaxed);
+}
+
+std::size_t CountingResource::bytesAllocated() const {
+    return allocated_.load(std::memory_order_relaxed);
+}
+
+void CountingResource::resetCounters() {
+    inUse_.store(0, std::memory_order_relaxed);
+    peak_.store(0, std::memory_order_relaxed);
+    allocated_.store(0, std::memory_order_relaxed);
+}
+
+void* CountingResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    void* p = upstream_->allocate(bytes, alignment);
+    allocated_.fetch_add(bytes, std::memory_order_relaxed);
+    std::size_t now = inUse_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::size_t peak = peak_.load(std::memory_order_relaxed);
+    while (now > peak && !peak_.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+    return p;
+}
+
+void CountingResource::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+    upstream_->deallocate(p, bytes, alignment);
+    inUse_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+TaskArena::TaskArena(std::size_t initialBytes)
+    : initial_(initialBytes == 0 ? 4096 : initialBytes),
+      arena_(initial_.data(), initial_.size(), std::pmr::new_delete_resource()),
+      front_(&arena_) {
+}
+
+std::pmr::memory_resource* TaskArena::resource() {
+    return &front_;
+}
+
+void TaskArena::reset() {
+    peakTaskBytes_ = std::max(peakTaskBytes_, front_.bytesAllocated());
+    front_.resetCounters();
+    arena_.release();
+}
+
+std::size_t TaskArena::highWaterMark() const {
+    return std::max(peakTaskBytes_, front_.bytesAllocated());
+}
+
+AggregationPool::AggregationPool()
+    : upstream_(std::pmr::new_delete_resource()),
+      pool_(&upstream_) {
+}
+
+std::pmr::memory_resource* AggregationPool::resource() {
+    return &pool_;
+}
+
+std::size_t AggregationPool::highWaterMark() const {
+    return upstream_.highWaterMark();
+}
+
+void AggregationPool::release() {
+    pool_.release();
+}
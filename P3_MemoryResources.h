@@ -0,0 +1,80 @@
+#ifndef MEMORYRESOURCES_H
+#define MEMORYRESOURCES_H
+
+#include <memory_resource>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// Forwards to an upstream resource and records how many bytes are in use,
+// the peak, and the total allocated since the last resetCounters().
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+    std::size_t bytesInUse() const;
+    std::size_t highWaterMark() const;
+    std::size_t bytesAllocated() const;
+    void resetCounters();
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    std::pmr::memory_resource* upstream_;
+    std::atomic<std::size_t> inUse_{ 0 };
+    std::atomic<std::size_t> peak_{ 0 };
+    std::atomic<std::size_t> allocated_{ 0 };
+};
+
+// Working memory for one map task. Allocations are bump-pointer from a
+// monotonic buffer and are never freed individually; reset() drops the whole
+// task's memory at once. The initial buffer is reused by every task, so
+// tasks that fit in it never touch the global heap.
+class TaskArena {
+public:
+    explicit TaskArena(std::size_t initialBytes = 1024 * 1024);
+
+    TaskArena(const TaskArena&) = delete;
+    TaskArena& operator=(const TaskArena&) = delete;
+
+    std::pmr::memory_resource* resource();
+
+    // End of task: release everything allocated since the previous reset.
+    void reset();
+
+    // Largest number of bytes any single task allocated from the arena.
+    std::size_t highWaterMark() const;
+
+private:
+    std::vector<std::byte> initial_;
+    std::pmr::monotonic_buffer_resource arena_;
+    CountingResource front_;
+    std::size_t peakTaskBytes_ = 0;
+};
+
+// Long-lived, unsynchronized pool for one worker's aggregation state
+// (e.g. its word-count table), with upstream usage tracking.
+class AggregationPool {
+public:
+    AggregationPool();
+
+    AggregationPool(const AggregationPool&) = delete;
+    AggregationPool& operator=(const AggregationPool&) = delete;
+
+    std::pmr::memory_resource* resource();
+
+    // Peak bytes the pool obtained from the heap.
+    std::size_t highWaterMark() const;
+
+    // Return all pooled memory to the heap. Every container using the pool
+    // must be empty or destroyed first.
+    void release();
+
+private:
+    CountingResource upstream_;
+    std::pmr::unsynchronized_pool_resource pool_;
+};
+
+#endif // MEMORYRESOURCES_H
@@ -0,0 +1,173 @@
+#include "P3_NGram.h"
+#include "P3_SymbolTable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace {
+const std::size_t kInitialSlots = 1024; // power of two
+}
+
+NGramTable::NGramTable(unsigned int n)
+    : n_(n == 0 ? 1 : n),
+      slots_(kInitialSlots, 0) {
+}
+
+std::uint64_t NGramTable::hashKey(const std::uint32_t* ids) const {
+    std::uint64_t hash = 0x9e3779b97f4a7c15ULL;
+    for (unsigned int i = 0; i < n_; ++i) {
+        hash ^= ids[i];
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+    }
+    return hash;
+}
+
+bool NGramTable::keyEquals(std::size_t entry, const std::uint32_t* ids) const {
+    return std::memcmp(&keys_[entry * n_], ids, n_ * sizeof(std::uint32_t)) == 0;
+}
+
+void NGramTable::add(const std::uint32_t* ids, std::uint64_t count) {
+    std::size_t mask = slots_.size() - 1;
+    std::size_t slot = static_cast<std::size_t>(hashKey(ids)) & mask;
+
+    while (slots_[slot] != 0) {
+        std::size_t entry = slots_[slot] - 1;
+        if (keyEquals(entry, ids)) {
+            counts_[entry] += count;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    std::size_t entry = counts_.size();
+    keys_.insert(keys_.end(), ids, ids + n_);
+    counts_.push_back(count);
+    slots_[slot] = static_cast<std::uint32_t>(entry + 1);
+
+    // Keep the load factor below 0.7 so probe sequences stay short.
+    if (counts_.size() * 10 > slots_.size() * 7) {
+        rehash(slots_.size() * 2);
+    }
+}
+
+void NGramTable::rehash(std::size_t slotCount) {
+    slots_.assign(slotCount, 0);
+    std::size_t mask = slotCount - 1;
+    for (std::size_t entry = 0; entry < counts_.size(); ++entry) {
+        std::size_t slot = static_cast<std::size_t>(hashKey(&keys_[entry * n_])) & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = static_cast<std::uint32_t>(entry + 1);
+    }
+}
+
+void NGramTable::merge(const NGramTable& other) {
+    for (std::size_t entry = 0; entry < other.size(); ++entry) {
+        add(other.keyAt(entry), other.countAt(entry));
+    }
+}
+
+unsigned int NGramTable::n() const {
+    return n_;
+}
+
+std::size_t NGramTable::size() const {
+    return counts_.size();
+}
+
+const std::uint32_t* NGramTable::keyAt(std::size_t entry) const {
+    return &keys_[entry * n_];
+}
+
+std::uint64_t NGramTable::countAt(std::size_t entry) const {
+    return counts_[entry];
+}
+
+std::size_t NGramTable::memoryBytes() const {
+    return keys_.capacity() * sizeof(std::uint32_t) +
+           counts_.capacity() * sizeof(std::uint64_t) +
+           slots_.capacity() * sizeof(std::uint32_t);
+}
+
+NGramWindow::NGramWindow(unsigned int n)
+    : n_(n == 0 ? 1 : n),
+      window_(n_, 0) {
+}
+
+bool NGramWindow::push(std::uint32_t id) {
+    // Shift left; n is small (2-5), so this beats ring-buffer index math
+    // and keeps ids() contiguous in stream order.
+    if (n_ > 1) {
+        std::copy(window_.begin() + 1, window_.end(), window_.begin());
+    }
+    window_[n_ - 1] = id;
+    ++seen_;
+    return seen_ >= n_;
+}
+
+const std::uint32_t* NGramWindow::ids() const {
+    return window_.data();
+}
+
+void NGramWindow::reset() {
+    seen_ = 0;
+}
+
+std::vector<std::pair<std::string, std::size_t>> ngramRows(const NGramTable& table,
+                                                           const SymbolTable& symbols,
+                                                           std::size_t topK) {
+    // Comparing ID tuples token by token gives the same order as comparing
+    // the joined text, because the separator sorts below every word character.
+    const unsigned int n = table.n();
+    auto textLess = [&](std::size_t a, std::size_t b) {
+        const std::uint32_t* ka = table.keyAt(a);
+        const std::uint32_t* kb = table.keyAt(b);
+        for (unsigned int i = 0; i < n; ++i) {
+            if (ka[i] != kb[i]) {
+                return symbols.text(ka[i]) < symbols.text(kb[i]);
+            }
+        }
+        return false;
+    };
+
+    std::vector<std::size_t> order(table.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+
+    if (topK > 0 && topK < order.size()) {
+        auto ranksBefore = [&](std::size_t a, std::size_t b) {
+            if (table.countAt(a) != table.countAt(b)) {
+                return table.countAt(a) > table.countAt(b);
+            }
+            return textLess(a, b);
+        };
+        std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(topK),
+                          order.end(), ranksBefore);
+        order.resize(topK);
+    } else if (topK > 0) {
+        std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            if (table.countAt(a) != table.countAt(b)) {
+                return table.countAt(a) > table.countAt(b);
+            }
+            return textLess(a, b);
+        });
+    } else {
+        std::sort(order.begin(), order.end(), textLess);
+    }
+
+    std::vector<std::pair<std::string, std::size_t>> rows;
+    rows.reserve(order.size());
+    for (std::size_t entry : order) {
+        const std::uint32_t* ids = table.keyAt(entry);
+        std::string text(symbols.text(ids[0]));
+        for (unsigned int i = 1; i < n; ++i) {
+            text += ' ';
+            text += symbols.text(ids[i]);
+        }
+        rows.emplace_back(std::move(text), static_cast<std::size_t>(table.countAt(entry)));
+    }
+
+    return rows;
+}
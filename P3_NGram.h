@@ -0,0 +1,67 @@
+#ifndef NGRAM_H
+#define NGRAM_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+class SymbolTable;
+
+// Open-addressing count table keyed by fixed-length sequences of token IDs.
+// Keys are stored back to back in one vector (n IDs per entry), so an
+// n-gram costs n * 4 bytes of key plus its count, with no per-key heap
+// allocation and no concatenated strings.
+class NGramTable {
+public:
+    explicit NGramTable(unsigned int n);
+
+    void add(const std::uint32_t* ids, std::uint64_t count = 1);
+    void merge(const NGramTable& other);
+
+    unsigned int n() const;
+    std::size_t size() const;
+    const std::uint32_t* keyAt(std::size_t entry) const;
+    std::uint64_t countAt(std::size_t entry) const;
+
+    // Approximate bytes held by the table.
+    std::size_t memoryBytes() const;
+
+private:
+    std::uint64_t hashKey(const std::uint32_t* ids) const;
+    bool keyEquals(std::size_t entry, const std::uint32_t* ids) const;
+    void rehash(std::size_t slotCount);
+
+    unsigned int n_;
+    std::vector<std::uint32_t> keys_;
+    std::vector<std::uint64_t> counts_;
+    std::vector<std::uint32_t> slots_; // entry index + 1; 0 = empty
+};
+
+// Sliding window over a token-ID stream. push() returns true once the window
+// holds n IDs, after which ids() is the current n-gram in stream order.
+class NGramWindow {
+public:
+    explicit NGramWindow(unsigned int n);
+
+    bool push(std::uint32_t id);
+    const std::uint32_t* ids() const;
+
+    // Start a new stream (n-grams never span two files).
+    void reset();
+
+private:
+    unsigned int n_;
+    std::size_t seen_ = 0;
+    std::vector<std::uint32_t> window_;
+};
+
+// Output rows ("w1 w2 ... wn", count) of a merged table. With topK == 0
+// every n-gram is returned sorted by text; otherwise the topK most frequent,
+// highest count first and then by text.
+std::vector<std::pair<std::string, std::size_t>> ngramRows(const NGramTable& table,
+                                                           const SymbolTable& symbols,
+                                                           std::size_t topK);
+
+#endif // NGRAM_H
@@ -0,0 +1,285 @@
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Flush threshold of each formatting thread's buffer.
+const std::size_t kFormatBufferSize = 1024 * 1024;
+
+// Rows per thread below which parallel formatting is not worth it.
+const std::size_t kMinRowsPerThread = 16 * 1024;
+
+std::size_t decimalDigits(std::size_t value) {
+    std::size_t digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        ++digits;
+    }
+    return digits;
+}
+
+} // namespace
+
+AtomicOutputFile::~AtomicOutputFile() {
+    abort();
+}
+
+#ifdef _WIN32
+
+bool AtomicOutputFile::open(const std::string& path) {
+    abort();
+    path_ = path;
+    tempPath_ = path + ".tmp";
+    end_ = 0;
+    HANDLE file = CreateFileA(tempPath_.c_str(), GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open output file for writing: " << tempPath_ << "\n";
+        return false;
+    }
+    handle_ = file;
+    return true;
+}
+
+bool AtomicOutputFile::writeAt(std::uint64_t offset, const char* data, std::size_t size) {
+    while (size > 0) {
+        OVERLAPPED position{};
+        position.Offset = static_cast<DWORD>(offset & 0xFFFFFFFFu);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(static_cast<HANDLE>(handle_), data, chunk, &written, &position) || written == 0) {
+            std::cerr << "Failed to write output file: " << tempPath_ << "\n";
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool AtomicOutputFile::commit() {
+    if (handle_ == nullptr) {
+        return false;
+    }
+    bool ok = FlushFileBuffers(static_cast<HANDLE>(handle_)) != 0;
+    CloseHandle(static_cast<HANDLE>(handle_));
+    handle_ = nullptr;
+    if (ok) {
+        ok = MoveFileExA(tempPath_.c_str(), path_.c_str(),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    }
+    if (!ok) {
+        std::cerr << "Failed to commit output file: " << path_ << "\n";
+        DeleteFileA(tempPath_.c_str());
+    }
+    tempPath_.clear();
+    return ok;
+}
+
+void AtomicOutputFile::abort() {
+    if (handle_ != nullptr) {
+        CloseHandle(static_cast<HANDLE>(handle_));
+        handle_ = nullptr;
+    }
+    if (!tempPath_.empty()) {
+        DeleteFileA(tempPath_.c_str());
+        tempPath_.clear();
+    }
+}
+
+#else
+
+bool AtomicOutputFile::open(const std::string& path) {
+    abort();
+    path_ = path;
+    tempPath_ = path + ".tmp";
+    end_ = 0;
+    fd_ = ::open(tempPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open output file for writing: " << tempPath_ << "\n";
+        tempPath_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AtomicOutputFile::writeAt(std::uint64_t offset, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            std::cerr << "Failed to write output file: " << tempPath_ << "\n";
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+        offset += static_cast<std::uint64_t>(written);
+    }
+    return true;
+}
+
+bool AtomicOutputFile::commit() {
+    if (fd_ < 0) {
+        return false;
+    }
+    bool ok = ::fsync(fd_) == 0;
+    ok = (::close(fd_) == 0) && ok;
+    fd_ = -1;
+    if (ok) {
+        ok = std::rename(tempPath_.c_str(), path_.c_str()) == 0;
+    }
+    if (!ok) {
+        std::cerr << "Failed to commit output file: " << path_ << "\n";
+        ::unlink(tempPath_.c_str());
+        tempPath_.clear();
+        return false;
+    }
+    tempPath_.clear();
+
+    // Persist the rename itself.
+    std::string dir = std::filesystem::path(path_).parent_path().string();
+    int dirFd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
+
+void AtomicOutputFile::abort() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (!tempPath_.empty()) {
+        ::unlink(tempPath_.c_str());
+        tempPath_.clear();
+    }
+}
+
+#endif
+
+bool AtomicOutputFile::append(const char* data, std::size_t size) {
+    if (!writeAt(end_, data, size)) {
+        return false;
+    }
+    end_ += size;
+    return true;
+}
+
+bool CsvOutputWriter::write(const std::string& path,
+                            const std::vector<std::pair<std::string, std::size_t>>& rows,
+                            unsigned int threads,
+                            Codec codec) {
+    AtomicOutputFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::size_t ranges = std::min<std::size_t>(threads, rows.size() / kMinRowsPerThread + 1);
+
+    // Pass 1: exact byte size of each range ("word,count\n" per row).
+    std::vector<std::size_t> begin(ranges + 1);
+    for (std::size_t r = 0; r <= ranges; ++r) {
+        begin[r] = rows.size() * r / ranges;
+    }
+    std::vector<std::uint64_t> offset(ranges + 1, 0);
+    for (std::size_t r = 0; r < ranges; ++r) {
+        std::uint64_t bytes = 0;
+        for (std::size_t i = begin[r]; i < begin[r + 1]; ++i) {
+            bytes += rows[i].first.size() + decimalDigits(rows[i].second) + 2;
+        }
+        offset[r + 1] = offset[r] + bytes;
+    }
+
+    // Pass 2: format and write every range at its offset. Compressed ranges
+    // have no known size, so they are kept and appended in order instead.
+    std::atomic<bool> ok{ true };
+    std::vector<std::vector<char>> compressed(codec == Codec::None ? 0 : ranges);
+    auto formatRange = [&](std::size_t r) {
+        std::vector<char> buffer(kFormatBufferSize + 64);
+        std::size_t used = 0;
+        std::uint64_t position = offset[r];
+
+        auto flush = [&]() {
+            if (codec != Codec::None) {
+                if (used > 0 && !compressBuffer(codec, buffer.data(), used, compressed[r])) {
+                    ok = false;
+                }
+            } else if (used > 0 && !file.writeAt(position, buffer.data(), used)) {
+                ok = false;
+            }
+            position += used;
+            used = 0;
+        };
+
+        for (std::size_t i = begin[r]; i < begin[r + 1] && ok; ++i) {
+            const std::string& word = rows[i].first;
+            if (used + word.size() + 24 > buffer.size()) {
+                flush();
+                if (word.size() + 24 > buffer.size()) {
+                    buffer.resize(word.size() + 24);
+                }
+            }
+            std::copy(word.begin(), word.end(), buffer.data() + used);
+            used += word.size();
+            buffer[used++] = ',';
+            char* end = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(),
+                                      rows[i].second).ptr;
+            used = static_cast<std::size_t>(end - buffer.data());
+            buffer[used++] = '\n';
+            if (used >= kFormatBufferSize) {
+                flush();
+            }
+        }
+        flush();
+    };
+
+    if (ranges == 1) {
+        formatRange(0);
+    } else {
+        std::vector<std::thread> workers;
+        for (std::size_t r = 0; r < ranges; ++r) {
+            workers.emplace_back(formatRange, r);
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    for (std::size_t r = 0; r < compressed.size() && ok; ++r) {
+        if (!file.append(compressed[r].data(), compressed[r].size())) {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        file.abort();
+        return false;
+    }
+    return file.commit();
+}
@@ -0,0 +1,65 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+#include "P3_Compression.h"
+
+// Output file that only becomes visible once complete. Data goes to
+// "<path>.tmp"; commit() flushes it to disk and renames it over `path`, so
+// readers see either the previous file or the whole new one. A file that is
+// never committed is removed.
+class AtomicOutputFile {
+public:
+    AtomicOutputFile() = default;
+    ~AtomicOutputFile();
+
+    AtomicOutputFile(const AtomicOutputFile&) = delete;
+    AtomicOutputFile& operator=(const AtomicOutputFile&) = delete;
+
+    bool open(const std::string& path);
+
+    // Write at the current end of the file.
+    bool append(const char* data, std::size_t size);
+
+    // Write at a fixed offset. Safe to call from several threads at once
+    // for disjoint ranges.
+    bool writeAt(std::uint64_t offset, const char* data, std::size_t size);
+
+    // Sync to disk and atomically replace the target. Returns false (and
+    // leaves the target untouched) on any error.
+    bool commit();
+
+    // Drop the temporary file.
+    void abort();
+
+private:
+    std::string path_;
+    std::string tempPath_;
+    std::uint64_t end_ = 0;
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// CSV writer for (word, count) rows. Rows are split into ranges whose byte
+// sizes are computed up front; each range is then formatted with
+// std::to_chars into its own large buffer on its own thread and written at
+// its precomputed offset, so both formatting and I/O run in parallel and
+// the file is committed atomically. With a codec every range becomes its
+// own gzip member or zstd frame; concatenated, they form one valid stream.
+class CsvOutputWriter {
+public:
+    static bool write(const std::string& path,
+                      const std::vector<std::pair<std::string, std::size_t>>& rows,
+                      unsigned int threads = 0,
+                      Codec codec = Codec::None);
+};
+
+#endif // OUTPUTWRITER_H
@@ -0,0 +1,295 @@
+#include "P3_ReadAhead.h"
+#include "P3_FileDiscovery.h"
+#include "P3_MemoryBudget.h"
+#include "P3_Compression.h"
+#include "P3_Mapper.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Size of each read request; large enough that a spinning disk streams.
+const std::size_t kReadBlockSize = 1024 * 1024;
+
+// Enough leading bytes to recognise any supported codec's magic.
+const std::size_t kMagicBytes = 4;
+}
+
+ReadAheadPipeline::ReadAheadPipeline(FileQueue& input,
+                                     unsigned int readers,
+                                     std::size_t buffersInFlight,
+                                     MemoryBudget* budget)
+    : input_(input),
+      readers_(readers == 0 ? 1 : readers),
+      budget_(budget),
+      output_(buffersInFlight) {
+    // Split archives (zstd frames, BGZF blocks) decode on the cores the
+    // other readers leave free.
+    decodeThreads_ = std::max(1u, std::thread::hardware_concurrency() / readers_);
+}
+
+ReadAheadPipeline::~ReadAheadPipeline() {
+    join();
+}
+
+void ReadAheadPipeline::start() {
+    running_ = readers_;
+    for (unsigned int i = 0; i < readers_; ++i) {
+        threads_.emplace_back(&ReadAheadPipeline::readLoop, this);
+    }
+}
+
+bool ReadAheadPipeline::next(FileBuffer& buffer) {
+    return output_.pop(buffer);
+}
+
+void ReadAheadPipeline::release(const FileBuffer& buffer) {
+    settle(buffer.data.size(), 0);
+}
+
+void ReadAheadPipeline::setChunkSize(std::size_t bytes) {
+    chunkBytes_ = bytes;
+}
+
+void ReadAheadPipeline::admit(std::size_t bytes) {
+    if (!budget_) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(budgetMutex_);
+    while (!budget_->tryReserve(bytes)) {
+        if (inFlight_ == 0) {
+            // Nothing of ours will be released to make room, and the mappers
+            // may be waiting on this buffer: overshoot instead of stalling.
+            budget_->forceReserve(bytes);
+            break;
+        }
+        // Spilling mappers also free budget without telling us, so poll.
+        budgetFreed_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    inFlight_ += bytes;
+}
+
+void ReadAheadPipeline::settle(std::size_t admitted, std::size_t actual) {
+    if (!budget_ || admitted == actual) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(budgetMutex_);
+        if (actual > admitted) {
+            // Decoded archives outgrow the file they were admitted as.
+            budget_->forceReserve(actual - admitted);
+            inFlight_ += actual - admitted;
+            return;
+        }
+        budget_->release(admitted - actual);
+        inFlight_ -= admitted - actual;
+    }
+    budgetFreed_.notify_all();
+}
+
+void ReadAheadPipeline::join() {
+    for (auto& t : threads_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads_.clear();
+}
+
+void ReadAheadPipeline::readLoop() {
+    std::filesystem::path path;
+    while (input_.pop(path)) {
+        if (chunkBytes_ > 0) {
+            readChunks(path);
+        } else {
+            readWhole(path);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(doneMutex_);
+    if (--running_ == 0) {
+        output_.close();
+    }
+}
+
+void ReadAheadPipeline::readWhole(const std::filesystem::path& path) {
+    // Admit the file's size before reading it, so a full budget holds the
+    // read back instead of being overshot by every reader at once.
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    const std::size_t admitted = ec ? 0 : static_cast<std::size_t>(size);
+    admit(admitted);
+
+    FileBuffer buffer;
+    buffer.path = path;
+    buffer.ok = readFile(path, buffer.data);
+    if (!buffer.ok) {
+        std::cerr << "Failed to open file for reading: " << path << "\n";
+    } else if (!decompressInPlace(buffer.data, decodeThreads_)) {
+        // Compressed archives are decoded here, off the mappers' threads.
+        std::cerr << "Failed to decompress: " << path << "\n";
+        buffer.data.clear();
+        buffer.ok = false;
+    }
+    settle(admitted, buffer.data.size());
+    output_.push(std::move(buffer));
+}
+
+void ReadAheadPipeline::readChunks(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Failed to open file for reading: " << path << "\n";
+        FileBuffer buffer;
+        buffer.path = path;
+        output_.push(std::move(buffer));
+        return;
+    }
+
+    // Archives have to be decoded as a whole.
+    char magic[kMagicBytes] = {};
+    in.read(magic, kMagicBytes);
+    if (detectCodec(magic, static_cast<std::size_t>(in.gcount())) != Codec::None) {
+        in.close();
+        readWhole(path);
+        return;
+    }
+    in.clear();
+    in.seekg(0);
+
+    // Bytes after the last word boundary of a chunk start the next one.
+    std::vector<char> carry;
+    bool first = true;
+    while (true) {
+        const std::size_t want = carry.size() < chunkBytes_ ? chunkBytes_ - carry.size() : chunkBytes_;
+        const std::size_t admitted = carry.size() + want;
+        admit(admitted);
+
+        FileBuffer buffer;
+        buffer.path = path;
+        buffer.ok = true;
+        buffer.data.swap(carry);
+        const std::size_t used = buffer.data.size();
+        buffer.data.resize(used + want);
+        in.read(buffer.data.data() + used, static_cast<std::streamsize>(want));
+        const std::size_t got = static_cast<std::size_t>(in.gcount());
+        buffer.data.resize(used + got);
+
+        if (got < want) {
+            if (in.bad()) {
+                std::cerr << "Failed to read file: " << path << "\n";
+                buffer.ok = false;
+            }
+            if (buffer.data.empty() && !first) {
+                settle(admitted, 0);
+            } else {
+                settle(admitted, buffer.data.size());
+                output_.push(std::move(buffer));
+            }
+            return;
+        }
+
+        std::size_t cut = buffer.data.size();
+        while (cut > 0 && Mapper::isWordCharacter(buffer.data[cut - 1])) {
+            --cut;
+        }
+        if (cut == 0) {
+            // One word fills the chunk: keep reading until it ends.
+            carry.swap(buffer.data);
+            settle(admitted, 0);
+            continue;
+        }
+        carry.assign(buffer.data.begin() + static_cast<std::ptrdiff_t>(cut), buffer.data.end());
+        buffer.data.resize(cut);
+        settle(admitted, buffer.data.size());
+        output_.push(std::move(buffer));
+        first = false;
+    }
+}
+
+#ifdef _WIN32
+
+bool ReadAheadPipeline::readFile(const std::filesystem::path& path, std::vector<char>& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::vector<char> streamBuffer(kReadBlockSize);
+    in.rdbuf()->pubsetbuf(streamBuffer.data(), static_cast<std::streamsize>(streamBuffer.size()));
+
+    std::error_code ec;
+    std::uintmax_t size = std::filesystem::file_size(path, ec);
+    data.clear();
+    data.reserve(ec ? 0 : static_cast<std::size_t>(size));
+
+    std::size_t used = 0;
+    while (in) {
+        data.resize(used + kReadBlockSize);
+        in.read(data.data() + used, static_cast<std::streamsize>(kReadBlockSize));
+        used += static_cast<std::size_t>(in.gcount());
+    }
+    data.resize(used);
+    return true;
+}
+
+#else
+
+bool ReadAheadPipeline::readFile(const std::filesystem::path& path, std::vector<char>& data) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info {};
+    std::size_t expected = 0;
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        expected = static_cast<std::size_t>(info.st_size);
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    // Ask for aggressive read-ahead of the whole file.
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+    data.clear();
+    data.resize(expected);
+    std::size_t used = 0;
+    bool ok = true;
+    while (true) {
+        if (used == data.size()) {
+            // File grew (or size unknown): extend by a block.
+            data.resize(used + kReadBlockSize);
+        }
+        std::size_t want = std::min(kReadBlockSize, data.size() - used);
+        ssize_t got = ::read(fd, data.data() + used, want);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        if (got == 0) {
+            break;
+        }
+        used += static_cast<std::size_t>(got);
+    }
+    data.resize(used);
+
+#if defined(POSIX_FADV_DONTNEED)
+    // Input is read once; do not let it evict more useful pages.
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    ::close(fd);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstddef>
+
+class FileQueue;
+class MemoryBudget;
+
+// Fixed-capacity blocking queue: push() waits while full, pop() waits while
+// empty. After close(), pop() drains what is left and then returns false.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity)
+        : capacity_(capacity == 0 ? 1 : capacity) {
+    }
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        lock.unlock();
+        notEmpty_.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+// Whole contents of one input file, filled by the read stage.
+struct FileBuffer {
+    std::filesystem::path path;
+    std::vector<char> data;
+    bool ok = false;
+};
+
+// Source of filled input buffers for the mappers.
+class BufferSource {
+public:
+    virtual ~BufferSource() = default;
+
+    // Next filled buffer, or false once all input has been read.
+    virtual bool next(FileBuffer& buffer) = 0;
+
+    // Give a consumed buffer's bytes back to the budget.
+    virtual void release(const FileBuffer& buffer) = 0;
+};
+
+// Read stage decoupled from map work. Reader threads take paths from the
+// discovery queue, read each file with large sequential reads (with
+// sequential read-ahead hints to the OS where available), decompress gzip
+// and zstd input detected by magic bytes, and hand the filled buffers to
+// mappers through a bounded queue, so disk latency overlaps with CPU work.
+// The queue bound caps how many buffers are in flight; their bytes are
+// charged to the memory budget until released. A reader waits for released
+// buffers while the budget is full, and only overshoots it when none of its
+// buffers are in flight.
+class ReadAheadPipeline : public BufferSource {
+public:
+    ReadAheadPipeline(FileQueue& input,
+                      unsigned int readers,
+                      std::size_t buffersInFlight,
+                      MemoryBudget* budget = nullptr);
+    ~ReadAheadPipeline() override;
+
+    ReadAheadPipeline(const ReadAheadPipeline&) = delete;
+    ReadAheadPipeline& operator=(const ReadAheadPipeline&) = delete;
+
+    // Split uncompressed files into buffers of about `bytes` (0, the
+    // default, reads whole files). Each buffer ends after a non-word byte,
+    // so no word is cut in two; only for consumers that do not need a file
+    // in one buffer. Call before start().
+    void setChunkSize(std::size_t bytes);
+
+    void start();
+
+    bool next(FileBuffer& buffer) override;
+    void release(const FileBuffer& buffer) override;
+
+    void join();
+
+    // Read a whole file, as stored, with large sequential reads. Returns
+    // false on error.
+    static bool readFile(const std::filesystem::path& path, std::vector<char>& data);
+
+private:
+    void readLoop();
+    void readWhole(const std::filesystem::path& path);
+    void readChunks(const std::filesystem::path& path);
+
+    // Budget admission of buffers: admit() waits while the budget is full
+    // and our own buffers are in flight; settle() trues up an admission to
+    // the bytes the buffer actually holds.
+    void admit(std::size_t bytes);
+    void settle(std::size_t admitted, std::size_t actual);
+
+    FileQueue& input_;
+    unsigned int readers_;
+    unsigned int decodeThreads_ = 1;
+    MemoryBudget* budget_;
+    std::size_t chunkBytes_ = 0;
+    std::mutex budgetMutex_;
+    std::condition_variable budgetFreed_;
+    std::size_t inFlight_ = 0;
+    BoundedQueue<FileBuffer> output_;
+    std::mutex doneMutex_;
+    unsigned int running_ = 0;
+    std::vector<std::thread> threads_;
+};
+
+#endif // READAHEAD_H
@@ -1,15 +1,208 @@
 #include "P3_Reducer.h"
+#include "P3_SymbolTable.h"
+#include "P3_SpillFile.h"
 
-std::vector<std::pair<std::string, std::size_t>> Reducer::reduce(
-    const std::vector<std::pair<std::string, int>>& mappedPairs) const {
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+using RankedWord = std::pair<std::string_view, std::size_t>;
+
+// True if `a` ranks ahead of `b`: higher count first, ties broken by word.
+struct RanksBefore {
+    bool operator()(const RankedWord& a, const RankedWord& b) const {
+        if (a.second != b.second) {
+            return a.second > b.second;
+        }
+        return a.first < b.first;
+    }
+};
+
+// Offer an entry to a bounded heap of at most k entries. With RanksBefore as
+// the heap order the front is the lowest-ranked entry kept so far, so a new
+// entry only costs O(log k) when it beats it.
+void offerBounded(std::vector<RankedWord>& heap, const RankedWord& entry, std::size_t k) {
+    if (heap.size() < k) {
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), RanksBefore());
+    } else if (RanksBefore()(entry, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), RanksBefore());
+        heap.back() = entry;
+        std::push_heap(heap.begin(), heap.end(), RanksBefore());
+    }
+}
+
+std::vector<std::pair<std::string, std::size_t>> materialize(std::vector<RankedWord>& heap) {
+    std::sort(heap.begin(), heap.end(), RanksBefore());
+
+    std::vector<std::pair<std::string, std::size_t>> result;
+    result.reserve(heap.size());
+    for (const auto& entry : heap) {
+        result.emplace_back(std::string(entry.first), entry.second);
+    }
+    return result;
+}
+
+// Spill runs one reduce partition keeps open at a time. The partitions are
+// reduced concurrently, so the process total is about this many times the
+// partition count (see fanInFor).
+const std::size_t kMaxOpenRuns = 128;
+const std::size_t kMinFanIn = 8;
+const std::size_t kMaxFanIn = 64;
+
+std::size_t fanInFor(std::size_t partitions) {
+    return std::clamp<std::size_t>(kMaxOpenRuns / std::max<std::size_t>(1, partitions), kMinFanIn, kMaxFanIn);
+}
+
+// K-way merge of an in-memory run and spilled runs, all sorted by ID. Counts
+// of equal IDs are summed before `emit` sees them, so only one record per run
+// is held in memory. Returns false if a run cannot be opened or is corrupt;
+// its counts would otherwise be silently missing.
+bool mergeOnce(const std::vector<IdCount>& inMemory,
+               const std::vector<std::string>& runPaths,
+               const std::function<bool(std::uint32_t, std::size_t)>& emit) {
+    std::vector<SpillReader> readers(runPaths.size());
+    // (id, count, source); source == readers.size() is the in-memory run.
+    using Head = std::tuple<std::uint32_t, std::size_t, std::size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+
+    std::size_t memoryPos = 0;
+    bool ok = true;
+    auto advance = [&](std::size_t source) {
+        if (source == readers.size()) {
+            if (memoryPos < inMemory.size()) {
+                heads.emplace(inMemory[memoryPos].first, inMemory[memoryPos].second, source);
+                ++memoryPos;
+            }
+            return;
+        }
+        IdCount record;
+        if (readers[source].next(record)) {
+            heads.emplace(record.first, record.second, source);
+        } else if (readers[source].failed()) {
+            ok = false;
+        }
+    };
+
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        if (!readers[i].open(runPaths[i])) {
+            return false;
+        }
+        advance(i);
+    }
+    advance(readers.size());
+
+    while (ok && !heads.empty()) {
+        std::uint32_t id = std::get<0>(heads.top());
+        std::size_t total = 0;
+        while (!heads.empty() && std::get<0>(heads.top()) == id) {
+            Head head = heads.top();
+            heads.pop();
+            total += std::get<1>(head);
+            advance(std::get<2>(head));
+        }
+        if (!emit(id, total)) {
+            return false;
+        }
+    }
+    return ok;
+}
+
+// Merges any number of runs with at most `fanIn` open at once: while there
+// are more, groups of `fanIn` are merged into intermediate runs next to the
+// first run of each group, pass after pass. Intermediate runs are removed
+// once consumed; the caller owns the original runs.
+bool mergeRuns(const std::vector<IdCount>& inMemory,
+               std::vector<std::string> runPaths,
+               std::size_t fanIn,
+               const std::function<void(std::uint32_t, std::size_t)>& emit) {
+    fanIn = std::max<std::size_t>(2, fanIn);
+    std::vector<std::string> intermediates;
+    auto removeIntermediates = [&]() {
+        for (const auto& path : intermediates) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+        intermediates.clear();
+    };
+
+    for (unsigned int pass = 1; runPaths.size() > fanIn; ++pass) {
+        // Keep intermediate runs in the codec of the spilled ones.
+        Codec codec = Codec::None;
+        {
+            SpillReader probe;
+            if (!probe.open(runPaths.front())) {
+                removeIntermediates();
+                return false;
+            }
+            codec = probe.codec();
+        }
 
-    std::map<std::string, std::size_t> accumulator;
+        std::vector<std::string> merged;
+        std::vector<std::string> consumed;
+        for (std::size_t first = 0; first < runPaths.size(); first += fanIn) {
+            std::vector<std::string> group(runPaths.begin() + static_cast<std::ptrdiff_t>(first),
+                                           runPaths.begin() + static_cast<std::ptrdiff_t>(
+                                               std::min(runPaths.size(), first + fanIn)));
+            if (group.size() == 1) {
+                merged.push_back(group.front());
+                continue;
+            }
+            std::string path = group.front() + ".m" + std::to_string(pass);
+            SpillWriter writer;
+            bool ok = writer.open(path, codec);
+            if (ok) {
+                intermediates.push_back(path);
+                ok = mergeOnce({}, group, [&writer](std::uint32_t id, std::size_t count) {
+                    return writer.add(id, count);
+                });
+                ok = writer.close() && ok;
+            }
+            if (!ok) {
+                removeIntermediates();
+                return false;
+            }
+            merged.push_back(path);
+            consumed.insert(consumed.end(), group.begin(), group.end());
+        }
+
+        // Inputs of this pass that were themselves intermediate are done.
+        for (const auto& path : consumed) {
+            auto it = std::find(intermediates.begin(), intermediates.end(), path);
+            if (it != intermediates.end()) {
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+                intermediates.erase(it);
+            }
+        }
+        runPaths.swap(merged);
+    }
+
+    bool ok = mergeOnce(inMemory, runPaths, [&emit](std::uint32_t id, std::size_t count) {
+        emit(id, count);
+        return true;
+    });
+    removeIntermediates();
+    return ok;
+}
+
+template <typename Pairs>
+std::vector<std::pair<std::string, std::size_t>> sumPairs(const Pairs& mappedPairs) {
+    std::map<std::string_view, std::size_t> accumulator;
 
     for (const auto& pair : mappedPairs) {
-        const std::string& word = pair.first;
         int value = pair.second;
         if (value != 0) {
-            accumulator[word] += static_cast<std::size_t>(value);
+            accumulator[std::string_view(pair.first)] += static_cast<std::size_t>(value);
         }
     }
 
@@ -17,8 +210,267 @@ std::vector<std::pair<std::string, std::size_t>> Reducer::reduce(
     result.reserve(accumulator.size());
 
     for (const auto& entry : accumulator) {
-        result.emplace_back(entry.first, entry.second);
+        result.emplace_back(std::string(entry.first), entry.second);
     }
 
     return result;
 }
+
+} // namespace
+
+std::vector<std::pair<std::string, std::size_t>> Reducer::reduce(
+    const std::vector<std::pair<std::string, int>>& mappedPairs) const {
+    return sumPairs(mappedPairs);
+}
+
+std::vector<std::pair<std::string, std::size_t>> Reducer::reduce(
+    const std::pmr::vector<std::pair<std::pmr::string, int>>& mappedPairs) const {
+    return sumPairs(mappedPairs);
+}
+
+void HotKeys::detect(const std::vector<const std::pmr::unordered_map<std::uint32_t, std::size_t>*>& tables,
+                     double fraction, unsigned int spread) {
+    keys_.clear();
+    index_.clear();
+    spread_ = std::max(1u, spread);
+
+    std::size_t total = 0;
+    std::unordered_map<std::uint32_t, std::size_t> candidates;
+    for (const auto* table : tables) {
+        std::size_t tableTotal = 0;
+        for (const auto& entry : *table) {
+            tableTotal += entry.second;
+        }
+        total += tableTotal;
+        for (const auto& entry : *table) {
+            if (static_cast<double>(entry.second) >= fraction * static_cast<double>(tableTotal)) {
+                candidates.emplace(entry.first, 0);
+            }
+        }
+    }
+    for (const auto* table : tables) {
+        for (auto& candidate : candidates) {
+            auto it = table->find(candidate.first);
+            if (it != table->end()) {
+                candidate.second += it->second;
+            }
+        }
+    }
+
+    for (const auto& candidate : candidates) {
+        if (total > 0 && static_cast<double>(candidate.second) >= fraction * static_cast<double>(total)) {
+            keys_.push_back(candidate);
+        }
+    }
+    std::sort(keys_.begin(), keys_.end(), [](const IdCount& a, const IdCount& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    for (const auto& key : keys_) {
+        index_.emplace(key.first, key.second);
+    }
+}
+
+bool HotKeys::empty() const {
+    return keys_.empty();
+}
+
+bool HotKeys::contains(std::uint32_t id) const {
+    return index_.count(id) != 0;
+}
+
+unsigned int HotKeys::partitionOf(std::uint32_t id, unsigned int salt, unsigned int partitions) const {
+    unsigned int spread = std::min(spread_, partitions);
+    return (Reducer::partitionOf(id, partitions) + salt % spread) % partitions;
+}
+
+const std::vector<IdCount>& HotKeys::keys() const {
+    return keys_;
+}
+
+// ---------------------------------------------------------------------------
+
+unsigned int Reducer::partitionOf(std::uint32_t id, unsigned int partitions) {
+    // Multiplicative mix: IDs carry their symbol-table shard in the low bits.
+    return static_cast<unsigned int>((id * 2654435761u) % partitions);
+}
+
+PartitionedCounts Reducer::partition(
+    const std::pmr::unordered_map<std::uint32_t, std::size_t>& counts,
+    unsigned int partitions,
+    const HotKeys* hot,
+    unsigned int salt) {
+
+    if (partitions == 0) {
+        partitions = 1;
+    }
+    PartitionedCounts result(partitions);
+    for (auto& slice : result) {
+        slice.reserve(counts.size() / partitions + 1);
+    }
+    for (const auto& entry : counts) {
+        unsigned int p = hot != nullptr && hot->contains(entry.first)
+            ? hot->partitionOf(entry.first, salt, partitions)
+            : partitionOf(entry.first, partitions);
+        result[p].push_back(entry);
+    }
+    return result;
+}
+
+std::vector<PartitionLoad> Reducer::partitionLoads(const std::vector<PartitionedCounts>& mapped) {
+    std::vector<PartitionLoad> loads;
+    for (const auto& worker : mapped) {
+        loads.resize(std::max(loads.size(), worker.size()));
+        for (std::size_t p = 0; p < worker.size(); ++p) {
+            loads[p].keys += worker[p].size();
+            for (const auto& entry : worker[p]) {
+                loads[p].values += entry.second;
+            }
+        }
+    }
+    return loads;
+}
+
+bool Reducer::reduceIds(
+    const std::vector<PartitionedCounts>& mapped,
+    const SymbolTable& symbols,
+    std::size_t k,
+    std::vector<std::pair<std::string, std::size_t>>& result,
+    const std::vector<std::vector<std::string>>& spillRuns,
+    const HotKeys* hot) const {
+    result.clear();
+
+    std::size_t partitions = spillRuns.size();
+    for (const auto& worker : mapped) {
+        partitions = std::max(partitions, worker.size());
+    }
+
+    std::vector<std::vector<RankedWord>> reduced(partitions);
+    std::vector<std::vector<IdCount>> hotPartials(partitions);
+    std::atomic<bool> failed{ false };
+    const std::size_t fanIn = fanInFor(partitions);
+
+    auto reducePartition = [&](std::size_t p) {
+        std::pmr::unsynchronized_pool_resource pool;
+        std::pmr::unordered_map<std::uint32_t, std::size_t> accumulator(&pool);
+        for (const auto& worker : mapped) {
+            if (p >= worker.size()) {
+                continue;
+            }
+            for (const auto& entry : worker[p]) {
+                accumulator[entry.first] += entry.second;
+            }
+        }
+
+        std::vector<RankedWord>& out = reduced[p];
+        auto emit = [&](std::uint32_t id, std::size_t count) {
+            if (hot != nullptr && hot->contains(id)) {
+                hotPartials[p].emplace_back(id, count);
+            } else if (k == 0) {
+                out.emplace_back(symbols.text(id), count);
+            } else {
+                offerBounded(out, RankedWord(symbols.text(id), count), k);
+            }
+        };
+
+        if (p < spillRuns.size() && !spillRuns[p].empty()) {
+            std::vector<IdCount> sorted(accumulator.begin(), accumulator.end());
+            accumulator.clear();
+            std::sort(sorted.begin(), sorted.end());
+            if (!mergeRuns(sorted, spillRuns[p], fanIn, emit)) {
+                failed = true;
+                return;
+            }
+        } else {
+            out.reserve(k == 0 ? accumulator.size() : std::min(k, accumulator.size()));
+            for (const auto& entry : accumulator) {
+                emit(entry.first, entry.second);
+            }
+        }
+
+        if (k == 0) {
+            std::sort(out.begin(), out.end());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t p = 0; p < partitions; ++p) {
+        threads.emplace_back(reducePartition, p);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (failed) {
+        std::cerr << "Reduce failed: spilled counts could not be merged\n";
+        return false;
+    }
+
+    // Final merge of salted keys: sum their partials from every partition
+    // and rank them like any other word.
+    std::vector<RankedWord> hotWords;
+    if (hot != nullptr && !hot->empty()) {
+        std::unordered_map<std::uint32_t, std::size_t> totals;
+        for (const auto& partials : hotPartials) {
+            for (const auto& entry : partials) {
+                totals[entry.first] += entry.second;
+            }
+        }
+        for (const auto& entry : totals) {
+            hotWords.emplace_back(symbols.text(entry.first), entry.second);
+        }
+        std::sort(hotWords.begin(), hotWords.end());
+    }
+
+    if (k > 0) {
+        std::vector<RankedWord> merged;
+        for (const auto& entry : hotWords) {
+            offerBounded(merged, entry, k);
+        }
+        for (const auto& heap : reduced) {
+            for (const auto& entry : heap) {
+                offerBounded(merged, entry, k);
+            }
+        }
+        result = materialize(merged);
+        return true;
+    }
+
+    // Partitions are sorted; one k-way merge over their heads writes the
+    // result in a single pass.
+    reduced.push_back(std::move(hotWords));
+    // (word, count, partition, position in the partition)
+    using Head = std::tuple<std::string_view, std::size_t, std::size_t, std::size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    std::size_t total = 0;
+    for (std::size_t p = 0; p < reduced.size(); ++p) {
+        total += reduced[p].size();
+        if (!reduced[p].empty()) {
+            heads.emplace(reduced[p][0].first, reduced[p][0].second, p, 0);
+        }
+    }
+
+    result.reserve(total);
+    while (!heads.empty()) {
+        auto [word, count, p, position] = heads.top();
+        heads.pop();
+        result.emplace_back(std::string(word), count);
+        if (++position < reduced[p].size()) {
+            heads.emplace(reduced[p][position].first, reduced[p][position].second, p, position);
+        }
+    }
+    return true;
+}
+
+std::vector<std::pair<std::string, std::size_t>> Reducer::selectTopK(
+    const std::vector<std::pair<std::string, std::size_t>>& wordCounts,
+    std::size_t k) {
+
+    std::vector<RankedWord> heap;
+    if (k == 0) {
+        return {};
+    }
+    heap.reserve(std::min(k, wordCounts.size()));
+    for (const auto& entry : wordCounts) {
+        offerBounded(heap, RankedWord(entry.first, entry.second), k);
+    }
+    return materialize(heap);
+}
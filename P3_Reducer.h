@@ -5,6 +5,50 @@
 #include <vector>
 #include <utility>
 #include <map>
+#include <unordered_map>
+#include <memory_resource>
+#include <cstdint>
+
+class SymbolTable;
+
+// Map-side aggregate of one worker: (word ID, count) pairs split by reduce
+// partition, so each reducer only reads its own slice of every worker.
+using IdCount = std::pair<std::uint32_t, std::size_t>;
+using PartitionedCounts = std::vector<std::vector<IdCount>>;
+
+// Heavy-hitter word IDs ("the", "and", ... in Zipfian text). Hash
+// partitioning sends all of a key's map output to one reducer; a hot key is
+// instead salted over `spread` consecutive partitions (the salt being the
+// worker ID), and reduceIds sums its partial counts in a final merge step.
+class HotKeys {
+public:
+    // Keys holding at least `fraction` of all counted words across the
+    // workers' map-side tables. A key that is hot overall is hot in at least
+    // one table, so only each table's own heavy entries are candidates.
+    void detect(const std::vector<const std::pmr::unordered_map<std::uint32_t, std::size_t>*>& tables,
+                double fraction, unsigned int spread);
+
+    bool empty() const;
+    bool contains(std::uint32_t id) const;
+
+    // Partition of the entry of `id` salted with `salt`.
+    unsigned int partitionOf(std::uint32_t id, unsigned int salt, unsigned int partitions) const;
+
+    // (word ID, map-side count), highest count first.
+    const std::vector<IdCount>& keys() const;
+
+private:
+    std::vector<IdCount> keys_;
+    std::unordered_map<std::uint32_t, std::size_t> index_;
+    unsigned int spread_ = 1;
+};
+
+// Map output received by one reduce partition: distinct entries (the work)
+// and the sum of their counts (the words they stand for).
+struct PartitionLoad {
+    std::size_t keys = 0;
+    std::size_t values = 0;
+};
 
 class Reducer {
 public:
@@ -13,6 +57,52 @@ public:
     // Aggregates all (word, 1) pairs into (word, totalCount).
     std::vector<std::pair<std::string, std::size_t>> reduce(
         const std::vector<std::pair<std::string, int>>& mappedPairs) const;
+
+    // Same for pairs held in a task arena; the result is heap-allocated so it
+    // can outlive the arena.
+    std::vector<std::pair<std::string, std::size_t>> reduce(
+        const std::pmr::vector<std::pair<std::pmr::string, int>>& mappedPairs) const;
+
+    // Reduce partition owning a word ID.
+    static unsigned int partitionOf(std::uint32_t id, unsigned int partitions);
+
+    // Splits one worker's (word ID, count) table into reduce partitions.
+    // Keys in `hot` go to their salted partition for `salt`.
+    static PartitionedCounts partition(
+        const std::pmr::unordered_map<std::uint32_t, std::size_t>& counts,
+        unsigned int partitions,
+        const HotKeys* hot = nullptr,
+        unsigned int salt = 0);
+
+    // Per-partition load of partitioned map output (spilled runs excluded).
+    static std::vector<PartitionLoad> partitionLoads(const std::vector<PartitionedCounts>& mapped);
+
+    // Reduces the partitioned map output of all workers. Each partition is
+    // summed on its own thread over word IDs; text is only resolved through
+    // `symbols` for the rows returned. With k == 0 the result is the full
+    // vocabulary sorted by word. Otherwise every partition keeps a bounded
+    // heap of size k, the heaps are merged, and the k most frequent words are
+    // returned ordered by count (descending) and then by word.
+    // `spillRuns[p]` lists sorted runs (see P3_SpillFile.h) spilled for
+    // partition p under memory pressure; they are merged by streaming with the
+    // in-memory slices, in several passes through intermediate runs when there
+    // are too many to keep open at once. Partial counts of keys in `hot` are
+    // held back by every partition and summed in a final merge step before
+    // ranking. Returns false (and an empty `result`) if a spill run cannot be
+    // read back in full.
+    bool reduceIds(
+        const std::vector<PartitionedCounts>& mapped,
+        const SymbolTable& symbols,
+        std::size_t k,
+        std::vector<std::pair<std::string, std::size_t>>& result,
+        const std::vector<std::vector<std::string>>& spillRuns = {},
+        const HotKeys* hot = nullptr) const;
+
+    // Selects the k most frequent entries of already reduced counts using a
+    // bounded heap, in the same order as reduceIds.
+    static std::vector<std::pair<std::string, std::size_t>> selectTopK(
+        const std::vector<std::pair<std::string, std::size_t>>& wordCounts,
+        std::size_t k);
 };
 
 #endif // REDUCER_H
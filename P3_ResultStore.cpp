@@ -0,0 +1,304 @@
+#include "P3_ResultStore.h"
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char kStoreMagic[8] = { 'M', 'R', 'S', 'T', 'O', 'R', 'E', '1' };
+const std::uint32_t kIndexStride = 64;
+const std::uint32_t kBloomBitsPerKey = 10;
+const std::uint32_t kBloomHashes = 7;
+
+struct StoreHeader {
+    char magic[8];
+    std::uint64_t entryCount;
+    std::uint64_t keyBlockOffset;
+    std::uint64_t keyBlockSize;
+    std::uint64_t indexOffset;
+    std::uint64_t indexCount;
+    std::uint64_t bloomOffset;   // 0 if there is no bloom filter
+    std::uint64_t bloomBits;
+    std::uint32_t bloomHashes;
+    std::uint32_t indexStride;
+};
+static_assert(sizeof(StoreHeader) == 72, "StoreHeader must not contain padding");
+
+const std::size_t kRecordHeaderSize = sizeof(std::uint32_t) + sizeof(std::uint64_t);
+
+template <typename T>
+T readAt(const unsigned char* base, std::size_t offset) {
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void append(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// 64-bit FNV-1a; the two halves seed double hashing for the bloom probes.
+std::uint64_t hashWord(std::string_view word) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::uint64_t bloomProbe(std::uint64_t hash, std::uint32_t i, std::uint64_t bits) {
+    std::uint64_t h1 = hash;
+    std::uint64_t h2 = (hash >> 32) | 1;
+    return (h1 + i * h2) % bits;
+}
+
+} // namespace
+
+bool ResultStoreWriter::write(const std::string& path,
+                              std::vector<std::pair<std::string, std::size_t>> wordCounts,
+                              bool withBloomFilter) {
+    auto byWord = [](const std::pair<std::string, std::size_t>& a,
+                     const std::pair<std::string, std::size_t>& b) {
+        return a.first < b.first;
+    };
+    if (!std::is_sorted(wordCounts.begin(), wordCounts.end(), byWord)) {
+        std::sort(wordCounts.begin(), wordCounts.end(), byWord);
+    }
+
+    std::string keyBlock;
+    std::string index;
+    for (std::size_t i = 0; i < wordCounts.size(); ++i) {
+        if (i % kIndexStride == 0) {
+            append<std::uint64_t>(index, keyBlock.size());
+        }
+        const auto& entry = wordCounts[i];
+        append<std::uint32_t>(keyBlock, static_cast<std::uint32_t>(entry.first.size()));
+        append<std::uint64_t>(keyBlock, entry.second);
+        keyBlock += entry.first;
+    }
+
+    std::vector<std::uint64_t> bloom;
+    std::uint64_t bloomBits = 0;
+    if (withBloomFilter && !wordCounts.empty()) {
+        bloomBits = ((wordCounts.size() * kBloomBitsPerKey + 63) / 64) * 64;
+        bloom.assign(static_cast<std::size_t>(bloomBits / 64), 0);
+        for (const auto& entry : wordCounts) {
+            std::uint64_t hash = hashWord(entry.first);
+            for (std::uint32_t i = 0; i < kBloomHashes; ++i) {
+                std::uint64_t bit = bloomProbe(hash, i, bloomBits);
+                bloom[static_cast<std::size_t>(bit / 64)] |= (1ULL << (bit % 64));
+            }
+        }
+    }
+
+    StoreHeader header{};
+    std::memcpy(header.magic, kStoreMagic, sizeof(kStoreMagic));
+    header.entryCount = wordCounts.size();
+    header.keyBlockOffset = sizeof(StoreHeader);
+    header.keyBlockSize = keyBlock.size();
+    header.indexOffset = header.keyBlockOffset + header.keyBlockSize;
+    header.indexCount = index.size() / sizeof(std::uint64_t);
+    header.bloomOffset = bloom.empty() ? 0 : header.indexOffset + index.size();
+    header.bloomBits = bloomBits;
+    header.bloomHashes = bloom.empty() ? 0 : kBloomHashes;
+    header.indexStride = kIndexStride;
+
+    // Readers may have the previous store mapped; replace it atomically.
+    AtomicOutputFile out;
+    if (!out.open(path)) {
+        return false;
+    }
+
+    bool ok = out.append(reinterpret_cast<const char*>(&header), sizeof(header)) &&
+              out.append(keyBlock.data(), keyBlock.size()) &&
+              out.append(index.data(), index.size()) &&
+              out.append(reinterpret_cast<const char*>(bloom.data()),
+                         bloom.size() * sizeof(std::uint64_t));
+    if (!ok) {
+        std::cerr << "Failed to write result store: " << path << "\n";
+        return false;
+    }
+    return out.commit();
+}
+
+bool ResultStore::open(const std::string& path) {
+    if (!file_.open(path) || file_.size() < sizeof(StoreHeader)) {
+        return false;
+    }
+
+    StoreHeader header = readAt<StoreHeader>(file_.data(), 0);
+    if (std::memcmp(header.magic, kStoreMagic, sizeof(kStoreMagic)) != 0 ||
+        header.indexStride == 0 ||
+        header.keyBlockOffset > file_.size() || header.keyBlockSize > file_.size() ||
+        header.indexOffset > file_.size() || header.indexCount > file_.size() / sizeof(std::uint64_t) ||
+        header.keyBlockOffset + header.keyBlockSize > file_.size() ||
+        header.indexOffset + header.indexCount * sizeof(std::uint64_t) > file_.size() ||
+        (header.bloomOffset != 0 && header.bloomOffset + header.bloomBits / 8 > file_.size())) {
+        file_.close();
+        return false;
+    }
+
+    // Sampled offsets must point at whole records inside the key block.
+    const std::uint64_t keyBlockSize = header.keyBlockSize;
+    for (std::uint64_t i = 0; i < header.indexCount; ++i) {
+        std::uint64_t offset = readAt<std::uint64_t>(file_.data(), header.indexOffset + i * sizeof(std::uint64_t));
+        if (offset >= keyBlockSize || keyBlockSize - offset < kRecordHeaderSize ||
+            readAt<std::uint32_t>(file_.data(), header.keyBlockOffset + offset) >
+                keyBlockSize - offset - kRecordHeaderSize) {
+            file_.close();
+            return false;
+        }
+    }
+
+    entryCount_ = static_cast<std::size_t>(header.entryCount);
+    keyBlock_ = file_.data() + header.keyBlockOffset;
+    keyBlockSize_ = static_cast<std::size_t>(header.keyBlockSize);
+    index_ = file_.data() + header.indexOffset;
+    indexCount_ = static_cast<std::size_t>(header.indexCount);
+    if (header.bloomOffset != 0 && header.bloomBits > 0) {
+        bloom_ = file_.data() + header.bloomOffset;
+        bloomBits_ = header.bloomBits;
+        bloomHashes_ = header.bloomHashes;
+    }
+    return true;
+}
+
+ResultStore::Record ResultStore::recordAt(std::size_t offset) const {
+    Record record;
+    // A record running past the key block ends every scan.
+    record.next = keyBlockSize_;
+    if (offset >= keyBlockSize_ || keyBlockSize_ - offset < kRecordHeaderSize) {
+        return record;
+    }
+    std::uint32_t length = readAt<std::uint32_t>(keyBlock_, offset);
+    if (length > keyBlockSize_ - offset - kRecordHeaderSize) {
+        return record;
+    }
+    record.count = static_cast<std::size_t>(
+        readAt<std::uint64_t>(keyBlock_, offset + sizeof(std::uint32_t)));
+    record.word = std::string_view(
+        reinterpret_cast<const char*>(keyBlock_ + offset + kRecordHeaderSize), length);
+    record.next = offset + kRecordHeaderSize + length;
+    record.valid = true;
+    return record;
+}
+
+std::string_view ResultStore::keyAt(std::size_t offset) const {
+    return recordAt(offset).word;
+}
+
+std::size_t ResultStore::lowerBound(std::string_view target) const {
+    if (indexCount_ == 0) {
+        return keyBlockSize_;
+    }
+
+    // Find the last sampled record whose word is < target, then scan forward
+    // at most one stride.
+    std::size_t low = 0;
+    std::size_t high = indexCount_;
+    while (low < high) {
+        std::size_t mid = low + (high - low) / 2;
+        std::size_t offset = static_cast<std::size_t>(
+            readAt<std::uint64_t>(index_, mid * sizeof(std::uint64_t)));
+        if (keyAt(offset) < target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    std::size_t offset = 0;
+    if (low > 0) {
+        offset = static_cast<std::size_t>(
+            readAt<std::uint64_t>(index_, (low - 1) * sizeof(std::uint64_t)));
+    }
+
+    while (offset < keyBlockSize_) {
+        Record record = recordAt(offset);
+        if (!record.valid || record.word >= target) {
+            break;
+        }
+        offset = record.next;
+    }
+    return offset;
+}
+
+bool ResultStore::mayContain(std::string_view word) const {
+    if (bloom_ == nullptr) {
+        return true;
+    }
+    std::uint64_t hash = hashWord(word);
+    for (std::uint32_t i = 0; i < bloomHashes_; ++i) {
+        std::uint64_t bit = bloomProbe(hash, i, bloomBits_);
+        if ((bloom_[bit / 8] & (1u << (bit % 8))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ResultStore::lookup(std::string_view word, std::size_t& count) const {
+    if (!file_.isOpen() || !mayContain(word)) {
+        return false;
+    }
+
+    std::size_t offset = lowerBound(word);
+    if (offset >= keyBlockSize_) {
+        return false;
+    }
+    Record record = recordAt(offset);
+    if (!record.valid || record.word != word) {
+        return false;
+    }
+    count = record.count;
+    return true;
+}
+
+std::vector<std::pair<std::string, std::size_t>> ResultStore::prefix(std::string_view prefix) const {
+    std::vector<std::pair<std::string, std::size_t>> results;
+    if (!file_.isOpen()) {
+        return results;
+    }
+
+    for (std::size_t offset = lowerBound(prefix); offset < keyBlockSize_;) {
+        Record record = recordAt(offset);
+        if (!record.valid || record.word.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        results.emplace_back(std::string(record.word), record.count);
+        offset = record.next;
+    }
+    return results;
+}
+
+std::vector<std::pair<std::string, std::size_t>> ResultStore::range(std::string_view first,
+                                                                    std::string_view last) const {
+    std::vector<std::pair<std::string, std::size_t>> results;
+    if (!file_.isOpen()) {
+        return results;
+    }
+
+    for (std::size_t offset = lowerBound(first); offset < keyBlockSize_;) {
+        Record record = recordAt(offset);
+        if (!record.valid || record.word > last) {
+            break;
+        }
+        results.emplace_back(std::string(record.word), record.count);
+        offset = record.next;
+    }
+    return results;
+}
+
+std::size_t ResultStore::size() const {
+    return entryCount_;
+}
+
+bool ResultStore::hasBloomFilter() const {
+    return bloom_ != nullptr;
+}
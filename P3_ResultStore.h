@@ -0,0 +1,75 @@
+#ifndef RESULTSTORE_H
+#define RESULTSTORE_H
+
+#include "P3_MappedFile.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Indexed word-count result file.
+//
+// Layout (little-endian, all offsets from the start of the file):
+//   header      StoreHeader
+//   key block   records sorted by word: [u32 length][u64 count][word bytes]
+//   index       u64 key-block offset of every `indexStride`-th record
+//   bloom       optional bit array (u64 words), `bloomHashes` probes per key
+//
+// Readers memory-map the file and binary-search the sparse index, so a
+// lookup touches only a handful of pages regardless of vocabulary size.
+class ResultStoreWriter {
+public:
+    // Write `wordCounts` as a result store. The input is sorted by word first
+    // if it is not already. Returns true on success.
+    static bool write(const std::string& path,
+                      std::vector<std::pair<std::string, std::size_t>> wordCounts,
+                      bool withBloomFilter);
+};
+
+class ResultStore {
+public:
+    // Map a store written by ResultStoreWriter. Returns false if the file is
+    // missing or not a valid store.
+    bool open(const std::string& path);
+
+    // Point lookup. Returns true and sets `count` if the word is present.
+    bool lookup(std::string_view word, std::size_t& count) const;
+
+    // All words starting with `prefix`, in word order.
+    std::vector<std::pair<std::string, std::size_t>> prefix(std::string_view prefix) const;
+
+    // All words w with first <= w <= last, in word order.
+    std::vector<std::pair<std::string, std::size_t>> range(std::string_view first,
+                                                           std::string_view last) const;
+
+    std::size_t size() const;
+    bool hasBloomFilter() const;
+
+private:
+    struct Record {
+        std::string_view word;
+        std::size_t count = 0;
+        std::size_t next = 0; // key-block offset of the following record
+        bool valid = false;   // false if the record runs past the key block
+    };
+
+    Record recordAt(std::size_t offset) const;
+    std::string_view keyAt(std::size_t offset) const;
+    // Key-block offset of the first record whose word is >= target.
+    std::size_t lowerBound(std::string_view target) const;
+    bool mayContain(std::string_view word) const;
+
+    MappedFile file_;
+    const unsigned char* keyBlock_ = nullptr;
+    std::size_t keyBlockSize_ = 0;
+    const unsigned char* index_ = nullptr;
+    std::size_t indexCount_ = 0;
+    const unsigned char* bloom_ = nullptr;
+    std::uint64_t bloomBits_ = 0;
+    std::uint32_t bloomHashes_ = 0;
+    std::size_t entryCount_ = 0;
+};
+
+#endif // RESULTSTORE_H
@@ -0,0 +1,516 @@
+#include "P3_Sketches.h"
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+const char kSketchMagic[8] = { 'M', 'R', 'S', 'K', 'E', 'T', 'C', 'H' };
+
+// Largest Count-Min table accepted from a file (2 GiB of counters).
+const std::uint64_t kMaxSketchCells = std::uint64_t(1) << 28;
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+void writeString(std::ostream& out, const std::string& s) {
+    writeValue<std::uint32_t>(out, static_cast<std::uint32_t>(s.size()));
+    out.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+bool readString(std::istream& in, std::string& s) {
+    std::uint32_t length = 0;
+    if (!readValue(in, length)) {
+        return false;
+    }
+    s.resize(length);
+    in.read(&s[0], static_cast<std::streamsize>(length));
+    return static_cast<bool>(in);
+}
+
+unsigned int leadingZeros(std::uint64_t value) {
+    unsigned int zeros = 0;
+    for (std::uint64_t bit = 1ULL << 63; bit != 0 && (value & bit) == 0; bit >>= 1) {
+        ++zeros;
+    }
+    return zeros;
+}
+
+} // namespace
+
+std::uint64_t sketchHash(std::string_view word) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    // splitmix64 finalizer: FNV alone leaves the high bits poorly mixed,
+    // which HyperLogLog relies on for register selection.
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+// ---------------------------------------------------------------------
+// CountMinSketch
+// ---------------------------------------------------------------------
+
+CountMinSketch::CountMinSketch(double epsilon, double delta)
+    : epsilon_(epsilon),
+      delta_(delta),
+      width_(static_cast<std::size_t>(std::ceil(std::exp(1.0) / epsilon))),
+      depth_(static_cast<std::size_t>(std::ceil(std::log(1.0 / delta)))),
+      table_(width_ * depth_, 0) {
+}
+
+std::size_t CountMinSketch::cell(std::size_t row, std::uint64_t hash) const {
+    // Kirsch-Mitzenmacher: derive `depth` row hashes from two halves.
+    std::uint64_t h1 = hash & 0xffffffffULL;
+    std::uint64_t h2 = (hash >> 32) | 1;
+    return row * width_ + static_cast<std::size_t>((h1 + row * h2) % width_);
+}
+
+void CountMinSketch::add(std::uint64_t hash, std::uint64_t count) {
+    for (std::size_t row = 0; row < depth_; ++row) {
+        table_[cell(row, hash)] += count;
+    }
+}
+
+std::uint64_t CountMinSketch::estimate(std::uint64_t hash) const {
+    std::uint64_t best = UINT64_MAX;
+    for (std::size_t row = 0; row < depth_; ++row) {
+        best = std::min(best, table_[cell(row, hash)]);
+    }
+    return depth_ == 0 ? 0 : best;
+}
+
+bool CountMinSketch::merge(const CountMinSketch& other) {
+    if (other.width_ != width_ || other.depth_ != depth_) {
+        return false;
+    }
+    for (std::size_t i = 0; i < table_.size(); ++i) {
+        table_[i] += other.table_[i];
+    }
+    return true;
+}
+
+double CountMinSketch::epsilon() const { return epsilon_; }
+double CountMinSketch::delta() const { return delta_; }
+std::size_t CountMinSketch::width() const { return width_; }
+std::size_t CountMinSketch::depth() const { return depth_; }
+
+void CountMinSketch::save(std::ostream& out) const {
+    writeValue<double>(out, epsilon_);
+    writeValue<double>(out, delta_);
+    writeValue<std::uint64_t>(out, width_);
+    writeValue<std::uint64_t>(out, depth_);
+    out.write(reinterpret_cast<const char*>(table_.data()),
+              static_cast<std::streamsize>(table_.size() * sizeof(std::uint64_t)));
+}
+
+bool CountMinSketch::load(std::istream& in) {
+    std::uint64_t width = 0;
+    std::uint64_t depth = 0;
+    if (!readValue(in, epsilon_) || !readValue(in, delta_) ||
+        !readValue(in, width) || !readValue(in, depth)) {
+        return false;
+    }
+    // The dimensions must be the ones the stored bounds give, so a corrupt
+    // header cannot make us allocate an arbitrary table.
+    if (!(epsilon_ > 0 && epsilon_ < 1) || !(delta_ > 0 && delta_ < 1)) {
+        return false;
+    }
+    if (static_cast<double>(width) != std::ceil(std::exp(1.0) / epsilon_) ||
+        static_cast<double>(depth) != std::ceil(std::log(1.0 / delta_)) ||
+        width == 0 || depth == 0 || width > kMaxSketchCells / depth) {
+        return false;
+    }
+    width_ = static_cast<std::size_t>(width);
+    depth_ = static_cast<std::size_t>(depth);
+    table_.assign(width_ * depth_, 0);
+    in.read(reinterpret_cast<char*>(table_.data()),
+            static_cast<std::streamsize>(table_.size() * sizeof(std::uint64_t)));
+    return static_cast<bool>(in);
+}
+
+// ---------------------------------------------------------------------
+// SpaceSaving
+// ---------------------------------------------------------------------
+
+SpaceSaving::SpaceSaving(std::size_t capacity)
+    : capacity_(capacity == 0 ? 1 : capacity) {
+}
+
+SpaceSaving::SpaceSaving(const SpaceSaving& other)
+    : capacity_(other.capacity_),
+      counters_(other.counters_) {
+    reindex();
+}
+
+SpaceSaving& SpaceSaving::operator=(const SpaceSaving& other) {
+    if (this != &other) {
+        capacity_ = other.capacity_;
+        counters_ = other.counters_;
+        reindex();
+    }
+    return *this;
+}
+
+void SpaceSaving::reindex() {
+    byCount_.clear();
+    for (const auto& entry : counters_) {
+        byCount_.insert({ entry.second.count, &entry.first });
+    }
+}
+
+std::uint64_t SpaceSaving::minCount() const {
+    return byCount_.empty() ? 0 : byCount_.begin()->first;
+}
+
+void SpaceSaving::set(const std::string& word, Counter counter) {
+    auto it = counters_.find(word);
+    if (it != counters_.end()) {
+        byCount_.erase({ it->second.count, &it->first });
+        it->second = counter;
+    } else {
+        it = counters_.emplace(word, counter).first;
+    }
+    byCount_.insert({ counter.count, &it->first });
+}
+
+void SpaceSaving::add(const std::string& word, std::uint64_t count) {
+    auto it = counters_.find(word);
+    if (it != counters_.end()) {
+        Counter counter = it->second;
+        counter.count += count;
+        set(word, counter);
+        return;
+    }
+
+    if (counters_.size() < capacity_) {
+        set(word, Counter{ count, 0 });
+        return;
+    }
+
+    // Replace the minimum counter; the new word inherits its count as error.
+    auto victim = byCount_.begin();
+    std::uint64_t floor = victim->first;
+    const std::string* victimWord = victim->second;
+    byCount_.erase(victim);
+    counters_.erase(*victimWord);
+    set(word, Counter{ floor + count, floor });
+}
+
+bool SpaceSaving::merge(const SpaceSaving& other) {
+    if (other.capacity_ != capacity_) {
+        return false;
+    }
+
+    // A word missing from a full summary may still have occurred up to that
+    // summary's minimum count, so that amount is added as both count and error.
+    std::uint64_t floorThis = counters_.size() >= capacity_ ? minCount() : 0;
+    std::uint64_t floorOther = other.counters_.size() >= other.capacity_ ? other.minCount() : 0;
+
+    std::unordered_map<std::string, Counter> combined;
+    for (const auto& entry : counters_) {
+        auto found = other.counters_.find(entry.first);
+        Counter c = entry.second;
+        if (found != other.counters_.end()) {
+            c.count += found->second.count;
+            c.error += found->second.error;
+        } else {
+            c.count += floorOther;
+            c.error += floorOther;
+        }
+        combined.emplace(entry.first, c);
+    }
+    for (const auto& entry : other.counters_) {
+        if (counters_.count(entry.first) == 0) {
+            Counter c = entry.second;
+            c.count += floorThis;
+            c.error += floorThis;
+            combined.emplace(entry.first, c);
+        }
+    }
+
+    std::vector<std::pair<std::string, Counter>> ranked(combined.begin(), combined.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.second.count != b.second.count ? a.second.count > b.second.count
+                                                : a.first < b.first;
+    });
+    if (ranked.size() > capacity_) {
+        ranked.resize(capacity_);
+    }
+
+    counters_.clear();
+    byCount_.clear();
+    for (const auto& entry : ranked) {
+        set(entry.first, entry.second);
+    }
+    return true;
+}
+
+std::vector<std::pair<std::string, SpaceSaving::Counter>> SpaceSaving::top(std::size_t k) const {
+    std::vector<std::pair<std::string, Counter>> result;
+    for (auto it = byCount_.rbegin(); it != byCount_.rend() && result.size() < k; ++it) {
+        result.emplace_back(*it->second, counters_.at(*it->second));
+    }
+    std::stable_sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.second.count != b.second.count ? a.second.count > b.second.count
+                                                : a.first < b.first;
+    });
+    return result;
+}
+
+std::size_t SpaceSaving::capacity() const {
+    return capacity_;
+}
+
+void SpaceSaving::save(std::ostream& out) const {
+    writeValue<std::uint64_t>(out, capacity_);
+    writeValue<std::uint64_t>(out, counters_.size());
+    for (const auto& entry : counters_) {
+        writeString(out, entry.first);
+        writeValue<std::uint64_t>(out, entry.second.count);
+        writeValue<std::uint64_t>(out, entry.second.error);
+    }
+}
+
+bool SpaceSaving::load(std::istream& in) {
+    std::uint64_t capacity = 0;
+    std::uint64_t size = 0;
+    if (!readValue(in, capacity) || !readValue(in, size)) {
+        return false;
+    }
+    if (capacity == 0 || size > capacity) {
+        return false;
+    }
+    capacity_ = static_cast<std::size_t>(capacity);
+    counters_.clear();
+    byCount_.clear();
+    for (std::uint64_t i = 0; i < size; ++i) {
+        std::string word;
+        Counter counter;
+        if (!readString(in, word) || !readValue(in, counter.count) || !readValue(in, counter.error)) {
+            return false;
+        }
+        set(word, counter);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// HyperLogLog
+// ---------------------------------------------------------------------
+
+HyperLogLog::HyperLogLog(unsigned int precision)
+    : precision_(std::min(18u, std::max(4u, precision))),
+      registers_(std::size_t(1) << precision_, 0) {
+}
+
+void HyperLogLog::add(std::uint64_t hash) {
+    std::size_t index = static_cast<std::size_t>(hash >> (64 - precision_));
+    std::uint64_t rest = hash << precision_;
+    unsigned int maxRank = 64 - precision_ + 1;
+    unsigned int rank = std::min(leadingZeros(rest) + 1, maxRank);
+    if (rank > registers_[index]) {
+        registers_[index] = static_cast<std::uint8_t>(rank);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    const double m = static_cast<double>(registers_.size());
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    if (registers_.size() == 16) alpha = 0.673;
+    else if (registers_.size() == 32) alpha = 0.697;
+    else if (registers_.size() == 64) alpha = 0.709;
+
+    double sum = 0.0;
+    std::size_t zeros = 0;
+    for (std::uint8_t r : registers_) {
+        sum += std::ldexp(1.0, -static_cast<int>(r));
+        if (r == 0) {
+            ++zeros;
+        }
+    }
+
+    double raw = alpha * m * m / sum;
+    if (raw <= 2.5 * m && zeros > 0) {
+        // Small-range correction (linear counting).
+        return m * std::log(m / static_cast<double>(zeros));
+    }
+    return raw;
+}
+
+bool HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.precision_ != precision_) {
+        return false;
+    }
+    for (std::size_t i = 0; i < registers_.size(); ++i) {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+    return true;
+}
+
+unsigned int HyperLogLog::precision() const {
+    return precision_;
+}
+
+double HyperLogLog::standardError() const {
+    return 1.04 / std::sqrt(static_cast<double>(registers_.size()));
+}
+
+void HyperLogLog::save(std::ostream& out) const {
+    writeValue<std::uint32_t>(out, precision_);
+    out.write(reinterpret_cast<const char*>(registers_.data()),
+              static_cast<std::streamsize>(registers_.size()));
+}
+
+bool HyperLogLog::load(std::istream& in) {
+    std::uint32_t precision = 0;
+    if (!readValue(in, precision) || precision < 4 || precision > 18) {
+        return false;
+    }
+    precision_ = precision;
+    registers_.assign(std::size_t(1) << precision_, 0);
+    in.read(reinterpret_cast<char*>(registers_.data()),
+            static_cast<std::streamsize>(registers_.size()));
+    return static_cast<bool>(in);
+}
+
+// ---------------------------------------------------------------------
+// WordSketch
+// ---------------------------------------------------------------------
+
+WordSketch::WordSketch(const ApproximateOptions& options)
+    : options_(options),
+      countMin_(options.epsilon, options.delta),
+      heavyHitters_(options.heavyHitters),
+      distinct_(options.hllPrecision) {
+}
+
+void WordSketch::add(const std::string& word) {
+    std::uint64_t hash = sketchHash(word);
+    ++totalWords_;
+    countMin_.add(hash);
+    heavyHitters_.add(word);
+    distinct_.add(hash);
+}
+
+bool WordSketch::merge(const WordSketch& other) {
+    if (countMin_.width() != other.countMin_.width() ||
+        countMin_.depth() != other.countMin_.depth() ||
+        heavyHitters_.capacity() != other.heavyHitters_.capacity() ||
+        distinct_.precision() != other.distinct_.precision()) {
+        return false;
+    }
+    countMin_.merge(other.countMin_);
+    heavyHitters_.merge(other.heavyHitters_);
+    distinct_.merge(other.distinct_);
+    totalWords_ += other.totalWords_;
+    return true;
+}
+
+std::uint64_t WordSketch::totalWords() const {
+    return totalWords_;
+}
+
+std::uint64_t WordSketch::estimateCount(std::string_view word) const {
+    return countMin_.estimate(sketchHash(word));
+}
+
+double WordSketch::estimateDistinct() const {
+    return distinct_.estimate();
+}
+
+bool WordSketch::writeReport(const std::string& path, std::size_t k) const {
+    std::ostringstream out;
+
+    std::uint64_t cmsBound = static_cast<std::uint64_t>(
+        std::ceil(countMin_.epsilon() * static_cast<double>(totalWords_)));
+    std::uint64_t ssBound = totalWords_ / heavyHitters_.capacity();
+    double distinct = distinct_.estimate();
+
+    out << "# approximate word count\n";
+    out << "# total words: " << totalWords_ << "\n";
+    out << "# distinct words: ~" << static_cast<std::uint64_t>(std::llround(distinct))
+        << " (HyperLogLog p=" << distinct_.precision()
+        << " standard error " << distinct_.standardError() * 100.0 << "%)\n";
+    out << "# counts: Count-Min " << countMin_.width() << "x" << countMin_.depth()
+        << " - overestimate by at most " << cmsBound
+        << " (epsilon " << countMin_.epsilon() << ") with probability "
+        << (1.0 - countMin_.delta()) << "\n";
+    // The guarantee covers the whole summary, so it only holds for a full listing.
+    std::size_t limit = k == 0 ? heavyHitters_.capacity() : std::min(k, heavyHitters_.capacity());
+    out << "# heavy hitters: Space-Saving capacity " << heavyHitters_.capacity();
+    if (limit < heavyHitters_.capacity()) {
+        out << " - the " << limit << " most frequent are listed\n";
+    } else {
+        out << " - every word above " << ssBound << " occurrences is listed\n";
+    }
+
+    for (const auto& entry : heavyHitters_.top(limit)) {
+        // Both summaries overestimate, so the smaller value is the tighter one.
+        std::uint64_t estimate = std::min(entry.second.count, estimateCount(entry.first));
+        out << entry.first << "," << estimate << "\n";
+    }
+
+    // Replace any previous report atomically.
+    const std::string text = out.str();
+    AtomicOutputFile file;
+    if (!file.open(path) || !file.append(text.data(), text.size()) || !file.commit()) {
+        std::cerr << "Failed to write report: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool WordSketch::save(const std::string& path) const {
+    std::ostringstream out(std::ios::binary);
+    out.write(kSketchMagic, sizeof(kSketchMagic));
+    writeValue<std::uint64_t>(out, totalWords_);
+    countMin_.save(out);
+    heavyHitters_.save(out);
+    distinct_.save(out);
+
+    const std::string bytes = out.str();
+    AtomicOutputFile file;
+    if (!file.open(path) || !file.append(bytes.data(), bytes.size()) || !file.commit()) {
+        std::cerr << "Failed to write sketch: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool WordSketch::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kSketchMagic)] = {};
+    if (!in.is_open() || !in.read(magic, sizeof(magic)) ||
+        !std::equal(magic, magic + sizeof(magic), kSketchMagic)) {
+        return false;
+    }
+    if (!readValue(in, totalWords_) || !countMin_.load(in) ||
+        !heavyHitters_.load(in) || !distinct_.load(in)) {
+        return false;
+    }
+    options_.epsilon = countMin_.epsilon();
+    options_.delta = countMin_.delta();
+    options_.heavyHitters = heavyHitters_.capacity();
+    options_.hllPrecision = distinct_.precision();
+    return true;
+}
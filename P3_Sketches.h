@@ -0,0 +1,146 @@
+#ifndef SKETCHES_H
+#define SKETCHES_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <set>
+#include <unordered_map>
+#include <cstdint>
+#include <iosfwd>
+
+// Fixed-memory, mergeable summaries for approximate word counting.
+// Two sketches can only be merged if they were built with the same
+// parameters; merge() returns false otherwise.
+
+// 64-bit hash shared by all sketches (FNV-1a followed by a finalizer mix).
+std::uint64_t sketchHash(std::string_view word);
+
+// Count-Min Sketch: estimates never undercount, and overcount by at most
+// epsilon * N with probability 1 - delta (N = total items added).
+class CountMinSketch {
+public:
+    CountMinSketch(double epsilon, double delta);
+
+    void add(std::uint64_t hash, std::uint64_t count = 1);
+    std::uint64_t estimate(std::uint64_t hash) const;
+    bool merge(const CountMinSketch& other);
+
+    double epsilon() const;
+    double delta() const;
+    std::size_t width() const;
+    std::size_t depth() const;
+
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+
+private:
+    std::size_t cell(std::size_t row, std::uint64_t hash) const;
+
+    double epsilon_;
+    double delta_;
+    std::size_t width_;
+    std::size_t depth_;
+    std::vector<std::uint64_t> table_;
+};
+
+// Space-Saving heavy hitters: tracks at most `capacity` words. Every word
+// with true frequency above N / capacity is guaranteed to be tracked, and a
+// tracked count overestimates the true count by at most its `error`.
+class SpaceSaving {
+public:
+    struct Counter {
+        std::uint64_t count = 0;
+        std::uint64_t error = 0;
+    };
+
+    explicit SpaceSaving(std::size_t capacity);
+
+    // byCount_ points into counters_, so a copy rebuilds it over its own keys.
+    SpaceSaving(const SpaceSaving& other);
+    SpaceSaving& operator=(const SpaceSaving& other);
+    SpaceSaving(SpaceSaving&&) = default;
+    SpaceSaving& operator=(SpaceSaving&&) = default;
+
+    void add(const std::string& word, std::uint64_t count = 1);
+    bool merge(const SpaceSaving& other);
+
+    // Tracked words ordered by count, highest first.
+    std::vector<std::pair<std::string, Counter>> top(std::size_t k) const;
+
+    std::size_t capacity() const;
+
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+
+private:
+    std::uint64_t minCount() const;
+    void set(const std::string& word, Counter counter);
+    void reindex();
+
+    std::size_t capacity_;
+    std::unordered_map<std::string, Counter> counters_;
+    // Ordered by count; points at the keys of counters_, which are stable.
+    std::set<std::pair<std::uint64_t, const std::string*>> byCount_;
+};
+
+// HyperLogLog distinct counter with 2^precision registers; relative
+// standard error is about 1.04 / sqrt(2^precision).
+class HyperLogLog {
+public:
+    explicit HyperLogLog(unsigned int precision);
+
+    void add(std::uint64_t hash);
+    double estimate() const;
+    bool merge(const HyperLogLog& other);
+
+    unsigned int precision() const;
+    double standardError() const;
+
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+
+private:
+    unsigned int precision_;
+    std::vector<std::uint8_t> registers_;
+};
+
+// Error bounds and sizes for an approximate job.
+struct ApproximateOptions {
+    double epsilon = 0.0001;        // Count-Min relative error (of total tokens)
+    double delta = 0.01;            // Count-Min failure probability
+    std::size_t heavyHitters = 1000; // Space-Saving capacity
+    unsigned int hllPrecision = 14; // HyperLogLog registers = 2^precision
+};
+
+// The three sketches maintained per worker in approximate mode.
+class WordSketch {
+public:
+    explicit WordSketch(const ApproximateOptions& options);
+
+    void add(const std::string& word);
+    bool merge(const WordSketch& other);
+
+    std::uint64_t totalWords() const;
+    std::uint64_t estimateCount(std::string_view word) const;
+    double estimateDistinct() const;
+
+    // Writes the top `k` words (0 = all heavy hitters) with their error
+    // guarantees. Lines starting with '#' describe the bounds; data rows are
+    // "word,estimate". Returns false if the file cannot be written.
+    bool writeReport(const std::string& path, std::size_t k) const;
+
+    // Binary serialization so sketches from different nodes can be merged.
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    ApproximateOptions options_;
+    std::uint64_t totalWords_ = 0;
+    CountMinSketch countMin_;
+    SpaceSaving heavyHitters_;
+    HyperLogLog distinct_;
+};
+
+#endif // SKETCHES_H
@@ -0,0 +1,530 @@
+#include "P3_Sort.h"
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::uint64_t kChunkRecords = 160 * 1024;  // ~16 MB of records per task
+const unsigned int kMaxPartitions = 512;         // shuffle files open at once
+
+struct InputFile {
+    std::string path;
+    std::uint64_t records;
+    std::uint64_t firstRecord;  // across all files
+};
+
+// A run of records of one file, read as one task.
+struct Chunk {
+    std::size_t file;
+    std::uint64_t first;  // within the file
+    std::uint64_t count;
+};
+
+// A file, or the regular files of a directory in name order. Every file
+// must hold whole records.
+bool listRecordFiles(const std::string& input, std::vector<InputFile>& files) {
+    std::error_code ec;
+    std::vector<std::string> paths;
+    if (std::filesystem::is_directory(input, ec)) {
+        for (const auto& entry : std::filesystem::directory_iterator(input, ec)) {
+            if (entry.is_regular_file()) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+    } else if (std::filesystem::is_regular_file(input, ec)) {
+        paths.push_back(input);
+    } else {
+        std::cerr << "Sort input does not exist: " << input << "\n";
+        return false;
+    }
+
+    std::uint64_t total = 0;
+    for (const auto& path : paths) {
+        std::uint64_t size = std::filesystem::file_size(path, ec);
+        if (ec || size % kSortRecordBytes != 0) {
+            std::cerr << "Not a file of " << kSortRecordBytes << "-byte records: " << path << "\n";
+            return false;
+        }
+        files.push_back({ path, size / kSortRecordBytes, total });
+        total += size / kSortRecordBytes;
+    }
+    return true;
+}
+
+std::vector<Chunk> chunksOf(const std::vector<InputFile>& files) {
+    std::vector<Chunk> chunks;
+    for (std::size_t f = 0; f < files.size(); ++f) {
+        for (std::uint64_t first = 0; first < files[f].records; first += kChunkRecords) {
+            chunks.push_back({ f, first, std::min(kChunkRecords, files[f].records - first) });
+        }
+    }
+    return chunks;
+}
+
+// Reads chunks, keeping the current file open between calls.
+class ChunkReader {
+public:
+    explicit ChunkReader(const std::vector<InputFile>& files) : files_(files) {}
+
+    bool read(const Chunk& chunk, std::vector<char>& records) {
+        if (chunk.file != open_) {
+            in_.close();
+            in_.clear();
+            in_.open(files_[chunk.file].path, std::ios::binary);
+            open_ = chunk.file;
+        }
+        records.resize(static_cast<std::size_t>(chunk.count * kSortRecordBytes));
+        in_.seekg(static_cast<std::streamoff>(chunk.first * kSortRecordBytes));
+        in_.read(records.data(), static_cast<std::streamsize>(records.size()));
+        if (!in_) {
+            std::cerr << "Failed to read records from: " << files_[chunk.file].path << "\n";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const std::vector<InputFile>& files_;
+    std::ifstream in_;
+    std::size_t open_ = static_cast<std::size_t>(-1);
+};
+
+// Runs fn() on `workers` threads and waits for them.
+template <typename Fn>
+void runWorkers(unsigned int workers, Fn&& fn) {
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < workers; ++i) {
+        threads.emplace_back(fn);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::uint64_t splitMix(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+std::uint64_t recordHash(const char* record) {
+    std::uint64_t hash = 1469598103934665603ULL;
+    for (std::size_t i = 0; i < kSortRecordBytes; ++i) {
+        hash ^= static_cast<unsigned char>(record[i]);
+        hash *= 1099511628211ULL;
+    }
+    return splitMix(hash);
+}
+
+// Record `number` in the gensort ASCII layout.
+void makeRecord(std::uint64_t number, char* record) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::uint64_t random[2] = { splitMix(number * 2), splitMix(number * 2 + 1) };
+    for (std::size_t i = 0; i < kSortKeyBytes; ++i) {
+        std::uint64_t& bits = random[i / 5];
+        record[i] = static_cast<char>(' ' + bits % 95);  // printable ASCII
+        bits /= 95;
+    }
+    char* p = record + kSortKeyBytes;
+    *p++ = ' ';
+    *p++ = ' ';
+    for (int i = 0; i < 16; ++i) {
+        *p++ = '0';
+    }
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        *p++ = hex[(number >> shift) & 15];
+    }
+    *p++ = ' ';
+    *p++ = ' ';
+    for (int i = 0; i < 52; ++i) {
+        *p++ = hex[(number + static_cast<std::uint64_t>(i / 4)) & 15];
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+}
+
+using Key = std::array<char, kSortKeyBytes>;
+
+bool keyLess(const char* a, const char* b) {
+    return std::memcmp(a, b, kSortKeyBytes) < 0;
+}
+
+// Partition of a key: the number of split points not above it.
+std::size_t partitionOf(const char* key, const std::vector<Key>& splits) {
+    auto it = std::upper_bound(splits.begin(), splits.end(), key,
+                               [](const char* k, const Key& split) { return keyLess(k, split.data()); });
+    return static_cast<std::size_t>(it - splits.begin());
+}
+
+// A key unpacked for radix sorting: bytes 0-7 big-endian in `high`, bytes
+// 8-9 in `low`, and the record it came from.
+struct KeyEntry {
+    std::uint64_t high;
+    std::uint32_t index;
+    std::uint16_t low;
+};
+
+unsigned int digitOf(const KeyEntry& entry, std::size_t d) {
+    return d < 8 ? static_cast<unsigned int>((entry.high >> (56 - 8 * d)) & 0xff)
+                 : static_cast<unsigned int>((entry.low >> (8 * (9 - d))) & 0xff);
+}
+
+// LSD radix sort, one byte per pass from the last key byte to the first.
+// All histograms are built in one read; passes where every key has the
+// same byte are skipped. Stable, so equal keys keep their input order.
+void radixSort(std::vector<KeyEntry>& entries, std::vector<KeyEntry>& scratch) {
+    std::vector<std::array<std::size_t, 256>> counts(kSortKeyBytes);
+    for (auto& histogram : counts) {
+        histogram.fill(0);
+    }
+    for (const KeyEntry& entry : entries) {
+        for (std::size_t d = 0; d < kSortKeyBytes; ++d) {
+            ++counts[d][digitOf(entry, d)];
+        }
+    }
+
+    scratch.resize(entries.size());
+    for (std::size_t d = kSortKeyBytes; d-- > 0;) {
+        std::array<std::size_t, 256>& histogram = counts[d];
+        if (entries.empty() || histogram[digitOf(entries[0], d)] == entries.size()) {
+            continue;
+        }
+        std::size_t offset = 0;
+        for (std::size_t& count : histogram) {
+            std::size_t n = count;
+            count = offset;
+            offset += n;
+        }
+        for (const KeyEntry& entry : entries) {
+            scratch[histogram[digitOf(entry, d)]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+
+bool teraGen(const std::string& output, std::uint64_t records, std::uint64_t first,
+             unsigned int workers) {
+    std::filesystem::path parent = std::filesystem::path(output).parent_path();
+    if (!parent.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(parent, ec);
+    }
+    AtomicOutputFile out;
+    if (!out.open(output)) {
+        return false;
+    }
+
+    const std::uint64_t chunks = (records + kChunkRecords - 1) / kChunkRecords;
+    std::atomic<std::uint64_t> next{ 0 };
+    std::atomic<bool> ok{ true };
+    runWorkers(std::max(1u, workers), [&]() {
+        std::vector<char> buffer;
+        for (std::uint64_t c = next++; c < chunks && ok; c = next++) {
+            std::uint64_t begin = c * kChunkRecords;
+            std::uint64_t count = std::min(kChunkRecords, records - begin);
+            buffer.resize(static_cast<std::size_t>(count * kSortRecordBytes));
+            for (std::uint64_t i = 0; i < count; ++i) {
+                makeRecord(first + begin + i, buffer.data() + i * kSortRecordBytes);
+            }
+            if (!out.writeAt(begin * kSortRecordBytes, buffer.data(), buffer.size())) {
+                ok = false;
+            }
+        }
+    });
+    return ok && out.commit();
+}
+
+// ---------------------------------------------------------------------------
+
+bool teraSort(const std::string& input, const std::string& output, const SortOptions& options,
+              SortReport& report) {
+    report = SortReport();
+    const unsigned int workers = std::max(1u, options.workers);
+    std::vector<InputFile> files;
+    if (!listRecordFiles(input, files)) {
+        return false;
+    }
+    const std::uint64_t total = files.empty() ? 0 : files.back().firstRecord + files.back().records;
+    report.records = total;
+
+    // A partition is sorted in memory: its records, two key arrays and its
+    // output, about three times its size. Partitions are sized so one fits
+    // a worker's share of the budget.
+    unsigned int partitions = options.partitions > 0 ? options.partitions : workers;
+    if (options.memoryLimit > 0) {
+        std::uint64_t share = std::max<std::uint64_t>(1, options.memoryLimit / workers);
+        std::uint64_t needed = (3 * total * kSortRecordBytes + share - 1) / share;
+        partitions = static_cast<unsigned int>(std::max<std::uint64_t>(partitions, needed));
+    }
+    partitions = std::min(partitions, kMaxPartitions);
+    report.partitions = partitions;
+
+    // 1. Sample keys at evenly spaced records and take every
+    //    (samples / partitions)-th one as a split point.
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Key> samples;
+    std::uint64_t sampleCount = std::min<std::uint64_t>(std::max<std::size_t>(options.samples, partitions), total);
+    {
+        std::size_t file = 0;
+        std::ifstream in;
+        for (std::uint64_t i = 0; i < sampleCount; ++i) {
+            std::uint64_t record = i * total / sampleCount;
+            while (record >= files[file].firstRecord + files[file].records) {
+                ++file;
+                in.close();
+            }
+            if (!in.is_open()) {
+                in.clear();
+                in.open(files[file].path, std::ios::binary);
+            }
+            Key key;
+            in.seekg(static_cast<std::streamoff>((record - files[file].firstRecord) * kSortRecordBytes));
+            in.read(key.data(), static_cast<std::streamsize>(kSortKeyBytes));
+            if (!in) {
+                std::cerr << "Failed to sample records from: " << files[file].path << "\n";
+                return false;
+            }
+            samples.push_back(key);
+        }
+    }
+    std::sort(samples.begin(), samples.end(),
+              [](const Key& a, const Key& b) { return keyLess(a.data(), b.data()); });
+    std::vector<Key> splits;
+    for (unsigned int p = 1; p < partitions && !samples.empty(); ++p) {
+        splits.push_back(samples[static_cast<std::size_t>(p * samples.size() / partitions)]);
+    }
+    report.sampleSeconds = secondsSince(start);
+
+    // 2. Range-partition every record into a shuffle file per partition.
+    start = std::chrono::steady_clock::now();
+    std::filesystem::path tempDir = options.tempDir.empty()
+        ? std::filesystem::path(output).parent_path() / "sort-tmp"
+        : std::filesystem::path(options.tempDir);
+    std::error_code ec;
+    std::filesystem::create_directories(tempDir, ec);
+    auto shufflePath = [&](unsigned int p) {
+        return (tempDir / ("sort-" + std::to_string(p) + ".part")).string();
+    };
+    auto removeShuffle = [&]() {
+        for (unsigned int p = 0; p < partitions; ++p) {
+            std::filesystem::remove(shufflePath(p), ec);
+        }
+        std::filesystem::remove(tempDir, ec);  // only if empty
+    };
+
+    std::vector<std::ofstream> shuffle(partitions);
+    std::unique_ptr<std::mutex[]> shuffleMutex(new std::mutex[partitions]);
+    std::vector<std::uint64_t> partitionRecords(partitions, 0);
+    for (unsigned int p = 0; p < partitions; ++p) {
+        shuffle[p].open(shufflePath(p), std::ios::binary | std::ios::trunc);
+        if (!shuffle[p].is_open()) {
+            std::cerr << "Failed to create shuffle file: " << shufflePath(p) << "\n";
+            removeShuffle();
+            return false;
+        }
+    }
+
+    const std::vector<Chunk> chunks = chunksOf(files);
+    std::atomic<std::size_t> nextChunk{ 0 };
+    std::atomic<bool> ok{ true };
+    runWorkers(workers, [&]() {
+        ChunkReader reader(files);
+        std::vector<char> records;
+        std::vector<std::vector<char>> routed(partitions);
+        for (std::size_t c = nextChunk++; c < chunks.size() && ok; c = nextChunk++) {
+            if (!reader.read(chunks[c], records)) {
+                ok = false;
+                break;
+            }
+            for (const char* record = records.data(); record < records.data() + records.size();
+                 record += kSortRecordBytes) {
+                std::vector<char>& bucket = routed[partitionOf(record, splits)];
+                bucket.insert(bucket.end(), record, record + kSortRecordBytes);
+            }
+            for (unsigned int p = 0; p < partitions; ++p) {
+                if (routed[p].empty()) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(shuffleMutex[p]);
+                shuffle[p].write(routed[p].data(), static_cast<std::streamsize>(routed[p].size()));
+                partitionRecords[p] += routed[p].size() / kSortRecordBytes;
+                routed[p].clear();
+            }
+        }
+    });
+    for (auto& file : shuffle) {
+        file.close();
+        if (!file) {
+            std::cerr << "Failed to write shuffle files in " << tempDir.string() << "\n";
+            ok = false;
+        }
+    }
+    if (!ok) {
+        removeShuffle();
+        return false;
+    }
+    report.shuffleSeconds = secondsSince(start);
+
+    // 3. Sort each partition and write it at its offset: the sizes are
+    //    known, so partitions finish in any order.
+    start = std::chrono::steady_clock::now();
+    std::vector<std::uint64_t> offsets(partitions, 0);
+    for (unsigned int p = 1; p < partitions; ++p) {
+        offsets[p] = offsets[p - 1] + partitionRecords[p - 1] * kSortRecordBytes;
+    }
+    report.largestPartition = *std::max_element(partitionRecords.begin(), partitionRecords.end());
+
+    std::filesystem::path parent = std::filesystem::path(output).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, ec);
+    }
+    AtomicOutputFile out;
+    if (!out.open(output)) {
+        removeShuffle();
+        return false;
+    }
+
+    std::atomic<unsigned int> nextPartition{ 0 };
+    runWorkers(std::min(workers, partitions), [&]() {
+        std::vector<char> records, sorted;
+        std::vector<KeyEntry> entries, scratch;
+        for (unsigned int p = nextPartition++; p < partitions && ok; p = nextPartition++) {
+            std::ifstream in(shufflePath(p), std::ios::binary);
+            records.resize(static_cast<std::size_t>(partitionRecords[p] * kSortRecordBytes));
+            in.read(records.data(), static_cast<std::streamsize>(records.size()));
+            if (!in && !records.empty()) {
+                std::cerr << "Failed to read shuffle file: " << shufflePath(p) << "\n";
+                ok = false;
+                break;
+            }
+            in.close();
+            std::filesystem::remove(shufflePath(p), ec);
+
+            const std::size_t count = static_cast<std::size_t>(partitionRecords[p]);
+            entries.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                const unsigned char* key = reinterpret_cast<const unsigned char*>(records.data() + i * kSortRecordBytes);
+                std::uint64_t high = 0;
+                for (std::size_t b = 0; b < 8; ++b) {
+                    high = (high << 8) | key[b];
+                }
+                entries[i] = { high, static_cast<std::uint32_t>(i),
+                               static_cast<std::uint16_t>((key[8] << 8) | key[9]) };
+            }
+            radixSort(entries, scratch);
+
+            sorted.resize(records.size());
+            for (std::size_t i = 0; i < count; ++i) {
+                std::memcpy(sorted.data() + i * kSortRecordBytes,
+                            records.data() + static_cast<std::size_t>(entries[i].index) * kSortRecordBytes,
+                            kSortRecordBytes);
+            }
+            if (!sorted.empty() && !out.writeAt(offsets[p], sorted.data(), sorted.size())) {
+                ok = false;
+            }
+        }
+    });
+    removeShuffle();
+    report.sortSeconds = secondsSince(start);
+
+    if (!ok) {
+        return false;
+    }
+    return out.commit();
+}
+
+// ---------------------------------------------------------------------------
+
+bool teraValidate(const std::string& input, unsigned int workers, ValidateReport& report) {
+    report = ValidateReport();
+    std::vector<InputFile> files;
+    if (!listRecordFiles(input, files)) {
+        return false;
+    }
+
+    // Chunks are checked in parallel; order across chunk boundaries is
+    // checked afterwards from each chunk's first and last key.
+    struct ChunkResult {
+        ValidateReport report;
+        Key firstKey{};
+        Key lastKey{};
+    };
+    const std::vector<Chunk> chunks = chunksOf(files);
+    std::vector<ChunkResult> results(chunks.size());
+    std::atomic<std::size_t> next{ 0 };
+    std::atomic<bool> ok{ true };
+    runWorkers(std::max(1u, workers), [&]() {
+        ChunkReader reader(files);
+        std::vector<char> records;
+        for (std::size_t c = next++; c < chunks.size() && ok; c = next++) {
+            if (!reader.read(chunks[c], records)) {
+                ok = false;
+                break;
+            }
+            ChunkResult& result = results[c];
+            const std::uint64_t base = files[chunks[c].file].firstRecord + chunks[c].first;
+            const char* previous = nullptr;
+            for (std::uint64_t i = 0; i < chunks[c].count; ++i) {
+                const char* record = records.data() + i * kSortRecordBytes;
+                result.report.checksum += recordHash(record);
+                if (previous != nullptr) {
+                    int order = std::memcmp(previous, record, kSortKeyBytes);
+                    if (order > 0 && result.report.unordered++ == 0) {
+                        result.report.firstUnordered = base + i;
+                    } else if (order == 0) {
+                        ++result.report.duplicateKeys;
+                    }
+                }
+                previous = record;
+            }
+            result.report.records = chunks[c].count;
+            std::memcpy(result.firstKey.data(), records.data(), kSortKeyBytes);
+            std::memcpy(result.lastKey.data(), previous, kSortKeyBytes);
+        }
+    });
+    if (!ok) {
+        return false;
+    }
+
+    for (std::size_t c = 0; c < results.size(); ++c) {
+        const ValidateReport& part = results[c].report;
+        if (c > 0) {
+            int order = std::memcmp(results[c - 1].lastKey.data(), results[c].firstKey.data(), kSortKeyBytes);
+            if (order > 0 && report.unordered++ == 0) {
+                report.firstUnordered = report.records;
+            } else if (order == 0) {
+                ++report.duplicateKeys;
+            }
+        }
+        if (part.unordered > 0 && report.unordered == 0) {
+            report.firstUnordered = part.firstUnordered;
+        }
+        report.records += part.records;
+        report.unordered += part.unordered;
+        report.duplicateKeys += part.duplicateKeys;
+        report.checksum += part.checksum;
+    }
+    return true;
+}
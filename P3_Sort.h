@@ -0,0 +1,65 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// TeraSort-style benchmark of the shuffle, independent of word counting.
+// Records are fixed 100-byte lines in the gensort ASCII layout:
+//
+//     10-byte key, 2 spaces, 32 hex digits of the record number, 2 spaces,
+//     52 filler characters, "\r\n"
+//
+// Keys compare as unsigned bytes (memcmp order).
+const std::size_t kSortRecordBytes = 100;
+const std::size_t kSortKeyBytes = 10;
+
+struct SortOptions {
+    unsigned int workers = 4;
+    unsigned int partitions = 0;      // 0 = workers, more under a memory limit
+    std::size_t memoryLimit = 0;      // sizes the partitions; 0 = unlimited
+    std::size_t samples = 100000;     // keys sampled to choose split points
+    std::string tempDir;              // shuffle files (default: next to the output)
+};
+
+// Phase timings and partition sizes of one sort, for benchmarking.
+struct SortReport {
+    std::uint64_t records = 0;
+    unsigned int partitions = 0;
+    std::uint64_t largestPartition = 0;  // records
+    double sampleSeconds = 0;
+    double shuffleSeconds = 0;
+    double sortSeconds = 0;              // sort and write of all partitions
+};
+
+// Writes `records` random records starting at record number `first`, in
+// parallel. The same (first, records) always gives the same file.
+bool teraGen(const std::string& output, std::uint64_t records, std::uint64_t first,
+             unsigned int workers);
+
+// Sorts the records of `input` (a file, or every file of a directory) into
+// one file:
+//   1. sample keys evenly across the input and pick partitions-1 split points
+//   2. range-partition every record by binary search over the splits into
+//      shuffle files, several input chunks at a time
+//   3. LSD radix sort each partition on its own worker and write it at its
+//      offset in the output; partition p holds only keys below those of
+//      partition p+1, so the concatenation is globally sorted
+bool teraSort(const std::string& input, const std::string& output, const SortOptions& options,
+              SortReport& report);
+
+// Result of checking a record file (or a directory of them, in name order).
+// The checksum is an order-independent sum of record hashes, so a sorted
+// output must have the same records and checksum as its input.
+struct ValidateReport {
+    std::uint64_t records = 0;
+    std::uint64_t unordered = 0;      // records with a smaller key than the previous one
+    std::uint64_t duplicateKeys = 0;  // records with the same key as the previous one
+    std::uint64_t checksum = 0;
+    std::uint64_t firstUnordered = 0; // record number of the first unordered record
+};
+
+bool teraValidate(const std::string& input, unsigned int workers, ValidateReport& report);
+
+#endif // SORT_H
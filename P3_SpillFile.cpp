@@ -0,0 +1,176 @@
+#include "P3_SpillFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+const std::size_t kRecordSize = sizeof(std::uint32_t) + sizeof(std::uint64_t);
+const std::size_t kRecordsPerBlock = 256 * 1024 / kRecordSize;
+// Upper bound on a stored block, with room for incompressible data.
+const std::size_t kMaxStoredBlock = 2 * kRecordsPerBlock * kRecordSize;
+}
+
+SpillWriter::~SpillWriter() {
+    if (out_.is_open()) {
+        // Abandoned mid-run: do not leave a partial run behind.
+        out_.close();
+        std::remove(path_.c_str());
+    }
+}
+
+bool SpillWriter::write(const std::string& path,
+                        const std::vector<std::pair<std::uint32_t, std::size_t>>& sortedRecords,
+                        Codec codec) {
+    SpillWriter writer;
+    if (!writer.open(path, codec)) {
+        return false;
+    }
+    for (const auto& record : sortedRecords) {
+        if (!writer.add(record.first, record.second)) {
+            return false;
+        }
+    }
+    return writer.close();
+}
+
+bool SpillWriter::open(const std::string& path, Codec codec) {
+    path_ = path;
+    codec_ = codec;
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_.is_open()) {
+        std::cerr << "Failed to open spill file for writing: " << path << "\n";
+        ok_ = false;
+        return false;
+    }
+    char codecByte = static_cast<char>(codec);
+    out_.write(&codecByte, 1);
+    block_.clear();
+    block_.reserve(kRecordsPerBlock * kRecordSize);
+    ok_ = static_cast<bool>(out_);
+    return ok_;
+}
+
+bool SpillWriter::add(std::uint32_t id, std::size_t count) {
+    if (!ok_) {
+        return false;
+    }
+    char bytes[kRecordSize];
+    std::uint64_t value = count;
+    std::memcpy(bytes, &id, sizeof(std::uint32_t));
+    std::memcpy(bytes + sizeof(std::uint32_t), &value, sizeof(std::uint64_t));
+    block_.insert(block_.end(), bytes, bytes + kRecordSize);
+    if (block_.size() >= kRecordsPerBlock * kRecordSize) {
+        ok_ = flushBlock();
+    }
+    return ok_;
+}
+
+bool SpillWriter::flushBlock() {
+    const std::vector<char>* payload = &block_;
+    if (codec_ != Codec::None) {
+        stored_.clear();
+        if (!compressBuffer(codec_, block_.data(), block_.size(), stored_, 1)) {
+            return false;
+        }
+        payload = &stored_;
+    }
+
+    std::uint32_t sizes[2] = { static_cast<std::uint32_t>(block_.size()),
+                               static_cast<std::uint32_t>(payload->size()) };
+    out_.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    out_.write(payload->data(), static_cast<std::streamsize>(payload->size()));
+    block_.clear();
+    return static_cast<bool>(out_);
+}
+
+bool SpillWriter::close() {
+    if (ok_ && !block_.empty()) {
+        ok_ = flushBlock();
+    }
+    if (ok_) {
+        out_.close();
+        ok_ = !out_.fail();
+    }
+    if (!ok_) {
+        std::cerr << "Failed to write spill file: " << path_ << "\n";
+        if (out_.is_open()) {
+            out_.close();
+        }
+        std::remove(path_.c_str());
+    }
+    return ok_;
+}
+
+bool SpillReader::open(const std::string& path) {
+    path_ = path;
+    failed_ = false;
+    block_.clear();
+    pos_ = 0;
+    in_.open(path, std::ios::binary);
+    char codecByte = 0;
+    if (!in_.is_open() || !in_.read(&codecByte, 1)) {
+        std::cerr << "Failed to open spill file: " << path << "\n";
+        failed_ = true;
+        return false;
+    }
+    codec_ = static_cast<Codec>(codecByte);
+    if (codec_ != Codec::None && codec_ != Codec::Gzip && codec_ != Codec::Zstd) {
+        std::cerr << "Unknown codec in spill file: " << path << "\n";
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool SpillReader::loadBlock() {
+    std::uint32_t sizes[2] = {};
+    in_.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+    if (in_.gcount() == 0 && in_.eof()) {
+        return false;  // clean end of run
+    }
+    bool ok = in_.gcount() == static_cast<std::streamsize>(sizeof(sizes)) &&
+              sizes[0] % kRecordSize == 0 && sizes[0] > 0 &&
+              sizes[0] <= kRecordsPerBlock * kRecordSize && sizes[1] <= kMaxStoredBlock &&
+              (codec_ != Codec::None || sizes[0] == sizes[1]);
+    if (ok) {
+        std::vector<char>& target = (codec_ == Codec::None) ? block_ : stored_;
+        target.resize(sizes[1]);
+        ok = static_cast<bool>(in_.read(target.data(), sizes[1]));
+    }
+    if (ok && codec_ != Codec::None) {
+        ok = decompressBuffer(codec_, stored_, block_) && block_.size() == sizes[0];
+    }
+    if (!ok) {
+        std::cerr << "Truncated or corrupt spill file: " << path_ << "\n";
+        failed_ = true;
+        block_.clear();
+        return false;
+    }
+    pos_ = 0;
+    return true;
+}
+
+bool SpillReader::next(std::pair<std::uint32_t, std::size_t>& record) {
+    if (failed_) {
+        return false;
+    }
+    if (pos_ + kRecordSize > block_.size() && !loadBlock()) {
+        return false;
+    }
+    std::uint64_t count = 0;
+    std::memcpy(&record.first, block_.data() + pos_, sizeof(std::uint32_t));
+    std::memcpy(&count, block_.data() + pos_ + sizeof(std::uint32_t), sizeof(std::uint64_t));
+    record.second = static_cast<std::size_t>(count);
+    pos_ += kRecordSize;
+    return true;
+}
+
+bool SpillReader::failed() const {
+    return failed_;
+}
+
+Codec SpillReader::codec() const {
+    return codec_;
+}
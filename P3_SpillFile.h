@@ -0,0 +1,68 @@
+#ifndef SPILLFILE_H
+#define SPILLFILE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <cstdint>
+
+#include "P3_Compression.h"
+
+// Sorted run of (word ID, count) records written when a worker's partial
+// aggregate exceeds the memory budget. Records are fixed 12-byte entries
+// (u32 ID, u64 count) in ascending ID order, so runs can be merged by
+// streaming. The file is one codec byte followed by blocks of
+// [u32 raw size][u32 stored size][stored bytes]; with a codec each block is
+// compressed on its own, so readers only ever hold one block.
+class SpillWriter {
+public:
+    ~SpillWriter();
+
+    static bool write(const std::string& path,
+                      const std::vector<std::pair<std::uint32_t, std::size_t>>& sortedRecords,
+                      Codec codec = Codec::None);
+
+    // Streaming form, for runs that do not fit in memory (e.g. the output
+    // of an intermediate merge pass). add() buffers one block at a time.
+    bool open(const std::string& path, Codec codec = Codec::None);
+    bool add(std::uint32_t id, std::size_t count);
+    bool close();
+
+private:
+    bool flushBlock();
+
+    std::ofstream out_;
+    std::string path_;
+    Codec codec_ = Codec::None;
+    std::vector<char> block_;
+    std::vector<char> stored_;
+    bool ok_ = false;
+};
+
+class SpillReader {
+public:
+    bool open(const std::string& path);
+
+    // Read the next record. Returns false at the end of the run or on an
+    // error; failed() tells them apart.
+    bool next(std::pair<std::uint32_t, std::size_t>& record);
+
+    // True if the run was truncated or corrupt.
+    bool failed() const;
+
+    Codec codec() const;
+
+private:
+    bool loadBlock();
+
+    std::ifstream in_;
+    std::string path_;
+    Codec codec_ = Codec::None;
+    std::vector<char> stored_;
+    std::vector<char> block_;
+    std::size_t pos_ = 0;
+    bool failed_ = false;
+};
+
+#endif // SPILLFILE_H
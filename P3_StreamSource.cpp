@@ -0,0 +1,178 @@
+#include "P3_StreamSource.h"
+#include "P3_MemoryBudget.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Read whatever is available, up to `size` bytes; 0 means end of stream,
+// or a read error when `failed` is set. On POSIX a pipe read returns as
+// soon as some data is there, so slow producers still see their lines
+// mapped promptly.
+std::size_t readSome(std::FILE* file, char* data, std::size_t size, bool& failed) {
+#ifdef _WIN32
+    std::size_t got = std::fread(data, 1, size, file);
+    failed = got == 0 && std::ferror(file) != 0;
+    return got;
+#else
+    while (true) {
+        ssize_t got = ::read(fileno(file), data, size);
+        if (got >= 0) {
+            return static_cast<std::size_t>(got);
+        }
+        if (errno != EINTR) {
+            failed = true;
+            return 0;
+        }
+    }
+#endif
+}
+
+} // namespace
+
+StreamSource::StreamSource(const std::string& path,
+                           std::size_t batchBytes,
+                           std::size_t batchesInFlight,
+                           MemoryBudget* budget)
+    : path_(path),
+      batchBytes_(batchBytes == 0 ? 4 * 1024 * 1024 : batchBytes),
+      budget_(budget),
+      output_(batchesInFlight) {
+}
+
+StreamSource::~StreamSource() {
+    join();
+    if (ownsFile_ && file_ != nullptr) {
+        std::fclose(file_);
+    }
+}
+
+bool StreamSource::isStream(const std::string& path) {
+    if (path == "-") {
+        return true;
+    }
+    std::error_code ec;
+    auto status = std::filesystem::status(path, ec);
+    return !ec && (std::filesystem::is_fifo(status) || std::filesystem::is_character_file(status));
+}
+
+bool StreamSource::start() {
+    if (path_ == "-") {
+        file_ = stdin;
+    } else {
+        file_ = std::fopen(path_.c_str(), "rb");
+        ownsFile_ = true;
+    }
+    if (file_ == nullptr) {
+        std::cerr << "Failed to open stream for reading: " << path_ << "\n";
+        output_.close();
+        return false;
+    }
+    thread_ = std::thread(&StreamSource::readLoop, this);
+    return true;
+}
+
+void StreamSource::join() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool StreamSource::next(FileBuffer& buffer) {
+    return output_.pop(buffer);
+}
+
+void StreamSource::release(const FileBuffer& buffer) {
+    if (budget_) {
+        budget_->release(buffer.data.size());
+    }
+}
+
+std::size_t StreamSource::batches() const {
+    return batches_;
+}
+
+std::size_t StreamSource::bytesRead() const {
+    return bytesRead_;
+}
+
+bool StreamSource::failed() const {
+    return failed_;
+}
+
+void StreamSource::readLoop() {
+    const std::string label = (path_ == "-") ? "<stdin>" : path_;
+    std::vector<char> pending;  // start of a line not yet terminated
+
+    auto emit = [&](std::vector<char> data) {
+        FileBuffer buffer;
+        buffer.path = label + " batch " + std::to_string(++batches_);
+        buffer.data = std::move(data);
+        buffer.ok = true;
+        if (budget_) {
+            budget_->forceReserve(buffer.data.size());
+        }
+        output_.push(std::move(buffer));
+    };
+
+    bool ended = false;
+    while (!ended) {
+        std::vector<char> batch;
+        batch.reserve(batchBytes_ + pending.size());
+        batch.swap(pending);
+
+        // Fill up to a batch, but hand over early when the producer is
+        // slower than us (a short read).
+        while (batch.size() < batchBytes_) {
+            std::size_t used = batch.size();
+            std::size_t want = batchBytes_ - used;
+            batch.resize(used + want);
+            std::size_t got = readSome(file_, batch.data() + used, want, failed_);
+            batch.resize(used + got);
+            bytesRead_ += got;
+            if (got == 0) {
+                ended = true;
+                break;
+            }
+            if (got < want) {
+                break;
+            }
+        }
+
+        if (failed_) {
+            // Do not pass a truncated stream off as complete input.
+            std::cerr << "Error while reading stream: " << path_ << ": " << std::strerror(errno) << "\n";
+            break;
+        }
+        if (ended) {
+            // End of stream: a final unterminated line is still input.
+            if (!batch.empty()) {
+                emit(std::move(batch));
+            }
+            break;
+        }
+
+        // Cut after the last newline; the tail starts the next batch. A line
+        // longer than a batch simply keeps growing until it ends.
+        std::size_t cut = batch.size();
+        while (cut > 0 && batch[cut - 1] != '\n') {
+            --cut;
+        }
+        if (cut == 0) {
+            pending.swap(batch);
+            continue;
+        }
+        pending.assign(batch.begin() + static_cast<std::ptrdiff_t>(cut), batch.end());
+        batch.resize(cut);
+        emit(std::move(batch));
+    }
+
+    output_.close();
+}
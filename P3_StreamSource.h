@@ -0,0 +1,59 @@
+#ifndef STREAMSOURCE_H
+#define STREAMSOURCE_H
+
+#include <string>
+#include <cstdio>
+#include <thread>
+#include <cstddef>
+
+#include "P3_ReadAhead.h"
+
+class MemoryBudget;
+
+// Streaming input from stdin ("-") or a FIFO. A reader thread pulls large
+// chunks and cuts them into line-aligned batches, which are handed to the
+// mappers through a bounded queue as they arrive, so memory stays bounded
+// however long the stream runs. next() returns false at end of stream.
+class StreamSource : public BufferSource {
+public:
+    StreamSource(const std::string& path,
+                 std::size_t batchBytes,
+                 std::size_t batchesInFlight,
+                 MemoryBudget* budget = nullptr);
+    ~StreamSource() override;
+
+    StreamSource(const StreamSource&) = delete;
+    StreamSource& operator=(const StreamSource&) = delete;
+
+    // True if `path` names a stream rather than a file or directory.
+    static bool isStream(const std::string& path);
+
+    bool start();
+    void join();
+
+    bool next(FileBuffer& buffer) override;
+    void release(const FileBuffer& buffer) override;
+
+    std::size_t batches() const;
+    std::size_t bytesRead() const;
+
+    // True if reading stopped on an error rather than at end of stream.
+    // Valid after join().
+    bool failed() const;
+
+private:
+    void readLoop();
+
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    bool ownsFile_ = false;
+    std::size_t batchBytes_;
+    MemoryBudget* budget_;
+    BoundedQueue<FileBuffer> output_;
+    std::thread thread_;
+    std::size_t batches_ = 0;
+    std::size_t bytesRead_ = 0;
+    bool failed_ = false;
+};
+
+#endif // STREAMSOURCE_H
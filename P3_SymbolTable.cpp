@@ -0,0 +1,126 @@
+#include "P3_SymbolTable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+StringArena::StringArena(std::size_t chunkSize)
+    : chunkSize_(chunkSize == 0 ? 4096 : chunkSize) {
+}
+
+std::string_view StringArena::store(std::string_view text) {
+    if (text.size() > remaining_) {
+        std::size_t size = std::max(chunkSize_, text.size());
+        chunks_.emplace_back(new char[size]);
+        cursor_ = chunks_.back().get();
+        remaining_ = size;
+        reserved_ += size;
+    }
+
+    char* destination = cursor_;
+    if (!text.empty()) {
+        std::memcpy(destination, text.data(), text.size());
+    }
+    cursor_ += text.size();
+    remaining_ -= text.size();
+    used_ += text.size();
+    return std::string_view(destination, text.size());
+}
+
+std::size_t StringArena::bytesUsed() const {
+    return used_;
+}
+
+std::size_t StringArena::bytesReserved() const {
+    return reserved_;
+}
+
+std::size_t SymbolTable::shardOf(std::string_view word) {
+    // Use the high bits: the low bits also pick the bucket inside the shard.
+    std::size_t hash = std::hash<std::string_view>()(word);
+    return (hash >> (sizeof(std::size_t) * 8 - kShardBits)) & (kShardCount - 1);
+}
+
+StringArena& SymbolTable::createArena() {
+    std::lock_guard<std::mutex> lock(arenasMutex_);
+    arenas_.push_back(std::make_unique<StringArena>());
+    return *arenas_.back();
+}
+
+std::uint32_t SymbolTable::intern(std::string_view word, StringArena& arena,
+                                  std::string_view* storedText) {
+    std::size_t shardIndex = shardOf(word);
+    Shard& shard = shards_[shardIndex];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.ids.find(word);
+    if (it != shard.ids.end()) {
+        if (storedText != nullptr) {
+            *storedText = it->first;
+        }
+        return it->second;
+    }
+
+    // ID = (position within shard << shard bits) | shard, so text() can find
+    // the shard without a global index.
+    std::uint32_t id = static_cast<std::uint32_t>((shard.texts.size() << kShardBits) | shardIndex);
+    std::string_view stored = arena.store(word);
+    shard.texts.push_back(stored);
+    shard.ids.emplace(stored, id);
+    if (storedText != nullptr) {
+        *storedText = stored;
+    }
+    return id;
+}
+
+std::uint32_t SymbolTable::find(std::string_view word) const {
+    const Shard& shard = shards_[shardOf(word)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.ids.find(word);
+    return it == shard.ids.end() ? kNoSymbol : it->second;
+}
+
+std::string_view SymbolTable::text(std::uint32_t id) const {
+    const Shard& shard = shards_[id & (kShardCount - 1)];
+    return shard.texts[id >> kShardBits];
+}
+
+std::string_view SymbolTable::textLocked(std::uint32_t id) const {
+    const Shard& shard = shards_[id & (kShardCount - 1)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.texts[id >> kShardBits];
+}
+
+std::size_t SymbolTable::size() const {
+    std::size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.texts.size();
+    }
+    return total;
+}
+
+std::size_t SymbolTable::arenaBytes() const {
+    std::lock_guard<std::mutex> lock(arenasMutex_);
+    std::size_t total = 0;
+    for (const auto& arena : arenas_) {
+        total += arena->bytesReserved();
+    }
+    return total;
+}
+
+SymbolCache::SymbolCache(SymbolTable& table)
+    : table_(table),
+      arena_(table.createArena()) {
+}
+
+std::uint32_t SymbolCache::intern(std::string_view word) {
+    auto it = local_.find(word);
+    if (it != local_.end()) {
+        return it->second;
+    }
+    std::string_view stored;
+    std::uint32_t id = table_.intern(word, arena_, &stored);
+    local_.emplace(stored, id);
+    return id;
+}
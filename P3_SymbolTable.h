@@ -0,0 +1,106 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+// Bump allocator for interned word text. Bytes are carved out of large
+// chunks and never freed individually; everything is released with the arena.
+class StringArena {
+public:
+    explicit StringArena(std::size_t chunkSize = 64 * 1024);
+
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    // Copy `text` into the arena and return a view of the copy.
+    std::string_view store(std::string_view text);
+
+    std::size_t bytesUsed() const;
+    std::size_t bytesReserved() const;
+
+private:
+    std::size_t chunkSize_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* cursor_ = nullptr;
+    std::size_t remaining_ = 0;
+    std::size_t used_ = 0;
+    std::size_t reserved_ = 0;
+};
+
+// Concurrent global symbol table mapping words to stable 32-bit IDs.
+//
+// The table is split into shards selected by word hash, each with its own
+// lock, so workers interning different words rarely contend. New text is
+// copied into the calling worker's arena (no lock needed for the copy since
+// each arena has a single owner); the table owns all arenas, so every view
+// it hands out stays valid for the table's lifetime.
+class SymbolTable {
+public:
+    static const std::uint32_t kNoSymbol = 0xffffffffu;
+
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    // A new arena owned by the table, for use by one worker.
+    StringArena& createArena();
+
+    // Returns the ID of `word`, interning it (text stored in `arena`) if new.
+    // If `storedText` is given it receives the table's stable copy of the word.
+    std::uint32_t intern(std::string_view word, StringArena& arena,
+                         std::string_view* storedText = nullptr);
+
+    // Returns the ID of `word`, or kNoSymbol if it was never interned.
+    std::uint32_t find(std::string_view word) const;
+
+    // Text of an ID. Lock-free, so it must not race with intern(); resolve
+    // IDs after the map phase (which is when output is materialized anyway).
+    std::string_view text(std::uint32_t id) const;
+
+    // Same as text(), but takes the shard lock so it is safe while other
+    // threads intern (e.g. for partial results during the map phase).
+    std::string_view textLocked(std::uint32_t id) const;
+    std::size_t size() const;
+
+    // Bytes held by all arenas.
+    std::size_t arenaBytes() const;
+
+private:
+    static const unsigned int kShardBits = 6;
+    static const std::size_t kShardCount = std::size_t(1) << kShardBits;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string_view, std::uint32_t> ids;
+        std::vector<std::string_view> texts;
+    };
+
+    static std::size_t shardOf(std::string_view word);
+
+    std::array<Shard, kShardCount> shards_;
+    mutable std::mutex arenasMutex_;
+    std::vector<std::unique_ptr<StringArena>> arenas_;
+};
+
+// Per-worker front cache: repeated words resolve to IDs without touching
+// the shared table's locks.
+class SymbolCache {
+public:
+    explicit SymbolCache(SymbolTable& table);
+
+    std::uint32_t intern(std::string_view word);
+
+private:
+    SymbolTable& table_;
+    StringArena& arena_;
+    std::unordered_map<std::string_view, std::uint32_t> local_; // views into table text
+};
+
+#endif // SYMBOLTABLE_H
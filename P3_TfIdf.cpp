@@ -0,0 +1,213 @@
+#include "P3_TfIdf.h"
+#include "P3_Varint.h"
+#include "P3_OutputWriter.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char kTfIdfMagic[8] = { 'M', 'R', 'T', 'F', 'I', 'D', 'F', '1' };
+
+struct TfIdfHeader {
+    char magic[8];
+    std::uint64_t docCount;
+    std::uint64_t termCount;
+    std::uint64_t docTableOffset;
+    std::uint64_t termTableOffset;
+    std::uint64_t namesOffset;
+    std::uint64_t namesSize;
+    std::uint64_t vectorsOffset;
+    std::uint64_t vectorsSize;
+};
+static_assert(sizeof(TfIdfHeader) == 72, "TfIdfHeader must not contain padding");
+
+const std::size_t kDocEntrySize = 32;
+const std::size_t kTermEntrySize = 16;
+
+template <typename T>
+T readAt(const unsigned char* base, std::size_t offset) {
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void append(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+void TfIdfWriter::encodeVector(const std::vector<TermWeight>& weights, TfIdfDocument& doc) {
+    doc.vector.clear();
+    double squares = 0;
+    std::uint32_t previous = 0;
+    for (const TermWeight& entry : weights) {
+        appendVarint(doc.vector, entry.termId - previous);
+        append<float>(doc.vector, entry.weight);
+        previous = entry.termId;
+        squares += static_cast<double>(entry.weight) * entry.weight;
+    }
+    doc.entries = static_cast<std::uint32_t>(weights.size());
+    doc.norm = static_cast<float>(std::sqrt(squares));
+}
+
+bool TfIdfWriter::write(const std::string& path,
+                        const std::vector<TfIdfDocument>& documents,
+                        const std::vector<std::pair<std::string, std::size_t>>& terms) {
+    std::string docTable;
+    std::string termTable;
+    std::string names;
+    std::uint64_t vectorsSize = 0;
+
+    for (const auto& doc : documents) {
+        append<std::uint64_t>(docTable, names.size());
+        append<std::uint32_t>(docTable, static_cast<std::uint32_t>(doc.path.size()));
+        append<std::uint32_t>(docTable, doc.length);
+        append<std::uint64_t>(docTable, vectorsSize);
+        append<std::uint32_t>(docTable, doc.entries);
+        append<float>(docTable, doc.norm);
+        names += doc.path;
+        vectorsSize += doc.vector.size();
+    }
+
+    for (const auto& term : terms) {
+        append<std::uint64_t>(termTable, names.size());
+        append<std::uint32_t>(termTable, static_cast<std::uint32_t>(term.first.size()));
+        append<std::uint32_t>(termTable, static_cast<std::uint32_t>(term.second));
+        names += term.first;
+    }
+
+    TfIdfHeader header{};
+    std::memcpy(header.magic, kTfIdfMagic, sizeof(kTfIdfMagic));
+    header.docCount = documents.size();
+    header.termCount = terms.size();
+    header.docTableOffset = sizeof(TfIdfHeader);
+    header.termTableOffset = header.docTableOffset + docTable.size();
+    header.namesOffset = header.termTableOffset + termTable.size();
+    header.namesSize = names.size();
+    header.vectorsOffset = header.namesOffset + names.size();
+    header.vectorsSize = vectorsSize;
+
+    AtomicOutputFile out;
+    if (!out.open(path)) {
+        return false;
+    }
+    bool ok = out.append(reinterpret_cast<const char*>(&header), sizeof(header)) &&
+              out.append(docTable.data(), docTable.size()) &&
+              out.append(termTable.data(), termTable.size()) &&
+              out.append(names.data(), names.size());
+    for (std::size_t i = 0; ok && i < documents.size(); ++i) {
+        ok = out.append(documents[i].vector.data(), documents[i].vector.size());
+    }
+    if (!ok) {
+        std::cerr << "Failed to write TF-IDF vectors: " << path << "\n";
+        return false;
+    }
+    return out.commit();
+}
+
+bool TfIdfVectors::open(const std::string& path) {
+    if (!file_.open(path) || file_.size() < sizeof(TfIdfHeader)) {
+        return false;
+    }
+
+    TfIdfHeader header = readAt<TfIdfHeader>(file_.data(), 0);
+    if (std::memcmp(header.magic, kTfIdfMagic, sizeof(kTfIdfMagic)) != 0 ||
+        header.docTableOffset + header.docCount * kDocEntrySize > file_.size() ||
+        header.termTableOffset + header.termCount * kTermEntrySize > file_.size() ||
+        header.namesOffset + header.namesSize > file_.size() ||
+        header.vectorsOffset + header.vectorsSize > file_.size()) {
+        file_.close();
+        return false;
+    }
+
+    docCount_ = static_cast<std::size_t>(header.docCount);
+    termCount_ = static_cast<std::size_t>(header.termCount);
+    docTable_ = file_.data() + header.docTableOffset;
+    termTable_ = file_.data() + header.termTableOffset;
+    names_ = file_.data() + header.namesOffset;
+    namesSize_ = static_cast<std::size_t>(header.namesSize);
+    vectors_ = file_.data() + header.vectorsOffset;
+    vectorsSize_ = static_cast<std::size_t>(header.vectorsSize);
+    return true;
+}
+
+std::size_t TfIdfVectors::documentCount() const {
+    return docCount_;
+}
+
+std::size_t TfIdfVectors::termCount() const {
+    return termCount_;
+}
+
+std::string_view TfIdfVectors::nameAt(std::uint64_t offset, std::uint32_t length) const {
+    if (offset + length > namesSize_) {
+        return {};
+    }
+    return std::string_view(reinterpret_cast<const char*>(names_ + offset), length);
+}
+
+std::string_view TfIdfVectors::documentPath(std::uint32_t docId) const {
+    if (docId >= docCount_) {
+        return {};
+    }
+    std::size_t base = docId * kDocEntrySize;
+    return nameAt(readAt<std::uint64_t>(docTable_, base),
+                  readAt<std::uint32_t>(docTable_, base + 8));
+}
+
+std::uint32_t TfIdfVectors::documentLength(std::uint32_t docId) const {
+    return docId < docCount_ ? readAt<std::uint32_t>(docTable_, docId * kDocEntrySize + 12) : 0;
+}
+
+float TfIdfVectors::norm(std::uint32_t docId) const {
+    return docId < docCount_ ? readAt<float>(docTable_, docId * kDocEntrySize + 28) : 0.0f;
+}
+
+std::string_view TfIdfVectors::term(std::uint32_t termId) const {
+    if (termId >= termCount_) {
+        return {};
+    }
+    std::size_t base = termId * kTermEntrySize;
+    return nameAt(readAt<std::uint64_t>(termTable_, base),
+                  readAt<std::uint32_t>(termTable_, base + 8));
+}
+
+std::uint32_t TfIdfVectors::docFreq(std::uint32_t termId) const {
+    return termId < termCount_ ? readAt<std::uint32_t>(termTable_, termId * kTermEntrySize + 12) : 0;
+}
+
+bool TfIdfVectors::vector(std::uint32_t docId, std::vector<TermWeight>& weights) const {
+    weights.clear();
+    if (docId >= docCount_) {
+        return false;
+    }
+    std::size_t base = docId * kDocEntrySize;
+    std::uint64_t offset = readAt<std::uint64_t>(docTable_, base + 16);
+    std::uint32_t entries = readAt<std::uint32_t>(docTable_, base + 24);
+    if (offset > vectorsSize_) {
+        return false;
+    }
+
+    const unsigned char* cursor = vectors_ + offset;
+    const unsigned char* end = vectors_ + vectorsSize_;
+    weights.reserve(entries);
+    std::uint64_t termId = 0;
+    for (std::uint32_t i = 0; i < entries; ++i) {
+        std::uint64_t delta = 0;
+        if (!readVarint(cursor, end, delta) || end - cursor < static_cast<std::ptrdiff_t>(sizeof(float))) {
+            weights.clear();
+            return false;
+        }
+        termId += delta;
+        TermWeight entry;
+        entry.termId = static_cast<std::uint32_t>(termId);
+        std::memcpy(&entry.weight, cursor, sizeof(float));
+        cursor += sizeof(float);
+        weights.push_back(entry);
+    }
+    return true;
+}
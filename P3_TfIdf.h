@@ -0,0 +1,84 @@
+#ifndef TFIDF_H
+#define TFIDF_H
+
+#include "P3_MappedFile.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// One nonzero entry of a sparse TF-IDF vector.
+struct TermWeight {
+    std::uint32_t termId = 0;
+    float weight = 0;
+};
+
+// A document's vector as written to the file (see TfIdfWriter).
+struct TfIdfDocument {
+    std::string path;
+    std::uint32_t length = 0;   // words in the document
+    std::uint32_t entries = 0;  // nonzero weights
+    float norm = 0;             // L2 norm of the weights
+    std::string vector;         // encoded entries
+};
+
+// TF-IDF vector file. The weight of term t in document d is
+//   tf(t, d) * idf(t) = count(t, d) / length(d) * ln(documents / df(t)),
+// so terms found in every document get no entry.
+//
+// Layout (little-endian, offsets from the start of the file):
+//   header       TfIdfHeader
+//   doc table    per document: [u64 name offset][u32 name length][u32 length]
+//                [u64 vector offset][u32 entries][f32 norm]
+//   term table   per term, sorted by term (term ID = position):
+//                [u64 name offset][u32 name length][u32 doc freq]
+//   names        document paths and term text
+//   vectors      per document, ascending term IDs: varint ID delta, f32 weight
+class TfIdfWriter {
+public:
+    // Encode `weights` (ascending term IDs) into doc.vector and set
+    // doc.entries and doc.norm. Called in parallel, one document each.
+    static void encodeVector(const std::vector<TermWeight>& weights, TfIdfDocument& doc);
+
+    // `terms` are (term, document frequency) sorted by term.
+    static bool write(const std::string& path,
+                      const std::vector<TfIdfDocument>& documents,
+                      const std::vector<std::pair<std::string, std::size_t>>& terms);
+};
+
+class TfIdfVectors {
+public:
+    bool open(const std::string& path);
+
+    std::size_t documentCount() const;
+    std::size_t termCount() const;
+
+    std::string_view documentPath(std::uint32_t docId) const;
+    std::uint32_t documentLength(std::uint32_t docId) const;
+    float norm(std::uint32_t docId) const;
+
+    std::string_view term(std::uint32_t termId) const;
+    std::uint32_t docFreq(std::uint32_t termId) const;
+
+    // Decode the vector of a document. Returns false if it is out of range
+    // or corrupt.
+    bool vector(std::uint32_t docId, std::vector<TermWeight>& weights) const;
+
+private:
+    std::string_view nameAt(std::uint64_t offset, std::uint32_t length) const;
+
+    MappedFile file_;
+    std::size_t docCount_ = 0;
+    std::size_t termCount_ = 0;
+    const unsigned char* docTable_ = nullptr;
+    const unsigned char* termTable_ = nullptr;
+    const unsigned char* names_ = nullptr;
+    const unsigned char* vectors_ = nullptr;
+    std::size_t namesSize_ = 0;
+    std::size_t vectorsSize_ = 0;
+};
+
+#endif // TFIDF_H
@@ -0,0 +1,21 @@
+#include "P3_Varint.h"
+
+void appendVarint(std::string& buffer, std::uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+bool readVarint(const unsigned char*& cursor, const unsigned char* end, std::uint64_t& value) {
+    value = 0;
+    for (unsigned int shift = 0; cursor < end && shift < 64; shift += 7) {
+        unsigned char byte = *cursor++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,16 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <string>
+#include <cstdint>
+
+// LEB128-style variable-length integers: 7 bits per byte, low bits first,
+// high bit set on every byte except the last.
+
+void appendVarint(std::string& buffer, std::uint64_t value);
+
+// Decode one varint from [cursor, end) and advance cursor past it.
+// Returns false on truncated input.
+bool readVarint(const unsigned char*& cursor, const unsigned char* end, std::uint64_t& value);
+
+#endif // VARINT_H
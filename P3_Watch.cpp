@@ -0,0 +1,237 @@
+#include "P3_Watch.h"
+#include "P3_OutputWriter.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char* const kSnapshotHeader = "MRWATCH 1";
+}
+
+DirectoryWatcher::DirectoryWatcher(bool forcePolling, std::chrono::milliseconds pollInterval)
+    : pollInterval_(pollInterval) {
+#ifdef __linux__
+    if (!forcePolling) {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) {
+            std::cerr << "inotify unavailable; falling back to polling\n";
+        }
+    }
+#else
+    (void)forcePolling;
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+#ifdef __linux__
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+}
+
+void DirectoryWatcher::addDirectory(const std::filesystem::path& dir) {
+#ifdef __linux__
+    if (fd_ < 0 || !watched_.insert(dir.string()).second) {
+        return;
+    }
+    const std::uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE;
+    if (inotify_add_watch(fd_, dir.c_str(), mask) < 0) {
+        // Out of watches: keep going on the poll interval.
+        std::cerr << "Failed to watch " << dir.string() << "; falling back to polling\n";
+        ::close(fd_);
+        fd_ = -1;
+    }
+#else
+    (void)dir;
+#endif
+}
+
+bool DirectoryWatcher::wait(std::chrono::milliseconds timeout) {
+#ifdef __linux__
+    if (fd_ >= 0) {
+        pollfd target{ fd_, POLLIN, 0 };
+        int ready = ::poll(&target, 1, static_cast<int>(timeout.count()));
+        if (ready <= 0) {
+            return false;
+        }
+        // Drain the queued events; the caller rescans whatever changed.
+        char events[16 * 1024];
+        while (::read(fd_, events, sizeof(events)) > 0) {
+        }
+        return true;
+    }
+#endif
+    std::this_thread::sleep_for(std::min(timeout, pollInterval_));
+    return true;
+}
+
+bool DirectoryWatcher::usingNotifications() const {
+    return fd_ >= 0;
+}
+
+FileIdentity fileIdentity(const std::filesystem::path& path) {
+    FileIdentity identity;
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return identity;
+    }
+    BY_HANDLE_FILE_INFORMATION info{};
+    if (GetFileInformationByHandle(file, &info)) {
+        identity.device = info.dwVolumeSerialNumber;
+        identity.inode = (static_cast<std::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    }
+    CloseHandle(file);
+#else
+    struct stat info {};
+    if (::stat(path.c_str(), &info) == 0) {
+        identity.device = static_cast<std::uint64_t>(info.st_dev);
+        identity.inode = static_cast<std::uint64_t>(info.st_ino);
+    }
+#endif
+    return identity;
+}
+
+bool WatchState::load(const std::string& snapshotFile) {
+    files_.clear();
+    totals_.clear();
+
+    std::ifstream in(snapshotFile);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != kSnapshotHeader) {
+        std::cerr << "Ignoring unrecognized watch snapshot: " << snapshotFile << "\n";
+        return false;
+    }
+
+    // file <offset> <whole> <device> <inode>\t<path>   (one per file)
+    // <word>\t<count>                                 (one per word, after the files)
+    while (std::getline(in, line)) {
+        std::size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            continue;
+        }
+        if (line.compare(0, 5, "file ") == 0) {
+            std::istringstream header(line.substr(0, tab));
+            std::string tag;
+            FileProgress progress;
+            header >> tag >> progress.offset >> progress.whole;
+            if (header) {
+                // Older snapshots have no identity; it is taken on the next scan.
+                header >> progress.identity.device >> progress.identity.inode;
+                if (!header) {
+                    progress.identity = FileIdentity();
+                }
+                files_[line.substr(tab + 1)] = progress;
+            }
+            continue;
+        }
+        try {
+            totals_[line.substr(0, tab)] += static_cast<std::size_t>(std::stoull(line.substr(tab + 1)));
+        } catch (...) {
+            // skip malformed row
+        }
+    }
+    return true;
+}
+
+bool WatchState::save(const std::string& snapshotFile) const {
+    std::string text = std::string(kSnapshotHeader) + "\n";
+    for (const auto& file : files_) {
+        text += "file " + std::to_string(file.second.offset) + " " +
+                (file.second.whole ? "1" : "0") + " " + std::to_string(file.second.identity.device) + " " +
+                std::to_string(file.second.identity.inode) + "\t" + file.first + "\n";
+    }
+    for (const auto& entry : totals_) {
+        text += entry.first + "\t" + std::to_string(entry.second) + "\n";
+    }
+
+    AtomicOutputFile out;
+    return out.open(snapshotFile) && out.append(text.data(), text.size()) && out.commit();
+}
+
+std::vector<std::string> WatchState::reconcile(const std::vector<std::pair<std::string, FileIdentity>>& listed) {
+    std::map<FileIdentity, std::string> byIdentity;
+    for (const auto& file : files_) {
+        if (file.second.identity.known()) {
+            byIdentity[file.second.identity] = file.first;
+        }
+    }
+
+    std::vector<std::string> messages;
+    std::map<std::string, FileProgress> next;
+    std::set<std::string> claimed;  // recorded paths whose progress moved on
+    for (const auto& file : listed) {
+        const std::string& path = file.first;
+        const FileIdentity& identity = file.second;
+        auto recorded = files_.find(path);
+        if (recorded != files_.end() &&
+            (!identity.known() || !recorded->second.identity.known() || recorded->second.identity == identity)) {
+            FileProgress& progress = next[path] = recorded->second;
+            if (identity.known()) {
+                progress.identity = identity;
+            }
+            claimed.insert(path);
+            continue;
+        }
+        auto renamed = identity.known() ? byIdentity.find(identity) : byIdentity.end();
+        if (renamed != byIdentity.end()) {
+            next[path] = files_[renamed->second];
+            claimed.insert(renamed->second);
+            messages.push_back("File renamed, continuing at byte " + std::to_string(next[path].offset) +
+                               ": " + renamed->second + " -> " + path);
+            continue;
+        }
+        if (recorded != files_.end()) {
+            messages.push_back("File replaced, reading the new file from start: " + path);
+        }
+        next[path].identity = identity;
+    }
+    for (const auto& file : files_) {
+        if (claimed.count(file.first) == 0 && next.count(file.first) == 0) {
+            messages.push_back("File removed; its words stay in the totals: " + file.first);
+        }
+    }
+    files_.swap(next);
+    return messages;
+}
+
+WatchState::FileProgress& WatchState::progress(const std::string& path) {
+    return files_[path];
+}
+
+void WatchState::add(const std::unordered_map<std::string, std::size_t>& counts) {
+    for (const auto& entry : counts) {
+        totals_[entry.first] += entry.second;
+    }
+}
+
+std::vector<std::pair<std::string, std::size_t>> WatchState::totals() const {
+    std::vector<std::pair<std::string, std::size_t>> result(totals_.begin(), totals_.end());
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::size_t WatchState::files() const {
+    return files_.size();
+}
@@ -0,0 +1,110 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+// Settings for watch mode (see MapReduceController::setWatch).
+struct WatchOptions {
+    // Upper bound on how old a published result may be.
+    unsigned int publishSeconds = 10;
+    // Live state is saved here on every publish and restored on start.
+    std::string snapshotFile;
+    // Stop after this many seconds (0 = until interrupted).
+    unsigned int durationSeconds = 0;
+    // Rescan interval when change notifications are unavailable.
+    unsigned int pollMilliseconds = 1000;
+    bool forcePolling = false;
+};
+
+// Wakes the watch loop when something under the input directories
+// changes. Uses inotify on Linux; elsewhere (or if inotify fails) it just
+// sleeps for the poll interval and reports a possible change.
+class DirectoryWatcher {
+public:
+    DirectoryWatcher(bool forcePolling, std::chrono::milliseconds pollInterval);
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    // Start watching a directory (no-op if already watched or polling).
+    void addDirectory(const std::filesystem::path& dir);
+
+    // Wait up to `timeout` for a change. Returns true if the input may have
+    // changed and should be rescanned.
+    bool wait(std::chrono::milliseconds timeout);
+
+    bool usingNotifications() const;
+
+private:
+    std::chrono::milliseconds pollInterval_;
+    std::set<std::string> watched_;
+    int fd_ = -1;
+};
+
+// Identity of a file independent of its name: device and inode on POSIX,
+// volume serial and file index on Windows. Zero when it cannot be read.
+struct FileIdentity {
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+
+    bool known() const { return device != 0 || inode != 0; }
+    bool operator==(const FileIdentity& other) const {
+        return device == other.device && inode == other.inode;
+    }
+    bool operator<(const FileIdentity& other) const {
+        return device != other.device ? device < other.device : inode < other.inode;
+    }
+};
+
+FileIdentity fileIdentity(const std::filesystem::path& path);
+
+// Live aggregate of a watched directory: how far each file has been mapped
+// and the running word totals. Only complete lines are mapped, so a line
+// that is still being written is picked up once its newline arrives.
+class WatchState {
+public:
+    struct FileProgress {
+        std::uintmax_t offset = 0;
+        // Compressed files cannot be extended in place; they are mapped once.
+        bool whole = false;
+        FileIdentity identity;
+    };
+
+    // Match the files just listed against the recorded ones by identity,
+    // so rotation is recognized even when the new file is not smaller:
+    // a file recorded under another path was renamed and keeps its
+    // progress, a path whose identity changed holds a new file that is
+    // read from the start, and recorded paths that are gone are dropped.
+    // Words counted from a dropped or replaced file stay in the totals.
+    // Returns one log message per rename, replacement or removal.
+    std::vector<std::string> reconcile(const std::vector<std::pair<std::string, FileIdentity>>& listed);
+
+    // Restore from a snapshot. Returns false if missing or unreadable.
+    bool load(const std::string& snapshotFile);
+
+    // Write a snapshot atomically. Returns true on success.
+    bool save(const std::string& snapshotFile) const;
+
+    FileProgress& progress(const std::string& path);
+    void add(const std::unordered_map<std::string, std::size_t>& counts);
+
+    // Totals sorted by word.
+    std::vector<std::pair<std::string, std::size_t>> totals() const;
+
+    std::size_t files() const;
+
+private:
+    std::map<std::string, FileProgress> files_;
+    std::unordered_map<std::string, std::size_t> totals_;
+};
+
+#endif // WATCH_H
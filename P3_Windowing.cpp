@@ -0,0 +1,281 @@
+#include "P3_Windowing.h"
+#include "P3_Reducer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// Days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's
+// days_from_civil).
+std::int64_t daysFromCivil(std::int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+// Reads exactly `width` digits at text[pos].
+bool readDigits(std::string_view text, std::size_t pos, std::size_t width, int& value) {
+    if (pos + width > text.size()) {
+        return false;
+    }
+    value = 0;
+    for (std::size_t i = 0; i < width; ++i) {
+        char c = text[pos + i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// Leading blanks and an opening bracket, as in "[2024-06-10 08:15:00] ...".
+std::size_t skipPrefix(std::string_view line) {
+    std::size_t pos = 0;
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) {
+        ++pos;
+    }
+    if (pos < line.size() && line[pos] == '[') {
+        ++pos;
+    }
+    return pos;
+}
+
+std::int64_t floorDiv(std::int64_t a, std::int64_t b) {
+    std::int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+} // namespace
+
+bool TimestampExtractor::parseEpoch(std::string_view text, std::int64_t& seconds, std::size_t& length) {
+    std::size_t pos = 0;
+    std::int64_t value = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9' && pos < 19) {
+        if (value > (std::numeric_limits<std::int64_t>::max() - (text[pos] - '0')) / 10) {
+            return false;
+        }
+        value = value * 10 + (text[pos] - '0');
+        ++pos;
+    }
+    if (pos == 0) {
+        return false;
+    }
+    // The unit follows from the digit count: 13-15 digits are milliseconds
+    // (JavaScript / Java style), 16-18 microseconds, 19 nanoseconds.
+    if (pos >= 19) {
+        value /= 1000000000;
+    } else if (pos >= 16) {
+        value /= 1000000;
+    } else if (pos >= 13) {
+        value /= 1000;
+    }
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            ++pos;
+        }
+    }
+    seconds = value;
+    length = pos;
+    return true;
+}
+
+bool TimestampExtractor::parseIso8601(std::string_view text, std::int64_t& seconds, std::size_t& length) {
+    int year, month, day, hour, minute, second;
+    if (!readDigits(text, 0, 4, year) || text.size() < 19 || text[4] != '-' ||
+        !readDigits(text, 5, 2, month) || text[7] != '-' || !readDigits(text, 8, 2, day) ||
+        (text[10] != 'T' && text[10] != ' ') || !readDigits(text, 11, 2, hour) || text[13] != ':' ||
+        !readDigits(text, 14, 2, minute) || text[16] != ':' || !readDigits(text, 17, 2, second)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    std::size_t pos = 19;
+    if (pos < text.size() && (text[pos] == '.' || text[pos] == ',')) {
+        ++pos;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            ++pos;
+        }
+    }
+
+    // Zone: "Z", "+HH:MM", "+HHMM"; none means UTC.
+    std::int64_t offset = 0;
+    if (pos < text.size() && text[pos] == 'Z') {
+        ++pos;
+    } else if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+        int oh, om;
+        std::size_t p = pos + 1;
+        if (readDigits(text, p, 2, oh)) {
+            p += 2;
+            if (p < text.size() && text[p] == ':') {
+                ++p;
+            }
+            if (readDigits(text, p, 2, om)) {
+                offset = (oh * 3600 + om * 60) * (text[pos] == '-' ? -1 : 1);
+                pos = p + 2;
+            }
+        }
+    }
+
+    seconds = daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * 86400 +
+              hour * 3600 + minute * 60 + second - offset;
+    length = pos;
+    return true;
+}
+
+bool TimestampExtractor::configure(const std::string& spec) {
+    if (spec == "epoch") {
+        kind_ = Kind::Epoch;
+        return true;
+    }
+    if (spec == "iso8601" || spec == "iso") {
+        kind_ = Kind::Iso8601;
+        return true;
+    }
+    if (spec.rfind("regex:", 0) == 0) {
+        try {
+            regex_ = std::regex(spec.substr(6), std::regex::ECMAScript | std::regex::optimize);
+        } catch (const std::regex_error& e) {
+            std::cerr << "Invalid timestamp regex: " << e.what() << "\n";
+            return false;
+        }
+        if (regex_.mark_count() < 1) {
+            std::cerr << "Timestamp regex needs a capture group: " << spec << "\n";
+            return false;
+        }
+        kind_ = Kind::Regex;
+        return true;
+    }
+    std::cerr << "Unknown timestamp format: " << spec << " (use epoch, iso8601 or regex:<re>)\n";
+    return false;
+}
+
+bool TimestampExtractor::extract(std::string_view line, std::int64_t& seconds,
+                                 std::size_t& begin, std::size_t& end) const {
+    std::size_t length = 0;
+    switch (kind_) {
+    case Kind::Epoch:
+    case Kind::Iso8601: {
+        begin = skipPrefix(line);
+        std::string_view rest = line.substr(begin);
+        bool ok = kind_ == Kind::Epoch ? parseEpoch(rest, seconds, length)
+                                       : parseIso8601(rest, seconds, length);
+        if (!ok) {
+            return false;
+        }
+        end = begin + length;
+        if (end < line.size() && line[end] == ']') {
+            ++end;
+        }
+        return true;
+    }
+    case Kind::Regex: {
+        std::match_results<std::string_view::const_iterator> match;
+        if (!std::regex_search(line.begin(), line.end(), match, regex_) || !match[1].matched) {
+            return false;
+        }
+        std::string_view field(&*match[1].first, static_cast<std::size_t>(match[1].length()));
+        if (!parseIso8601(field, seconds, length) && !parseEpoch(field, seconds, length)) {
+            return false;
+        }
+        begin = static_cast<std::size_t>(match.position(0));
+        end = begin + static_cast<std::size_t>(match.length(0));
+        return true;
+    }
+    }
+    return false;
+}
+
+WindowedCounter::WindowedCounter(std::uint32_t windowSeconds, std::uint32_t bucketSeconds)
+    : bucketSeconds_(std::max<std::uint32_t>(1, bucketSeconds)) {
+    // Round the window up to whole buckets.
+    std::size_t buckets = (std::max<std::uint32_t>(1, windowSeconds) + bucketSeconds_ - 1) / bucketSeconds_;
+    ring_.resize(buckets);
+}
+
+void WindowedCounter::advanceTo(std::int64_t bucketIndex) {
+    const std::int64_t n = static_cast<std::int64_t>(ring_.size());
+    // Only the last n buckets can be live, however far time jumped.
+    for (std::int64_t b = std::max(head_ + 1, bucketIndex - n + 1); b <= bucketIndex; ++b) {
+        Bucket& slot = ring_[static_cast<std::size_t>((b % n + n) % n)];
+        for (const auto& entry : slot.counts) {
+            auto it = totals_.find(entry.first);
+            if (it != totals_.end() && (it->second -= entry.second) == 0) {
+                totals_.erase(it);
+            }
+        }
+        slot.counts.clear();
+        slot.index = b;
+    }
+    advances_ += static_cast<std::uint64_t>(bucketIndex - head_);
+    head_ = bucketIndex;
+}
+
+void WindowedCounter::addLocked(std::int64_t seconds, std::string_view word) {
+    const std::int64_t bucket = floorDiv(seconds, bucketSeconds_);
+    const std::int64_t n = static_cast<std::int64_t>(ring_.size());
+    if (!started_) {
+        head_ = bucket - n;
+        started_ = true;
+    }
+    if (bucket > head_) {
+        advanceTo(bucket);
+    }
+    Bucket& slot = ring_[static_cast<std::size_t>((bucket % n + n) % n)];
+    if (slot.index != bucket) {
+        ++late_;
+        return;
+    }
+    std::string key(word);
+    ++slot.counts[key];
+    ++totals_[key];
+}
+
+void WindowedCounter::add(std::int64_t seconds, std::string_view word) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    addLocked(seconds, word);
+}
+
+void WindowedCounter::add(std::int64_t seconds, const std::vector<std::string>& words) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& word : words) {
+        addLocked(seconds, word);
+    }
+}
+
+std::vector<std::pair<std::string, std::size_t>> WindowedCounter::query(std::size_t k) const {
+    std::vector<std::pair<std::string, std::size_t>> rows;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rows.assign(totals_.begin(), totals_.end());
+    }
+    if (k > 0) {
+        return Reducer::selectTopK(rows, k);
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+std::pair<std::int64_t, std::int64_t> WindowedCounter::bounds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::int64_t n = static_cast<std::int64_t>(ring_.size());
+    return { (head_ - n + 1) * bucketSeconds_, (head_ + 1) * bucketSeconds_ };
+}
+
+std::uint64_t WindowedCounter::advances() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return advances_;
+}
+
+std::size_t WindowedCounter::late() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return late_;
+}
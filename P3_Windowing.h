@@ -0,0 +1,101 @@
+#ifndef WINDOWING_H
+#define WINDOWING_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <regex>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// Windowed aggregation settings (see MapReduceController::setWindow).
+struct WindowOptions {
+    unsigned int windowSeconds = 300;   // window length
+    unsigned int slideSeconds = 0;      // 0 or == windowSeconds: tumbling
+    std::string timestamp = "iso8601";  // TimestampExtractor spec
+    unsigned int publishSeconds = 5;    // republish interval for live input
+};
+
+// Pulls an event time (Unix seconds) out of a log line.
+//   "epoch"        leading integer seconds, e.g. "1718000000 GET /index";
+//                  13, 16 or 19 digits are read as ms, us or ns
+//   "iso8601"      leading "YYYY-MM-DD[T ]HH:MM:SS" (UTC), e.g. syslog-ish
+//                  "2024-06-10T08:15:00Z ..." lines
+//   "regex:<re>"   first capture group of <re>, read as epoch or ISO 8601
+class TimestampExtractor {
+public:
+    // Returns false (with a message on stderr) for an unknown spec.
+    bool configure(const std::string& spec);
+
+    // On success sets `seconds` and the [begin, end) span of the line that
+    // held the timestamp, so it can be left out of the word count.
+    bool extract(std::string_view line, std::int64_t& seconds,
+                 std::size_t& begin, std::size_t& end) const;
+
+    static bool parseEpoch(std::string_view text, std::int64_t& seconds, std::size_t& length);
+    static bool parseIso8601(std::string_view text, std::int64_t& seconds, std::size_t& length);
+
+private:
+    enum class Kind { Epoch, Iso8601, Regex };
+    Kind kind_ = Kind::Iso8601;
+    std::regex regex_;
+};
+
+// Word counts over a time window that moves with event time. The window
+// is a ring of buckets, each `bucketSeconds` wide with its own count
+// table, plus a running total for the whole window. When event time moves
+// past a bucket, that bucket is retired by subtracting only its own keys
+// from the total, so the cost is O(keys in the bucket) and queries never
+// rescan input.
+//
+// Sliding window: windowSeconds = 300, bucketSeconds = 60 covers the last
+// five minutes, advancing every minute. Tumbling window: bucketSeconds ==
+// windowSeconds (one bucket, reset at every boundary).
+//
+// Thread-safe: add() and queries may be called from different threads.
+class WindowedCounter {
+public:
+    WindowedCounter(std::uint32_t windowSeconds, std::uint32_t bucketSeconds);
+
+    // Count `word` at event time `seconds`. Events older than the window
+    // are dropped (see late()).
+    void add(std::int64_t seconds, std::string_view word);
+
+    // Count several words with the same timestamp under one lock.
+    void add(std::int64_t seconds, const std::vector<std::string>& words);
+
+    // Current window contents: top k by count (k == 0: all, sorted by word).
+    std::vector<std::pair<std::string, std::size_t>> query(std::size_t k) const;
+
+    // [start, end) of the current window in event-time seconds.
+    std::pair<std::int64_t, std::int64_t> bounds() const;
+
+    // Number of bucket boundaries crossed so far; changes whenever the
+    // window advances.
+    std::uint64_t advances() const;
+
+    std::size_t late() const;
+
+private:
+    struct Bucket {
+        std::int64_t index = -1;  // bucket number (seconds / bucketSeconds)
+        std::unordered_map<std::string, std::size_t> counts;
+    };
+
+    void advanceTo(std::int64_t bucketIndex);
+    void addLocked(std::int64_t seconds, std::string_view word);
+
+    std::uint32_t bucketSeconds_;
+    std::vector<Bucket> ring_;
+    std::unordered_map<std::string, std::size_t> totals_;
+    std::int64_t head_ = 0;  // newest bucket index seen
+    bool started_ = false;
+    std::uint64_t advances_ = 0;
+    std::size_t late_ = 0;
+    mutable std::mutex mutex_;
+};
+
+#endif // WINDOWING_H
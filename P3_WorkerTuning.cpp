@@ -0,0 +1,334 @@
+#include "P3_WorkerTuning.h"
+#include "P3_Mapper.h"
+#include "P3_Compression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace {
+
+// Below this much input per worker, thread start-up and the extra reduce
+// partitions cost more than the parallel map saves.
+const std::uint64_t kBytesPerWorker = 4 * 1024 * 1024;
+
+// Read threads beyond this only queue more requests on the same device.
+const unsigned int kMaxReaders = 8;
+
+// Samples smaller than this finish too fast to time reliably.
+const std::uint64_t kMinProbeBytes = 256 * 1024;
+
+const std::size_t kProbeFiles = 8;
+const std::size_t kProbeBlockSize = 1024 * 1024;
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string formatBytes(double bytes) {
+    const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+    std::size_t unit = 0;
+    while (bytes >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        bytes /= 1024;
+        ++unit;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+    return text;
+}
+
+bool isCompressedName(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    return extension == ".gz" || extension == ".zst";
+}
+
+#ifdef __linux__
+
+// Limit of one cgroup v2 cpu.max file ("max 100000" or "<quota> <period>"),
+// 0 if unlimited or unreadable.
+double readCpuMax(const std::filesystem::path& file) {
+    std::ifstream in(file);
+    std::string quota;
+    double period = 0;
+    if (!(in >> quota >> period) || quota == "max" || period <= 0) {
+        return 0;
+    }
+    try {
+        return std::stod(quota) / period;
+    } catch (...) {
+        return 0;
+    }
+}
+
+// Limit of a cgroup v1 cpu controller directory, 0 if unlimited.
+double readCfsQuota(const std::filesystem::path& dir) {
+    std::ifstream quotaFile(dir / "cpu.cfs_quota_us");
+    std::ifstream periodFile(dir / "cpu.cfs_period_us");
+    double quota = 0;
+    double period = 0;
+    if (!(quotaFile >> quota) || !(periodFile >> period) || quota <= 0 || period <= 0) {
+        return 0;
+    }
+    return quota / period;
+}
+
+// Tightest CPU limit on the cgroup path of this process, in CPUs (0 = none).
+// A limit on any ancestor applies too, so v2 walks up to the root.
+double cgroupQuota() {
+    std::ifstream self("/proc/self/cgroup");
+    std::string line;
+    std::string v2Path;
+    std::string v1Path;
+    bool haveV1 = false;
+    while (std::getline(self, line)) {
+        std::size_t first = line.find(':');
+        std::size_t second = first == std::string::npos ? first : line.find(':', first + 1);
+        if (second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        if (line.compare(0, first, "0") == 0 && controllers.empty()) {
+            v2Path = path;
+            continue;
+        }
+        std::stringstream list(controllers);
+        std::string controller;
+        while (std::getline(list, controller, ',')) {
+            if (controller == "cpu") {
+                v1Path = path;
+                haveV1 = true;
+            }
+        }
+    }
+
+    double limit = 0;
+    auto tighten = [&limit](double value) {
+        if (value > 0 && (limit == 0 || value < limit)) {
+            limit = value;
+        }
+    };
+
+    const std::filesystem::path v2Root = "/sys/fs/cgroup";
+    if (std::filesystem::exists(v2Root / "cgroup.controllers")) {
+        std::filesystem::path dir = v2Root / std::filesystem::path(v2Path).relative_path();
+        while (true) {
+            tighten(readCpuMax(dir / "cpu.max"));
+            if (dir == v2Root || !dir.has_relative_path() || dir.parent_path() == dir) {
+                break;
+            }
+            dir = dir.parent_path();
+        }
+    } else if (haveV1) {
+        // Inside a container the hierarchy is usually mounted at the
+        // process's own cgroup, so also try the mount point itself.
+        for (const char* mount : { "/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu" }) {
+            tighten(readCfsQuota(std::filesystem::path(mount) / std::filesystem::path(v1Path).relative_path()));
+            tighten(readCfsQuota(mount));
+        }
+    }
+    return limit;
+}
+
+#endif
+
+} // namespace
+
+CpuProfile detectCpus() {
+    CpuProfile profile;
+    profile.logical = std::max(1u, std::thread::hardware_concurrency());
+    profile.physical = profile.logical;
+
+#ifdef _WIN32
+    DWORD length = 0;
+    GetLogicalProcessorInformation(nullptr, &length);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(
+        length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!info.empty() && GetLogicalProcessorInformation(info.data(), &length)) {
+        unsigned int cores = 0;
+        for (const auto& entry : info) {
+            if (entry.Relationship == RelationProcessorCore) {
+                ++cores;
+            }
+        }
+        if (cores > 0) {
+            profile.physical = std::min(cores, profile.logical);
+        }
+    }
+#elif defined(__linux__)
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0 && CPU_COUNT(&mask) > 0) {
+        profile.logical = static_cast<unsigned int>(CPU_COUNT(&mask));
+        // Hyper-threads of one core share its (package, core) pair.
+        std::set<std::pair<int, int>> cores;
+        bool topologyKnown = true;
+        for (int cpu = 0; cpu < CPU_SETSIZE && topologyKnown; ++cpu) {
+            if (!CPU_ISSET(cpu, &mask)) {
+                continue;
+            }
+            std::filesystem::path topology =
+                "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology";
+            std::ifstream packageFile(topology / "physical_package_id");
+            std::ifstream coreFile(topology / "core_id");
+            int package = 0;
+            int core = 0;
+            topologyKnown = static_cast<bool>(packageFile >> package) && static_cast<bool>(coreFile >> core);
+            cores.emplace(package, core);
+        }
+        profile.physical = topologyKnown ? static_cast<unsigned int>(cores.size()) : profile.logical;
+    }
+    profile.quota = cgroupQuota();
+#endif
+
+    profile.available = profile.logical;
+    if (profile.quota > 0) {
+        // Round down: a fractional CPU left over is throttled time, not a
+        // thread's worth of work.
+        unsigned int quotaCpus = static_cast<unsigned int>(std::max(1.0, std::floor(profile.quota)));
+        profile.available = std::min(profile.available, quotaCpus);
+    }
+    return profile;
+}
+
+unsigned int availableCpus() {
+    return detectCpus().available;
+}
+
+InputProfile profileInput(const std::vector<std::filesystem::path>& files) {
+    InputProfile profile;
+    profile.files = files.size();
+    for (const auto& file : files) {
+        std::error_code ec;
+        std::uintmax_t size = std::filesystem::file_size(file, ec);
+        if (!ec) {
+            profile.bytes += size;
+        }
+        if (isCompressedName(file)) {
+            ++profile.compressedFiles;
+        }
+    }
+    return profile;
+}
+
+ThroughputProbe probeThroughput(const std::vector<std::filesystem::path>& files, std::size_t sampleBytes) {
+    ThroughputProbe probe;
+    if (files.empty() || sampleBytes == 0) {
+        return probe;
+    }
+
+    // A few files spread over the list, an even share of the sample each.
+    const std::size_t step = std::max<std::size_t>(1, files.size() / kProbeFiles);
+    const std::size_t perFile = std::max<std::size_t>(kProbeBlockSize, sampleBytes / kProbeFiles);
+    std::string sample;
+    sample.reserve(sampleBytes);
+    double readSeconds = 0;
+    for (std::size_t i = 0; i < files.size() && sample.size() < sampleBytes; i += step) {
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream in(files[i], std::ios::binary);
+        if (!in.is_open()) {
+            continue;
+        }
+        const std::size_t begin = sample.size();
+        const std::size_t limit = std::min(sampleBytes, begin + perFile);
+        while (in && sample.size() < limit) {
+            std::size_t used = sample.size();
+            sample.resize(std::min(limit, used + kProbeBlockSize));
+            in.read(&sample[used], static_cast<std::streamsize>(sample.size() - used));
+            sample.resize(used + static_cast<std::size_t>(in.gcount()));
+        }
+        readSeconds += secondsSince(start);
+        // Compressed bytes do not tokenize like text; readers decode them.
+        if (detectCodec(sample.data() + begin, sample.size() - begin) != Codec::None) {
+            sample.resize(begin);
+        }
+    }
+    if (sample.size() < kMinProbeBytes) {
+        return probe;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Mapper mapper;
+    std::unordered_map<std::string, std::size_t> counts;
+    mapper.forEachWord(sample, [&counts](const std::string& word) { ++counts[word]; });
+    double tokenizeSeconds = secondsSince(start);
+
+    probe.sampleBytes = sample.size();
+    probe.readBytesPerSecond = sample.size() / std::max(readSeconds, 1e-6);
+    probe.tokenizeBytesPerSecond = sample.size() / std::max(tokenizeSeconds, 1e-6);
+    probe.valid = true;
+    return probe;
+}
+
+WorkerPlan planWorkers(const CpuProfile& cpus, const InputProfile& input, const ThroughputProbe& probe,
+                       unsigned int mapWorkers) {
+    const unsigned int available = std::max(1u, cpus.available);
+    std::string reason = std::to_string(cpus.logical) + " logical / " + std::to_string(cpus.physical) +
+                         " physical CPU(s)";
+    if (cpus.quota > 0) {
+        char quota[32];
+        std::snprintf(quota, sizeof(quota), "%.2f", cpus.quota);
+        reason += ", quota " + std::string(quota);
+    }
+
+    // SMT siblings add little to a tokenizer bound by one core's caches.
+    unsigned int map = mapWorkers;
+    if (map == 0) {
+        map = std::max(1u, std::min(cpus.physical, available));
+        if (input.files > 0) {
+            std::uint64_t bySize = std::max<std::uint64_t>(1, (input.bytes + kBytesPerWorker - 1) / kBytesPerWorker);
+            map = static_cast<unsigned int>(std::min<std::uint64_t>({ map, input.files, bySize }));
+        }
+    }
+    if (input.files > 0) {
+        reason += "; " + std::to_string(input.files) + " file(s), " + formatBytes(static_cast<double>(input.bytes));
+    }
+
+    const unsigned int maxReaders = std::min(kMaxReaders, available);
+    unsigned int readers = 1;
+    if (probe.valid) {
+        // CPU one mapper keeps a reader busy for.
+        const double readerShare = probe.tokenizeBytesPerSecond / probe.readBytesPerSecond;
+        auto readersFor = [&](unsigned int mappers) {
+            double needed = std::ceil(mappers * readerShare - 1e-9);
+            return static_cast<unsigned int>(std::clamp(needed, 1.0, static_cast<double>(maxReaders)));
+        };
+        if (mapWorkers == 0) {
+            // I/O bound: mappers past what the readers deliver would idle.
+            double fed = std::floor(maxReaders * probe.readBytesPerSecond / probe.tokenizeBytesPerSecond);
+            map = std::min(map, static_cast<unsigned int>(std::max(1.0, fed)));
+            // Reads from the page cache are copies on a CPU too; give the
+            // readers the whole CPUs their share adds up to.
+            double fits = available - std::floor(available * readerShare / (1.0 + readerShare));
+            map = std::min(map, static_cast<unsigned int>(std::max(1.0, fits)));
+        }
+        readers = readersFor(map);
+        reason += "; read " + formatBytes(probe.readBytesPerSecond) + "/s vs tokenize " +
+                  formatBytes(probe.tokenizeBytesPerSecond) + "/s per thread";
+    }
+    if (input.compressedFiles * 2 > input.files) {
+        // Readers also decompress, which the probe does not time.
+        readers = std::min(maxReaders, std::max(readers, (map + 1) / 2));
+        reason += "; mostly compressed input";
+    }
+
+    WorkerPlan plan;
+    plan.mapWorkers = map;
+    plan.readers = std::max(1u, readers);
+    plan.reason = reason;
+    return plan;
+}
@@ -0,0 +1,70 @@
+#ifndef WORKERTUNING_H
+#define WORKERTUNING_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+
+// CPUs this process may actually use.
+struct CpuProfile {
+    unsigned int logical = 1;    // hardware threads in the affinity mask
+    unsigned int physical = 1;   // distinct cores behind them (SMT siblings count once)
+    double quota = 0;            // cgroup CPU quota in CPUs, 0 = none
+    unsigned int available = 1;  // logical CPUs, capped by the quota
+};
+
+// Size of the job input, from the file list.
+struct InputProfile {
+    std::uint64_t bytes = 0;
+    std::size_t files = 0;
+    std::size_t compressedFiles = 0;
+};
+
+// Single-thread rates measured on a sample of the input. `valid` is false
+// when the sample was too small (or only compressed files) to time.
+struct ThroughputProbe {
+    bool valid = false;
+    std::uint64_t sampleBytes = 0;
+    double readBytesPerSecond = 0;
+    double tokenizeBytesPerSecond = 0;
+};
+
+struct WorkerPlan {
+    unsigned int mapWorkers = 1;
+    unsigned int readers = 1;
+    std::string reason;  // one line for the job log
+};
+
+// CPUs of this process: sched affinity, SMT topology and the cgroup (v2
+// cpu.max or v1 cfs quota) limit on Linux, GetLogicalProcessorInformation
+// on Windows, std::thread::hardware_concurrency otherwise.
+CpuProfile detectCpus();
+
+// detectCpus().available: the thread count for CPU-bound pools that do not
+// have an input profile (join, sort, ...).
+unsigned int availableCpus();
+
+InputProfile profileInput(const std::vector<std::filesystem::path>& files);
+
+// Reads up to `sampleBytes` from the start of a few uncompressed input
+// files and tokenizes them into a word table like a mapper does, timing
+// both steps on one thread.
+ThroughputProbe probeThroughput(const std::vector<std::filesystem::path>& files,
+                                std::size_t sampleBytes = 8 * 1024 * 1024);
+
+// Sizes the map and read pools:
+//   - map workers: one per physical core within the CPU quota, but no more
+//     than files to map or one per few MB of input;
+//   - readers: enough to deliver what the mappers tokenize (tokenize rate /
+//     read rate per mapper), and if even the maximum reader count cannot
+//     keep up the mappers are cut to what the reads can feed;
+//   - map workers plus the CPU time the readers spend copying stay within
+//     the available CPUs, so containers are not oversubscribed.
+// `input` and `probe` may be empty (streamed input). A nonzero `mapWorkers`
+// keeps that map pool and only sizes the readers for it.
+WorkerPlan planWorkers(const CpuProfile& cpus, const InputProfile& input, const ThroughputProbe& probe,
+                       unsigned int mapWorkers = 0);
+
+#endif // WORKERTUNING_H
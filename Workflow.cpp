@@ -3,6 +3,7 @@
 #include "mr/Reducer.hpp"
 #include "mr/FileManager.hpp"
 #include "mr/Types.hpp"
+#include "mr/MemoryBudget.hpp"
 
 #include <map>
 #include <memory>
@@ -10,6 +11,9 @@
 #include <vector>
 #include <stdexcept>
 #include <sstream>
+#include <fstream>
+#include <queue>
+#include <cstdio>
 #include <cstddef>
 
 
@@ -21,6 +25,148 @@
 
 namespace mr {
 
+namespace {
+
+// Rough heap cost of one grouped word beyond its characters (map node,
+// string header, count).
+const std::size_t kBytesPerGroupEntry = 96;
+
+// Runs merged at once, so the open files stay bounded.
+const std::size_t kMaxMergeFanIn = 64;
+
+// Parses a "word<TAB>count" (or "word count") record. Zero counts and
+// malformed lines are skipped, as in the in-memory grouping.
+bool parseRecord(const std::string& line, std::string& word, int& value) {
+    std::size_t sep = line.find('\t');
+    if (sep == std::string::npos) sep = line.find(' ');
+    if (sep == std::string::npos) return false;
+
+    word = line.substr(0, sep);
+    value = 0;
+    try { value = std::stoi(line.substr(sep + 1)); } catch (...) { value = 0; }
+    return !word.empty() && value != 0;
+}
+
+// Streams a k-way merge of sorted "word<TAB>count" runs, calling
+// emit(word, counts) once per word with one count per run holding it.
+template <typename Emit>
+void mergeSortedRuns(const std::vector<std::string>& runs, Emit&& emit) {
+    struct Head {
+        std::string word;
+        int value;
+        std::size_t run;
+    };
+    auto later = [](const Head& a, const Head& b) { return a.word > b.word; };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heap(later);
+
+    std::vector<std::ifstream> readers(runs.size());
+    auto advance = [&](std::size_t r) {
+        std::string line, word;
+        int value = 0;
+        while (std::getline(readers[r], line)) {
+            if (parseRecord(line, word, value)) {
+                heap.push({ word, value, r });
+                return;
+            }
+        }
+    };
+    for (std::size_t r = 0; r < runs.size(); ++r) {
+        readers[r].open(runs[r]);
+        if (!readers[r].is_open()) {
+            throw std::runtime_error("Failed to open spill file: " + runs[r]);
+        }
+        advance(r);
+    }
+
+    while (!heap.empty()) {
+        Head top = heap.top();
+        heap.pop();
+        std::vector<Count> counts{ top.value };
+        advance(top.run);
+        while (!heap.empty() && heap.top().word == top.word) {
+            const std::size_t r = heap.top().run;
+            counts.push_back(heap.top().value);
+            heap.pop();
+            advance(r);
+        }
+        emit(top.word, counts);
+    }
+    for (std::size_t r = 0; r < runs.size(); ++r) {
+        if (readers[r].bad()) {
+            throw std::runtime_error("Failed to read spill file: " + runs[r]);
+        }
+    }
+}
+
+// Sort & group plus reduce under the memory limit. Partial sums are kept in
+// a sorted map until it outgrows half of the budget, then written out as a
+// sorted run; the runs are merged (at most kMaxMergeFanIn at a time) word by
+// word into the reducer, so neither the intermediate file nor the full
+// vocabulary has to be resident.
+void groupAndReduceSpilling(FileManager& fm, const std::string& tempDir, const std::string& outputDir) {
+    const std::size_t tableBytes = std::max<std::size_t>(memoryLimit() / 2, 64 * 1024);
+    std::vector<std::string> runs;
+    std::size_t nextRun = 0;
+    auto runPath = [&]() { return tempDir + "/group-" + std::to_string(nextRun++) + ".txt"; };
+
+    std::map<std::string, int> partial;
+    std::size_t bytes = 0;
+    auto spill = [&]() {
+        if (partial.empty()) return;
+        const std::string path = runPath();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        for (const auto& kv : partial) out << kv.first << '\t' << kv.second << '\n';
+        out.close();
+        if (!out) throw std::runtime_error("Failed to write spill file: " + path);
+        runs.push_back(path);
+        partial.clear();
+        bytes = 0;
+    };
+
+    const std::string tmpFile = tempDir + "/intermediate.txt";
+    std::ifstream in(tmpFile);
+    std::string line, word;
+    int value = 0;
+    while (std::getline(in, line)) {
+        if (!parseRecord(line, word, value)) continue;
+        auto it = partial.find(word);
+        if (it != partial.end()) {
+            it->second += value;
+            continue;
+        }
+        partial.emplace(word, value);
+        bytes += word.size() + kBytesPerGroupEntry;
+        if (bytes > tableBytes) spill();
+    }
+    if (in.bad()) throw std::runtime_error("Failed to read " + tmpFile);
+    spill();
+
+    while (runs.size() > kMaxMergeFanIn) {
+        std::vector<std::string> group(runs.begin(), runs.begin() + kMaxMergeFanIn);
+        const std::string path = runPath();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        mergeSortedRuns(group, [&](const std::string& w, const std::vector<Count>& counts) {
+            int total = 0;
+            for (Count c : counts) total += c;
+            out << w << '\t' << total << '\n';
+        });
+        out.close();
+        if (!out) throw std::runtime_error("Failed to write spill file: " + path);
+        for (const auto& g : group) std::remove(g.c_str());
+        runs.erase(runs.begin(), runs.begin() + kMaxMergeFanIn);
+        runs.push_back(path);
+    }
+
+    Reducer reducer(fm, outputDir);
+    mergeSortedRuns(runs, [&](const std::string& w, const std::vector<Count>& counts) {
+        reducer.reduce(w, counts);
+    });
+    reducer.markSuccess();
+    for (const auto& r : runs) std::remove(r.c_str());
+}
+
+} // namespace
+
 // ------------------------- ctor -------------------------
 Workflow::Workflow(FileManager& fm,
                    const std::string& inputDir,
@@ -37,6 +183,10 @@ Workflow::Workflow(FileManager& fm,
 // -------------------- Phase-1 entrypoint -----------------
 void Workflow::run() {
     doMapPhase();
+    if (memoryLimit() > 0) {
+        groupAndReduceSpilling(fileManager_, tempDir_, outputDir_);
+        return;
+    }
     Grouped grouped = doSortAndGroup();
     doReducePhase(grouped);
 }
@@ -47,8 +197,9 @@ void Workflow::doMapPhase() {
     // Clear previous intermediate output
     fileManager_.writeAll(tmpFile, "");
 
-    // Tuneable flush threshold
-    Mapper mapper(fileManager_, tempDir_, /*flushThreshold=*/2048);
+    // Flush threshold derived from the memory budget (record = word + count)
+    Mapper mapper(fileManager_, tempDir_,
+                  flushThresholdFor(sizeof(std::pair<std::string, int>) + 16));
 
     const auto files = fileManager_.listFiles(inputDir_);
     for (const auto& path : files) {
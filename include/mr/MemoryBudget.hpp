@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace mr {
+
+// ------------------------------------------------------------------
+// Process-wide memory limit for the Phase 1/2 workflow (0 = unlimited).
+// Buffer sizes are derived from it instead of fixed constants.
+// ------------------------------------------------------------------
+void setMemoryLimit(std::size_t bytes);
+std::size_t memoryLimit();
+
+// Number of buffered records of `bytesPerRecord` each before a flush.
+// Unlimited keeps the historical 2048; otherwise a quarter of the budget.
+std::size_t flushThresholdFor(std::size_t bytesPerRecord);
+
+// Parse sizes such as "512M", "2G", "65536" or "64k". Returns false on
+// malformed input.
+bool parseMemorySize(const std::string& text, std::size_t& bytes);
+
+} // namespace mr
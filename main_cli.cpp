@@ -1,52 +1,1009 @@
 #include "MapReduceController.h"
 #include "P3_Logger.h"
+#include "P3_ResultStore.h"
+#include "P3_InvertedIndex.h"
+#include "P3_TfIdf.h"
+#include "P3_Cooccurrence.h"
+#include "P3_MemoryBudget.h"
+#include "P3_Join.h"
+#include "P3_Sort.h"
+#include "P3_WorkerTuning.h"
+#include "P3_Grep.h"
+#include "P3_ReadAhead.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
-#include <thread>
+#include <vector>
+#include <utility>
+#include <cctype>
+#include <cstdint>
+#include <csignal>
 
-int main(int argc, char** argv)
+// mapreduce_cli query <store> lookup <word>
+// mapreduce_cli query <store> prefix <prefix>
+// mapreduce_cli query <store> range <first> <last>
+static int runQuery(int argc, char** argv)
 {
-    // --------- Parse CLI arguments ----------
-    // arg1: input directory  (defaults to "sample_input")
-    // arg2: output file path (defaults to "output/word_counts_cli.txt")
-    // arg3: number of worker threads (optional, defaults to hardware_concurrency or 4)
-    std::string inputDir   = (argc > 1) ? argv[1] : "sample_input";
-    std::string outputFile = (argc > 2) ? argv[2] : "output/word_counts_cli.txt";
+    if (argc < 5) {
+        std::cerr << "Usage: mapreduce_cli query <store> lookup <word> | "
+                     "prefix <prefix> | range <first> <last>" << std::endl;
+        return 1;
+    }
+
+    ResultStore store;
+    if (!store.open(argv[2])) {
+        std::cerr << "Not a valid result store: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::string command = argv[3];
+    std::vector<std::pair<std::string, std::size_t>> rows;
+
+    if (command == "lookup") {
+        std::size_t count = 0;
+        if (!store.lookup(argv[4], count)) {
+            std::cerr << argv[4] << ": not found" << std::endl;
+            return 1;
+        }
+        rows.emplace_back(argv[4], count);
+    } else if (command == "prefix") {
+        rows = store.prefix(argv[4]);
+    } else if (command == "range" && argc > 5) {
+        rows = store.range(argv[4], argv[5]);
+    } else {
+        std::cerr << "Unknown query: " << command << std::endl;
+        return 1;
+    }
+
+    for (const auto& row : rows) {
+        std::cout << row.first << "," << row.second << "\n";
+    }
+    return 0;
+}
 
-    unsigned int defaultWorkers =
-        std::max(4u, std::thread::hardware_concurrency());  // at least 4
+// mapreduce_cli merge-sketches <report> <sketch> [<sketch> ...]
+// Combines sketches saved by approximate runs (e.g. on different nodes).
+static int runMergeSketches(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: mapreduce_cli merge-sketches <report> <sketch> [<sketch> ...]" << std::endl;
+        return 1;
+    }
 
-    unsigned int workers = defaultWorkers;
-    if (argc > 3) {
+    WordSketch merged{ ApproximateOptions() };
+    for (int i = 3; i < argc; ++i) {
+        WordSketch sketch{ ApproximateOptions() };
+        if (!sketch.load(argv[i])) {
+            std::cerr << "Not a valid sketch: " << argv[i] << std::endl;
+            return 1;
+        }
+        if (i == 3) {
+            merged = sketch;
+        } else if (!merged.merge(sketch)) {
+            std::cerr << "Sketch parameters do not match: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!merged.writeReport(argv[2], 0)) {
+        return 1;
+    }
+    std::cout << "Merged " << (argc - 3) << " sketch(es) into: " << argv[2] << std::endl;
+    return 0;
+}
+
+// mapreduce_cli index-query <index> <term> [AND|OR <term> ...]
+// Prints each matching document with the line numbers of the query terms.
+static int runIndexQuery(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: mapreduce_cli index-query <index> <term> [AND|OR <term> ...]" << std::endl;
+        return 1;
+    }
+
+    InvertedIndex index;
+    if (!index.open(argv[2])) {
+        std::cerr << "Not a valid inverted index: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> expression;
+    for (int i = 3; i < argc; ++i) {
+        std::string token = argv[i];
+        if (expression.size() % 2 == 0) {
+            // Terms are matched in the same normalized form the mapper produces.
+            for (char& c : token) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+        expression.push_back(token);
+    }
+
+    std::vector<std::uint32_t> docs;
+    std::string error;
+    if (!index.query(expression, docs, error)) {
+        std::cerr << "Invalid query: " << error << std::endl;
+        return 1;
+    }
+
+    for (std::uint32_t docId : docs) {
+        std::cout << index.documentPath(docId) << ":";
+        for (std::size_t i = 0; i < expression.size(); i += 2) {
+            std::vector<std::uint32_t> lines = index.lines(expression[i], docId);
+            if (lines.empty()) {
+                continue;
+            }
+            std::cout << " " << expression[i] << "@";
+            for (std::size_t j = 0; j < lines.size(); ++j) {
+                std::cout << (j == 0 ? "" : ",") << lines[j];
+            }
+        }
+        std::cout << "\n";
+    }
+    std::cout << docs.size() << " document(s) matched." << std::endl;
+    return 0;
+}
+
+// mapreduce_cli tfidf-query <vectors> <document> [k]
+// Prints the k (default 10) highest-weighted terms of a document, given by
+// path or by document ID.
+static int runTfIdfQuery(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: mapreduce_cli tfidf-query <vectors> <document> [k]" << std::endl;
+        return 1;
+    }
+
+    TfIdfVectors vectors;
+    if (!vectors.open(argv[2])) {
+        std::cerr << "Not a valid TF-IDF vector file: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::size_t k = 10;
+    if (argc > 4) {
+        try {
+            k = static_cast<std::size_t>(std::stoul(argv[4]));
+        } catch (...) {
+            std::cerr << "Invalid value for k: " << argv[4] << std::endl;
+            return 1;
+        }
+    }
+
+    std::string document = argv[3];
+    std::uint32_t docId = 0;
+    while (docId < vectors.documentCount() && vectors.documentPath(docId) != document) {
+        ++docId;
+    }
+    if (docId == vectors.documentCount()) {
         try {
-            unsigned long parsed = std::stoul(argv[3]);
-            if (parsed >= 3) {
-                workers = static_cast<unsigned int>(parsed);
+            docId = static_cast<std::uint32_t>(std::stoul(document));
+        } catch (...) {
+        }
+    }
+    std::vector<TermWeight> weights;
+    if (docId >= vectors.documentCount() || !vectors.vector(docId, weights)) {
+        std::cerr << document << ": no such document" << std::endl;
+        return 1;
+    }
+
+    std::sort(weights.begin(), weights.end(), [&](const TermWeight& a, const TermWeight& b) {
+        return a.weight != b.weight ? a.weight > b.weight : vectors.term(a.termId) < vectors.term(b.termId);
+    });
+    weights.resize(std::min(k, weights.size()));
+
+    std::cout << vectors.documentPath(docId) << ": " << vectors.documentLength(docId) << " words, norm "
+              << vectors.norm(docId) << "\n";
+    for (const TermWeight& entry : weights) {
+        std::cout << vectors.term(entry.termId) << "," << entry.weight << "\n";
+    }
+    return 0;
+}
+
+// mapreduce_cli cooccur-query <matrix> <word> [k]
+// Prints the k (default 10) most frequent neighbors of a word.
+static int runCooccurQuery(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: mapreduce_cli cooccur-query <matrix> <word> [k]" << std::endl;
+        return 1;
+    }
+
+    CooccurrenceMatrix matrix;
+    if (!matrix.open(argv[2])) {
+        std::cerr << "Not a valid co-occurrence matrix: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::size_t k = 10;
+    if (argc > 4) {
+        try {
+            k = static_cast<std::size_t>(std::stoul(argv[4]));
+        } catch (...) {
+            std::cerr << "Invalid value for k: " << argv[4] << std::endl;
+            return 1;
+        }
+    }
+
+    // Words are matched in the same normalized form the mapper produces.
+    std::string word = argv[3];
+    for (char& c : word) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    std::uint32_t termId = 0;
+    if (!matrix.find(word, termId)) {
+        std::cerr << word << ": not found" << std::endl;
+        return 1;
+    }
+
+    auto neighbors = matrix.row(termId);
+    std::sort(neighbors.begin(), neighbors.end(), [&](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : matrix.term(a.first) < matrix.term(b.first);
+    });
+    neighbors.resize(std::min(k, neighbors.size()));
+
+    for (const auto& neighbor : neighbors) {
+        std::cout << matrix.term(neighbor.first) << "," << neighbor.second << "\n";
+    }
+    return 0;
+}
+
+// mapreduce_cli join <left> <right> <output> [--broadcast] [--type inner|left|anti]
+//                    [--workers <n>] [--memory-limit <size>] [--temp-dir <dir>]
+//                    [--compress-output gzip|zstd]
+// Joins two "key,value" files on their first column. --broadcast loads the
+// right side into memory once and streams the left; otherwise both sides
+// are shuffled into hash partitions and sort-merge joined.
+static int runJoin(int argc, char** argv)
+{
+    if (argc < 5) {
+        std::cerr << "Usage: mapreduce_cli join <left> <right> <output> [--broadcast] "
+                     "[--type inner|left|anti] [--workers <n>] [--memory-limit <size>] "
+                     "[--temp-dir <dir>] [--compress-output gzip|zstd]" << std::endl;
+        return 1;
+    }
+
+    JoinOptions options;
+    options.workers = availableCpus();
+    bool broadcast = false;
+    for (int i = 5; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--broadcast") {
+            broadcast = true;
+        } else if (arg == "--type" && i + 1 < argc) {
+            if (!parseJoinType(argv[++i], options.type)) {
+                std::cerr << "Unknown join type: " << argv[i] << " (use inner, left or anti)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--workers" && i + 1 < argc) {
+            try {
+                options.workers = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } catch (...) {
+                std::cerr << "Invalid value for --workers: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--memory-limit" && i + 1 < argc) {
+            if (!MemoryBudget::parseSize(argv[++i], options.memoryLimit)) {
+                std::cerr << "Invalid value for --memory-limit: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--temp-dir" && i + 1 < argc) {
+            options.tempDir = argv[++i];
+        } else if (arg == "--compress-output" && i + 1 < argc) {
+            if (!parseCodec(argv[++i], options.outputCodec) || !codecAvailable(options.outputCodec)) {
+                std::cerr << "Unsupported codec for --compress-output: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown join option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    bool ok = broadcast ? broadcastHashJoin(argv[2], argv[3], argv[4], options)
+                        : sortMergeJoin(argv[2], argv[3], argv[4], options);
+    if (!ok) {
+        return 1;
+    }
+    std::cout << (broadcast ? "Broadcast hash" : "Sort-merge") << " join written to: " << argv[4] << std::endl;
+    return 0;
+}
+
+// mapreduce_cli teragen <records> <output> [--first <n>] [--workers <n>]
+// Writes TeraSort-style 100-byte records (gensort ASCII layout).
+static int runTeraGen(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: mapreduce_cli teragen <records> <output> [--first <n>] [--workers <n>]" << std::endl;
+        return 1;
+    }
+
+    std::uint64_t records = 0;
+    std::uint64_t first = 0;
+    unsigned int workers = availableCpus();
+    try {
+        records = std::stoull(argv[2]);
+        for (int i = 4; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--first" && i + 1 < argc) {
+                first = std::stoull(argv[++i]);
+            } else if (arg == "--workers" && i + 1 < argc) {
+                workers = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } else {
+                std::cerr << "Unknown teragen option: " << arg << std::endl;
+                return 1;
+            }
+        }
+    } catch (...) {
+        std::cerr << "Invalid number in teragen arguments" << std::endl;
+        return 1;
+    }
+
+    if (!teraGen(argv[3], records, first, workers)) {
+        return 1;
+    }
+    std::cout << "Generated " << records << " record(s) in: " << argv[3] << std::endl;
+    return 0;
+}
+
+// mapreduce_cli terasort <input> <output> [--workers <n>] [--partitions <n>]
+//                        [--samples <n>] [--memory-limit <size>] [--temp-dir <dir>]
+// Sample-based range-partitioned sort of 100-byte records; <input> is a
+// file or a directory of files. Prints the time of each phase.
+static int runTeraSort(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: mapreduce_cli terasort <input> <output> [--workers <n>] "
+                     "[--partitions <n>] [--samples <n>] [--memory-limit <size>] "
+                     "[--temp-dir <dir>]" << std::endl;
+        return 1;
+    }
+
+    SortOptions options;
+    options.workers = availableCpus();
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        try {
+            if (arg == "--workers" && i + 1 < argc) {
+                options.workers = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } else if (arg == "--partitions" && i + 1 < argc) {
+                options.partitions = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } else if (arg == "--samples" && i + 1 < argc) {
+                options.samples = static_cast<std::size_t>(std::stoull(argv[++i]));
+            } else if (arg == "--memory-limit" && i + 1 < argc) {
+                if (!MemoryBudget::parseSize(argv[++i], options.memoryLimit)) {
+                    std::cerr << "Invalid value for --memory-limit: " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--temp-dir" && i + 1 < argc) {
+                options.tempDir = argv[++i];
+            } else {
+                std::cerr << "Unknown terasort option: " << arg << std::endl;
+                return 1;
             }
         } catch (...) {
-            // keep default if parsing fails
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    SortReport report;
+    if (!teraSort(argv[2], argv[3], options, report)) {
+        return 1;
+    }
+    std::cout << "Sorted " << report.records << " record(s) into " << report.partitions
+              << " partition(s) (largest " << report.largestPartition << ")\n"
+              << "  sample  " << report.sampleSeconds << " s\n"
+              << "  shuffle " << report.shuffleSeconds << " s\n"
+              << "  sort    " << report.sortSeconds << " s\n"
+              << "Output written to: " << argv[3] << std::endl;
+    return 0;
+}
+
+// mapreduce_cli teravalidate <file|dir> [--workers <n>]
+// Checks that records are sorted and prints their count and checksum; the
+// checksum of a sorted output must equal that of its input.
+static int runTeraValidate(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: mapreduce_cli teravalidate <file|dir> [--workers <n>]" << std::endl;
+        return 1;
+    }
+
+    unsigned int workers = availableCpus();
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--workers" && i + 1 < argc) {
+            try {
+                workers = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } catch (...) {
+                std::cerr << "Invalid value for --workers: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown teravalidate option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    ValidateReport report;
+    if (!teraValidate(argv[2], workers, report)) {
+        return 1;
+    }
+    std::cout << "records " << report.records << "\n"
+              << "checksum " << std::hex << report.checksum << std::dec << "\n"
+              << "duplicate keys " << report.duplicateKeys << "\n";
+    if (report.unordered > 0) {
+        std::cout << "UNSORTED: " << report.unordered << " record(s) out of order, first at record "
+                  << report.firstUnordered << std::endl;
+        return 1;
+    }
+    std::cout << "SUCCESS: all records are in order" << std::endl;
+    return 0;
+}
+
+// mapreduce_cli grep-check [<pattern> <file> [--ignore-case]]
+// Regression check of the grep literal prefilter: every line the prefiltered
+// scan reports must be exactly the lines std::regex_search matches. Without
+// arguments it runs built-in patterns whose literals were once extracted
+// wrongly (quantifier counts, \x/\u/\c operands, backreferences).
+static int runGrepCheck(int argc, char** argv)
+{
+    struct Case {
+        std::string pattern;
+        std::string text;
+    };
+    std::vector<Case> cases;
+    GrepOptions options;
+    if (argc >= 4) {
+        std::vector<char> data;
+        if (!ReadAheadPipeline::readFile(argv[3], data) || !decompressInPlace(data)) {
+            std::cerr << "Cannot read: " << argv[3] << std::endl;
+            return 1;
+        }
+        cases.push_back({ argv[2], std::string(data.begin(), data.end()) });
+        for (int i = 4; i < argc; ++i) {
+            if (std::string(argv[i]) == "--ignore-case") {
+                options.ignoreCase = true;
+            } else {
+                std::cerr << "Unknown grep-check option: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+    } else if (argc == 2) {
+        const std::string text = "abc 456\nfoo 123\naa bb\nA marks\nabbc\nxfoo\nababc\nline\tend\n";
+        for (const char* pattern : { "\\d{3}", "a{2,3}", "\\x41 marks", "\\u0041 marks", "x{0,2}foo",
+                                     "ab{2}c", "(ab){2}c", "(a)\\1 bb", "\\cI", "b{1}c", "ab{0}bc" }) {
+            cases.push_back({ pattern, text });
+        }
+    } else {
+        std::cerr << "Usage: mapreduce_cli grep-check [<pattern> <file> [--ignore-case]]" << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    for (const Case& test : cases) {
+        options.pattern = test.pattern;
+        GrepMatcher matcher;
+        if (!matcher.compile(options)) {
+            return 1;
+        }
+        std::vector<std::size_t> scanned;
+        matcher.scan(test.text, [&](std::size_t offset, std::string_view) { scanned.push_back(offset); });
+
+        std::vector<std::size_t> expected;
+        const std::string_view text(test.text);
+        for (std::size_t start = 0; start < text.size();) {
+            std::size_t end = std::min(text.find('\n', start), text.size());
+            std::string_view line = text.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (matcher.lineMatches(line)) {
+                expected.push_back(start);
+            }
+            start = end + 1;
+        }
+
+        std::string literals;
+        for (const std::string& literal : requiredLiterals(test.pattern)) {
+            literals += (literals.empty() ? "\"" : ", \"") + literal + "\"";
+        }
+        const bool same = scanned == expected;
+        failures += same ? 0 : 1;
+        std::cout << (same ? "OK   " : "FAIL ") << test.pattern << " [" << literals << "]: "
+                  << scanned.size() << " of " << expected.size() << " matching line(s) found" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+namespace {
+
+// Ctrl+C / SIGTERM in watch mode: publish once more and exit cleanly.
+void onStopSignal(int) {
+    MapReduceController::requestStop();
+}
+
+// Thread count option: a positive number, or "auto" (stored as 0).
+bool parseThreadCount(const std::string& text, unsigned int& count) {
+    if (text == "auto") {
+        count = 0;
+        return true;
+    }
+    try {
+        unsigned long value = std::stoul(text);
+        if (value == 0) {
+            return false;
+        }
+        count = static_cast<unsigned int>(value);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "query") {
+        return runQuery(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "merge-sketches") {
+        return runMergeSketches(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "index-query") {
+        return runIndexQuery(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "tfidf-query") {
+        return runTfIdfQuery(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "cooccur-query") {
+        return runCooccurQuery(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "join") {
+        return runJoin(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "teragen") {
+        return runTeraGen(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "terasort") {
+        return runTeraSort(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "teravalidate") {
+        return runTeraValidate(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "grep-check") {
+        return runGrepCheck(argc, argv);
+    }
+
+    // --------- Parse CLI arguments ----------
+    // arg1: input directory  (defaults to "sample_input"); "-" or a FIFO streams
+    //       input (e.g. `zcat logs.gz | mapreduce_cli - out.csv`)
+    // arg2: output file path (defaults to "output/word_counts_cli.txt")
+    // arg3: number of map worker threads, or "auto" (default): sized from the
+    //       CPU quota, physical cores, input size and a short read/tokenize probe
+    //
+    // Options (may appear anywhere):
+    //   --incremental <cacheFile>  only re-map files that changed since the last run
+    //   --top <K>                  only write the K most frequent words
+    //   --format csv|index         output layout (index = memory-mappable result store)
+    //   --bloom                    add a bloom filter to an indexed store
+    //   --approx                   estimate counts with fixed-memory sketches
+    //   --epsilon <e> --delta <d>  Count-Min error bounds for --approx
+    //   --heavy <n>                Space-Saving heavy-hitter capacity for --approx
+    //   --hll-precision <p>        HyperLogLog precision for --approx
+    //   --sketch-out <file>        save the merged sketch for later merging
+    //   --ngram <n>                count n-grams (2 = bigrams, 3 = trigrams, ...)
+    //   --index                    build an inverted index instead of word counts
+    //   --tfidf                    write sparse TF-IDF vectors per document
+    //   --cooccur <n|line>         co-occurrence matrix of words up to n apart, or on one line
+    //   --recursive                descend into subdirectories of the input
+    //   --include <glob>           input file pattern, repeatable (default *.txt)
+    //   --exclude <glob>           skip matching files/directories, repeatable
+    //   --workers <n|auto>         same as arg3
+    //   --readers <n|auto>         read-ahead threads (default auto, sized with the workers)
+    //   --read-ahead <n>           filled buffers queued per worker (default 2)
+    //   --compress-output gzip|zstd compress the CSV output
+    //   --compress-spills gzip|zstd compress runs spilled under --memory-limit
+    //   --partial-every <sec>      rewrite the output with partial counts periodically
+    //   --watch                    keep running and map appended bytes / new files
+    //   --publish-every <sec>      watch/window mode: max staleness of the output
+    //   --snapshot <file>          watch mode: persist live state across restarts
+    //   --watch-for <sec>          watch mode: stop after this long (default: until Ctrl+C)
+    //   --poll                     watch mode: poll instead of using inotify
+    //   --window <sec>             count per event-time window (e.g. 300 = last 5 min)
+    //   --slide <sec>              window advance step (default: tumbling windows)
+    //   --timestamp <spec>         epoch | iso8601 | regex:<re> (default iso8601)
+    //   --job <kind>=<output>      fused mode, repeatable: words, ngram:<n> or filestats
+    //                              jobs share one scan (e.g. --job words=w.csv --job ngram:2=b.csv)
+    //   --dag <config>             run a chain of stages declared in a config file
+    //   --grep <regex>             write matching lines as path:offset:line
+    //   --ignore-case / --fixed-strings / --unordered   grep modifiers
+    //   --hot-keys <fraction>      salt words above this share of all words over every reducer
+    //   --memory-limit <size>      cap buffers and tables (e.g. 512M), spilling to disk
+    //   --spill-dir <dir>          where spilled runs go (default: next to the output)
+    //   --verbose                  print the job log (including memory summary) at the end
+    std::vector<std::string> args;
+    std::string incrementalCache;
+    std::size_t topK = 0;
+    OutputFormat outputFormat = OutputFormat::Csv;
+    bool withBloomFilter = false;
+    bool approximate = false;
+    ApproximateOptions approximateOptions;
+    std::string sketchFile;
+    unsigned int ngramSize = 1;
+    bool invertedIndex = false;
+    bool tfIdf = false;
+    double hotKeyFraction = 0;
+    bool cooccurrence = false;
+    CooccurrenceOptions cooccurrenceOptions;
+    bool verbose = false;
+    std::size_t memoryLimit = 0;
+    DiscoveryOptions discovery;
+    unsigned int workers = 0;  // 0 = auto
+    unsigned int readers = 0;  // 0 = auto
+    Codec outputCodec = Codec::None;
+    unsigned int partialEvery = 0;
+    bool watch = false;
+    WatchOptions watchOptions;
+    std::vector<std::string> jobSpecs;
+    std::string dagConfig;
+    bool grep = false;
+    GrepOptions grepOptions;
+    bool windowed = false;
+    WindowOptions windowOptions;
+    Codec spillCodec = Codec::None;
+    std::size_t readAhead = 2;
+    bool customInclude = false;
+    std::string spillDir;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--incremental" && i + 1 < argc) {
+            incrementalCache = argv[++i];
+        } else if (arg == "--top" && i + 1 < argc) {
+            try {
+                topK = static_cast<std::size_t>(std::stoul(argv[++i]));
+            } catch (...) {
+                std::cerr << "Invalid value for --top: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "index") {
+                outputFormat = OutputFormat::IndexedStore;
+            } else if (format != "csv") {
+                std::cerr << "Unknown output format: " << format << std::endl;
+                return 1;
+            }
+        } else if (arg == "--bloom") {
+            withBloomFilter = true;
+        } else if (arg == "--approx") {
+            approximate = true;
+        } else if ((arg == "--epsilon" || arg == "--delta" || arg == "--heavy" ||
+                    arg == "--hll-precision") && i + 1 < argc) {
+            try {
+                std::string value = argv[++i];
+                if (arg == "--epsilon") {
+                    approximateOptions.epsilon = std::stod(value);
+                } else if (arg == "--delta") {
+                    approximateOptions.delta = std::stod(value);
+                } else if (arg == "--heavy") {
+                    approximateOptions.heavyHitters = static_cast<std::size_t>(std::stoul(value));
+                } else {
+                    approximateOptions.hllPrecision = static_cast<unsigned int>(std::stoul(value));
+                }
+            } catch (...) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+            if (approximateOptions.epsilon <= 0.0 || approximateOptions.epsilon >= 1.0 ||
+                approximateOptions.delta <= 0.0 || approximateOptions.delta >= 1.0) {
+                std::cerr << "--epsilon and --delta must be between 0 and 1" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--ngram" && i + 1 < argc) {
+            try {
+                ngramSize = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } catch (...) {
+                std::cerr << "Invalid value for --ngram: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--index") {
+            invertedIndex = true;
+        } else if (arg == "--tfidf") {
+            tfIdf = true;
+        } else if (arg == "--hot-keys" && i + 1 < argc) {
+            try {
+                hotKeyFraction = std::stod(argv[++i]);
+            } catch (...) {
+                hotKeyFraction = -1;
+            }
+            if (hotKeyFraction <= 0 || hotKeyFraction > 1) {
+                std::cerr << "Invalid value for --hot-keys: " << argv[i] << " (use a fraction such as 0.01)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cooccur" && i + 1 < argc) {
+            cooccurrence = true;
+            std::string window = argv[++i];
+            try {
+                cooccurrenceOptions.window = window == "line" ? 0 : static_cast<unsigned int>(std::stoul(window));
+            } catch (...) {
+                std::cerr << "Invalid value for --cooccur: " << window << " (use a window size or 'line')" << std::endl;
+                return 1;
+            }
+            if (window != "line" && cooccurrenceOptions.window == 0) {
+                std::cerr << "--cooccur window must be at least 1" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--recursive") {
+            discovery.recursive = true;
+        } else if (arg == "--include" && i + 1 < argc) {
+            if (!customInclude) {
+                discovery.include.clear();
+                customInclude = true;
+            }
+            discovery.include.push_back(argv[++i]);
+        } else if (arg == "--exclude" && i + 1 < argc) {
+            discovery.exclude.push_back(argv[++i]);
+        } else if ((arg == "--workers" || arg == "--readers") && i + 1 < argc) {
+            if (!parseThreadCount(argv[++i], arg == "--workers" ? workers : readers)) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << " (use a number or auto)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--read-ahead" && i + 1 < argc) {
+            try {
+                readAhead = static_cast<std::size_t>(std::stoul(argv[++i]));
+            } catch (...) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if ((arg == "--compress-output" || arg == "--compress-spills") && i + 1 < argc) {
+            Codec codec = Codec::None;
+            if (!parseCodec(argv[++i], codec)) {
+                std::cerr << "Unknown codec for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+            if (!codecAvailable(codec)) {
+                std::cerr << "This build has no " << codecName(codec) << " support" << std::endl;
+                return 1;
+            }
+            (arg == "--compress-output" ? outputCodec : spillCodec) = codec;
+        } else if (arg == "--partial-every" && i + 1 < argc) {
+            try {
+                partialEvery = static_cast<unsigned int>(std::stoul(argv[++i]));
+            } catch (...) {
+                std::cerr << "Invalid value for --partial-every: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--watch") {
+            watch = true;
+        } else if (arg == "--poll") {
+            watchOptions.forcePolling = true;
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            watchOptions.snapshotFile = argv[++i];
+        } else if ((arg == "--publish-every" || arg == "--watch-for") && i + 1 < argc) {
+            try {
+                unsigned int seconds = static_cast<unsigned int>(std::stoul(argv[++i]));
+                if (arg == "--publish-every") {
+                    watchOptions.publishSeconds = seconds;
+                    windowOptions.publishSeconds = seconds;
+                } else {
+                    watchOptions.durationSeconds = seconds;
+                }
+            } catch (...) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if ((arg == "--window" || arg == "--slide") && i + 1 < argc) {
+            try {
+                unsigned int seconds = static_cast<unsigned int>(std::stoul(argv[++i]));
+                (arg == "--window" ? windowOptions.windowSeconds : windowOptions.slideSeconds) = seconds;
+            } catch (...) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+            windowed = true;
+        } else if (arg == "--timestamp" && i + 1 < argc) {
+            windowOptions.timestamp = argv[++i];
+            windowed = true;
+        } else if (arg == "--grep" && i + 1 < argc) {
+            grep = true;
+            grepOptions.pattern = argv[++i];
+        } else if (arg == "--ignore-case") {
+            grepOptions.ignoreCase = true;
+        } else if (arg == "--fixed-strings") {
+            grepOptions.fixedString = true;
+        } else if (arg == "--unordered") {
+            grepOptions.ordered = false;
+        } else if (arg == "--dag" && i + 1 < argc) {
+            dagConfig = argv[++i];
+        } else if (arg == "--job" && i + 1 < argc) {
+            jobSpecs.push_back(argv[++i]);
+        } else if (arg == "--memory-limit" && i + 1 < argc) {
+            if (!MemoryBudget::parseSize(argv[++i], memoryLimit)) {
+                std::cerr << "Invalid value for --memory-limit: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--spill-dir" && i + 1 < argc) {
+            spillDir = argv[++i];
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else if (arg == "--sketch-out" && i + 1 < argc) {
+            sketchFile = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    // Each of these selects a different job; the controller runs only one,
+    // so asking for several is a usage error rather than a silent choice.
+    const std::pair<bool, const char*> modeFlags[] = {
+        { watch, "--watch" },
+        { windowed, "--window" },
+        { !jobSpecs.empty(), "--job" },
+        { grep, "--grep" },
+        { !dagConfig.empty(), "--dag" },
+        { approximate, "--approx" },
+        { invertedIndex, "--index" },
+        { tfIdf, "--tfidf" },
+        { cooccurrence, "--cooccur" },
+        { ngramSize > 1, "--ngram" },
+        { !incrementalCache.empty(), "--incremental" },
+    };
+    std::vector<std::string> modes;
+    for (const auto& flag : modeFlags) {
+        if (flag.first) {
+            modes.push_back(flag.second);
+        }
+    }
+    if (modes.size() > 1) {
+        std::string list;
+        for (const auto& mode : modes) {
+            list += (list.empty() ? "" : ", ") + mode;
         }
+        std::cerr << "Conflicting modes: " << list << " (choose one)" << std::endl;
+        return 1;
+    }
+    const std::string mode = modes.empty() ? std::string() : modes.front();
+
+    // Options a job would silently ignore are usage errors too.
+    if (hotKeyFraction > 0 && !mode.empty()) {
+        std::cerr << "--hot-keys only applies to the word count, not to " << mode << std::endl;
+        return 1;
+    }
+    const std::vector<std::string> unranked = { "--grep", "--dag", "--index", "--tfidf", "--cooccur" };
+    if (topK > 0 && std::find(unranked.begin(), unranked.end(), mode) != unranked.end()) {
+        std::cerr << "--top does not apply to " << mode << std::endl;
+        return 1;
+    }
+    const std::vector<std::string> uncompressed = { "--approx", "--index", "--tfidf", "--cooccur" };
+    std::string rawOutput = outputFormat == OutputFormat::IndexedStore ? "--format index" : "";
+    if (std::find(uncompressed.begin(), uncompressed.end(), mode) != uncompressed.end()) {
+        rawOutput = mode;
+    }
+    if (outputCodec != Codec::None && !rawOutput.empty()) {
+        std::cerr << "--compress-output does not apply to " << rawOutput << std::endl;
+        return 1;
+    }
+
+    std::string inputDir   = (args.size() > 0) ? args[0] : "sample_input";
+    std::string outputFile = (args.size() > 1) ? args[1] : "output/word_counts_cli.txt";
+
+    if (args.size() > 2 && !parseThreadCount(args[2], workers)) {
+        std::cerr << "Invalid worker count: " << args[2] << " (use a number or auto)" << std::endl;
+        return 1;
     }
 
     Logger logger;
     logger.log("CLI MapReduce starting...");
     logger.log("Input directory: " + inputDir);
     logger.log("Output file: " + outputFile);
-    logger.log("Worker threads: " + std::to_string(workers));
+    logger.log("Worker threads: " + (workers == 0 ? std::string("auto") : std::to_string(workers)));
 
     try {
         MapReduceController controller(inputDir, outputFile, workers);
+        if (!incrementalCache.empty()) {
+            logger.log("Incremental cache: " + incrementalCache);
+            controller.setIncrementalCache(incrementalCache);
+        }
+        if (topK > 0) {
+            logger.log("Top-K: " + std::to_string(topK));
+            controller.setTopK(topK);
+        }
+        controller.setOutputFormat(outputFormat, withBloomFilter);
+        if (approximate) {
+            logger.log("Approximate mode enabled.");
+            controller.setApproximate(approximateOptions, sketchFile);
+        }
+        if (ngramSize > 1) {
+            logger.log("N-gram size: " + std::to_string(ngramSize));
+            controller.setNGramSize(ngramSize);
+        }
+        if (tfIdf) {
+            controller.setTfIdf(true);
+        }
+        if (hotKeyFraction > 0) {
+            controller.setHotKeys(hotKeyFraction);
+        }
+        if (cooccurrence) {
+            controller.setCooccurrence(cooccurrenceOptions);
+        }
+        if (invertedIndex) {
+            logger.log("Building inverted index.");
+            controller.setInvertedIndex(true);
+        }
+        controller.setDiscovery(discovery);
+        controller.setReadAhead(readers, readAhead);
+        controller.setCompression(outputCodec, spillCodec);
+        controller.setPartialResults(partialEvery);
+        if (watch) {
+            logger.log("Watch mode enabled.");
+            controller.setWatch(watchOptions);
+            std::signal(SIGINT, onStopSignal);
+            std::signal(SIGTERM, onStopSignal);
+        }
+        for (const auto& spec : jobSpecs) {
+            std::unique_ptr<FusedJob> job = FusedJob::fromSpec(spec, topK);
+            if (!job) {
+                return 1;
+            }
+            logger.log("Fused job: " + job->name() + " -> " + job->outputFile());
+            controller.addJob(std::move(job));
+        }
+        if (grep) {
+            controller.setGrep(grepOptions);
+        }
+        if (!dagConfig.empty()) {
+            JobDag dag;
+            if (!dag.parse(dagConfig)) {
+                return 1;
+            }
+            logger.log("DAG config: " + dagConfig);
+            controller.setDag(dag);
+        }
+        if (windowed) {
+            if (windowOptions.windowSeconds == 0 || windowOptions.slideSeconds > windowOptions.windowSeconds) {
+                std::cerr << "--window must be positive and --slide no larger than --window" << std::endl;
+                return 1;
+            }
+            // The window is a whole number of slides; anything else would
+            // silently widen it to the next multiple.
+            if (windowOptions.slideSeconds > 0 && windowOptions.windowSeconds % windowOptions.slideSeconds != 0) {
+                std::cerr << "--slide (" << windowOptions.slideSeconds << ") must divide --window ("
+                          << windowOptions.windowSeconds << ")" << std::endl;
+                return 1;
+            }
+            controller.setWindow(windowOptions);
+            std::signal(SIGINT, onStopSignal);
+            std::signal(SIGTERM, onStopSignal);
+        }
+        if (memoryLimit > 0) {
+            controller.setMemoryLimit(memoryLimit, spillDir);
+        }
         bool ok = controller.run(logger);
 
         if (!ok) {
-            std::cerr << "No .txt files found in: " << inputDir << std::endl;
+            // No input files, or a step failed (e.g. the output could not be
+            // written); the job log says which.
+            std::cerr << "MapReduce failed for input: " << inputDir << std::endl;
+            if (verbose) {
+                std::cout << logger.getAll();
+            }
             return 1;
         }
 
         logger.log("CLI MapReduce finished successfully.");
-        std::cout << "MapReduce completed. Results written to: "
-                  << outputFile << std::endl;
+        if (verbose) {
+            std::cout << logger.getAll();
+        }
+        std::string written;
+        for (const auto& file : controller.outputFiles()) {
+            written += (written.empty() ? "" : ", ") + file;
+        }
+        std::cout << "MapReduce completed. Results written to: " << written << std::endl;
     }
     catch (const std::exception& ex) {
         logger.log(std::string("Unhandled exception: ") + ex.what());